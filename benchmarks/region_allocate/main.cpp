@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "measure.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+class config {
+ private:
+	static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+						  {"size", required_argument, NULL, 'x'},
+						  {"block_size", required_argument, NULL, 'b'},
+						  {"region_size", required_argument, NULL, 'r'},
+						  {"operations", required_argument, NULL, 'o'},
+						  {"live_regions", required_argument, NULL, 'l'},
+						  {"iterations", required_argument, NULL, 'i'},
+						  {"max_concurrency", required_argument, NULL, 't'},
+						  {"help", no_argument, NULL, 'h'},
+						  {NULL, 0, NULL, 0}};
+
+	static std::string app_name;
+
+ public:
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 10;
+	size_t block_size = TEST_DEFAULT_BLOCK_SIZE;
+	size_t region_size = TEST_DEFAULT_REGION_SIZE;
+	size_t operations = 1000;
+	size_t live_regions = 4;
+	size_t iterations = 10;
+	size_t max_concurrency = 8;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		app_name = std::string(argv[0]);
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:b:r:o:l:i:t:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 'b':
+					block_size = std::stoull(optarg);
+					break;
+				case 'r':
+					region_size = std::stoull(optarg);
+					break;
+				case 'o':
+					operations = std::stoull(optarg);
+					break;
+				case 'l':
+					live_regions = std::stoull(optarg);
+					break;
+				case 'i':
+					iterations = std::stoull(optarg);
+					break;
+				case 't':
+					max_concurrency = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (max_concurrency == 0) {
+			throw std::invalid_argument("Concurrency must be greater than 0");
+		}
+		if (live_regions == 0) {
+			throw std::invalid_argument("Number of live regions must be greater than 0");
+		}
+		return 0;
+	}
+
+	static void print_usage()
+	{
+		std::vector<std::string> new_line = {"", ""};
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + app_name + " [OPTION]...\n" +
+				 "Benchmark for concurrent region allocations and frees.",
+			 ""},
+			new_line,
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--block_size [size]", "block size"},
+			{"--region_size [size]", "region size"},
+			{"--operations [count]", "number of region allocations (and frees) performed by each thread"},
+			{"--live_regions [count]", "number of regions kept allocated by each thread"},
+			{"--iterations [iterations]", "number of iterations"},
+			{"--max_concurrency [num]", "maximal number of threads (measured for 1, 2, 4, ... threads)"},
+			new_line,
+			{"More iterations gives more robust statistical data, but takes more time", ""},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(28) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+std::string config::app_name;
+constexpr option config::long_options[];
+
+std::ostream &operator<<(std::ostream &out, config const &cfg)
+{
+	out << "Region Allocate Benchmark, path: " << cfg.path << ", ";
+	out << "size: " << cfg.size << ", ";
+	out << "block_size: " << cfg.block_size << ", ";
+	out << "region_size: " << cfg.region_size << ", ";
+	out << "operations: " << cfg.operations << ", ";
+	out << "live_regions: " << cfg.live_regions << ", ";
+	out << "Number of iterations: " << cfg.iterations << ", ";
+	out << "Max concurrency: " << cfg.max_concurrency << std::endl;
+	return out;
+}
+
+class pmemstream_region_allocate_workload : public benchmark::workload_base {
+ public:
+	pmemstream_region_allocate_workload(config &cfg, size_t concurrency)
+	    : cfg(cfg), threads_regions(concurrency, std::vector<pmemstream_region>(cfg.live_regions))
+	{
+		stream = make_pmemstream(cfg.path.c_str(), cfg.block_size, cfg.size);
+	}
+
+	void initialize() override
+	{
+	}
+
+	/* Each thread keeps 'live_regions' regions allocated and replaces the oldest one in each operation, so that
+	 * freed regions are reused (and merged with their neighbours) concurrently with allocations of other
+	 * threads. */
+	void perform(size_t thread_id) override
+	{
+		auto &regions = threads_regions[thread_id];
+		for (size_t i = 0; i < cfg.operations + cfg.live_regions; i++) {
+			auto &region = regions[i % cfg.live_regions];
+			if (i >= cfg.live_regions && pmemstream_region_free(stream.get(), region)) {
+				throw std::runtime_error("Error during region free!");
+			}
+			if (i < cfg.operations && pmemstream_region_allocate(stream.get(), cfg.region_size, &region)) {
+				throw std::runtime_error("Error during region allocate! Stream is too small?");
+			}
+		}
+	}
+
+	void clean() override
+	{
+	}
+
+ private:
+	config cfg;
+	std::unique_ptr<struct pmemstream, std::function<void(struct pmemstream *)>> stream;
+	std::vector<std::vector<pmemstream_region>> threads_regions;
+};
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage();
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+	std::cout << cfg << std::endl;
+
+	std::cout << "pmemstream region allocate measurement:" << std::endl;
+	std::cout << std::setw(10) << std::left << "threads" << std::setw(24) << "mean[ns] per operation"
+		  << "total[Mops/s]" << std::endl;
+
+	std::vector<size_t> thread_counts;
+	for (size_t concurrency = 1; concurrency < cfg.max_concurrency; concurrency *= 2) {
+		thread_counts.push_back(concurrency);
+	}
+	thread_counts.push_back(cfg.max_concurrency);
+
+	for (auto concurrency : thread_counts) {
+		std::vector<std::chrono::nanoseconds::rep> results;
+		try {
+			pmemstream_region_allocate_workload workload(cfg, concurrency);
+			results = benchmark::measure<std::chrono::nanoseconds>(cfg.iterations, &workload, concurrency);
+		} catch (std::runtime_error &e) {
+			std::cerr << e.what() << std::endl;
+			return -2;
+		}
+
+		/* Each result is a time of all operations (allocation and free) of a single thread. */
+		auto mean_per_operation = benchmark::mean(results) / cfg.operations;
+
+		/* operations per nanosecond * 1000 == Mops/s */
+		std::cout << std::setw(10) << std::left << concurrency << std::setw(24) << mean_per_operation
+			  << 1000.0 * concurrency / mean_per_operation << std::endl;
+	}
+}
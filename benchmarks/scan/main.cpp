@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "measure.hpp"
+/* XXX: Change this header when make_pmemstream moved to public API */
+#include "stream_helpers.hpp"
+
+class config {
+ private:
+	static constexpr option long_options[] = {{"path", required_argument, NULL, 'p'},
+						  {"size", required_argument, NULL, 'x'},
+						  {"block_size", required_argument, NULL, 'b'},
+						  {"region_size", required_argument, NULL, 'r'},
+						  {"element_count", required_argument, NULL, 'c'},
+						  {"element_size", required_argument, NULL, 's'},
+						  {"iterations", required_argument, NULL, 'i'},
+						  {"concurrency", required_argument, NULL, 't'},
+						  {"prefetch_distance", required_argument, NULL, 'd'},
+						  {"help", no_argument, NULL, 'h'},
+						  {NULL, 0, NULL, 0}};
+
+	static std::string app_name;
+
+ public:
+	std::string path;
+	size_t size = TEST_DEFAULT_STREAM_SIZE * 10;
+	size_t block_size = TEST_DEFAULT_BLOCK_SIZE;
+	size_t region_size = TEST_DEFAULT_REGION_SIZE * 2;
+	size_t element_count = 10000;
+	size_t element_size = 64;
+	size_t iterations = 10;
+	size_t concurrency = 1;
+	size_t prefetch_distance = 0;
+
+	int parse_arguments(int argc, char *argv[])
+	{
+		app_name = std::string(argv[0]);
+		int ch;
+		while ((ch = getopt_long(argc, argv, "p:x:b:r:c:s:i:t:d:h", long_options, NULL)) != -1) {
+			switch (ch) {
+				case 'p':
+					path = std::string(optarg);
+					break;
+				case 'x':
+					size = std::stoull(optarg);
+					break;
+				case 'b':
+					block_size = std::stoull(optarg);
+					break;
+				case 'r':
+					region_size = std::stoull(optarg);
+					break;
+				case 'c':
+					element_count = std::stoull(optarg);
+					break;
+				case 's':
+					element_size = std::stoull(optarg);
+					break;
+				case 'i':
+					iterations = std::stoull(optarg);
+					break;
+				case 't':
+					concurrency = std::stoull(optarg);
+					break;
+				case 'd':
+					prefetch_distance = std::stoull(optarg);
+					break;
+				case 'h':
+					return -1;
+				default:
+					throw std::invalid_argument("Invalid argument");
+			}
+		}
+		if (path.empty()) {
+			throw std::invalid_argument("Please provide path");
+		}
+		if (concurrency == 0) {
+			throw std::invalid_argument("Concurrency must be greater than 0");
+		}
+		return 0;
+	}
+
+	static void print_usage()
+	{
+		std::vector<std::string> new_line = {"", ""};
+		std::vector<std::vector<std::string>> options = {
+			{"Usage: " + app_name + " [OPTION]...\n" +
+				 "Benchmark for sequential reads (scans) of entries.",
+			 ""},
+			new_line,
+			{"--path [path]", "path to file"},
+			{"--size [size]", "stream size"},
+			{"--block_size [size]", "block size"},
+			{"--region_size [size]", "region size"},
+			{"--element_count [count]", "number of elements in each region"},
+			{"--element_size [size]", "number of bytes of each element"},
+			{"--iterations [iterations]", "number of iterations"},
+			{"--concurrency [num]", "number of threads, each scanning its own region"},
+			{"--prefetch_distance [size]",
+			 "number of bytes prefetched ahead by the iterator (0 - disabled)"},
+			new_line,
+			{"More iterations gives more robust statistical data, but takes more time", ""},
+			{"--help", "display this message"}};
+		for (auto &option : options) {
+			std::cout << std::setw(28) << std::left << option[0] << " " << option[1] << std::endl;
+		}
+	}
+};
+std::string config::app_name;
+constexpr option config::long_options[];
+
+std::ostream &operator<<(std::ostream &out, config const &cfg)
+{
+	out << "Scan Benchmark, path: " << cfg.path << ", ";
+	out << "size: " << cfg.size << ", ";
+	out << "block_size: " << cfg.block_size << ", ";
+	out << "region_size: " << cfg.region_size << ", ";
+	out << "element_count: " << cfg.element_count << ", ";
+	out << "element_size: " << cfg.element_size << ", ";
+	out << "Number of iterations: " << cfg.iterations << ", ";
+	out << "Concurrency: " << cfg.concurrency << ", ";
+	out << "Prefetch distance: " << cfg.prefetch_distance << std::endl;
+	return out;
+}
+
+class pmemstream_scan_workload : public benchmark::workload_base {
+ public:
+	pmemstream_scan_workload(config &cfg) : cfg(cfg), checksums(cfg.concurrency, 0)
+	{
+		stream = make_pmemstream(cfg.path.c_str(), cfg.block_size, cfg.size);
+
+		/* Data is appended once - all iterations scan the same entries. */
+		prepare_data(cfg.element_size);
+		auto data_chunk = get_data_chunks();
+		for (size_t i = 0; i < cfg.concurrency; i++) {
+			pmemstream_region region;
+			if (pmemstream_region_allocate(stream.get(), cfg.region_size, &region)) {
+				throw std::runtime_error("Error during region allocate!");
+			}
+
+			for (size_t j = 0; j < cfg.element_count; j++) {
+				if (pmemstream_append(stream.get(), region, NULL, data_chunk, cfg.element_size, NULL)) {
+					throw std::runtime_error("Error while appending " + std::to_string(j) +
+								 " entry! Region is too small?");
+				}
+			}
+			regions.push_back(region);
+		}
+	}
+
+	void initialize() override
+	{
+	}
+
+	void perform(size_t thread_id) override
+	{
+		struct pmemstream_entry_iterator *it;
+		if (pmemstream_entry_iterator_new(&it, stream.get(), regions[thread_id])) {
+			throw std::runtime_error("Error during entry iterator new!");
+		}
+		pmemstream_entry_iterator_set_prefetch(it, cfg.prefetch_distance);
+
+		/* Read the whole data of each entry, so that the scan is not reduced to reading headers only. */
+		uint64_t checksum = 0;
+		size_t count = 0;
+		for (pmemstream_entry_iterator_seek_first(it); pmemstream_entry_iterator_is_valid(it) == 0;
+		     pmemstream_entry_iterator_next(it)) {
+			auto entry = pmemstream_entry_iterator_get(it);
+			auto data = reinterpret_cast<const uint8_t *>(pmemstream_entry_data(stream.get(), entry));
+			auto size = pmemstream_entry_size(stream.get(), entry);
+			for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+				uint64_t value = 0;
+				std::memcpy(&value, data + i, std::min(sizeof(value), size - i));
+				checksum ^= value;
+			}
+			++count;
+		}
+		pmemstream_entry_iterator_delete(&it);
+
+		if (count != cfg.element_count) {
+			throw std::runtime_error("Scanned " + std::to_string(count) + " entries in thread " +
+						 std::to_string(thread_id) + ", expected " +
+						 std::to_string(cfg.element_count));
+		}
+		checksums[thread_id] = checksum;
+	}
+
+	void clean() override
+	{
+	}
+
+ private:
+	config cfg;
+	std::unique_ptr<struct pmemstream, std::function<void(struct pmemstream *)>> stream;
+	std::vector<pmemstream_region> regions;
+	/* Keeps computed values alive, so that the compiler cannot skip reading data. */
+	std::vector<uint64_t> checksums;
+};
+
+int main(int argc, char *argv[])
+{
+	config cfg;
+	try {
+		if (cfg.parse_arguments(argc, argv) != 0) {
+			config::print_usage();
+			exit(0);
+		}
+	} catch (std::invalid_argument const &e) {
+		std::cerr << e.what() << std::endl;
+		exit(1);
+	}
+	std::cout << cfg << std::endl;
+
+	std::vector<std::chrono::nanoseconds::rep> results;
+	try {
+		pmemstream_scan_workload workload(cfg);
+		results = benchmark::measure<std::chrono::nanoseconds>(cfg.iterations, &workload, cfg.concurrency);
+	} catch (std::runtime_error &e) {
+		std::cerr << e.what() << std::endl;
+		return -2;
+	}
+
+	/* Each result is a time of scanning a single region (by a single thread). */
+	double bytes_per_region = static_cast<double>(cfg.element_count * cfg.element_size);
+	auto mean = benchmark::mean(results);
+	auto max = static_cast<double>(benchmark::max(results));
+	auto min = static_cast<double>(benchmark::min(results));
+
+	/* bytes per nanosecond == GB/s */
+	std::cout << "pmemstream scan measurement:" << std::endl;
+	std::cout << "\tmean[ns] per entry: " << mean / cfg.element_count << std::endl;
+	std::cout << "\tmean[GB/s] per thread: " << bytes_per_region / mean << std::endl;
+	std::cout << "\tmin[GB/s] per thread: " << bytes_per_region / max << std::endl;
+	std::cout << "\tmax[GB/s] per thread: " << bytes_per_region / min << std::endl;
+	std::cout << "\ttotal mean[GB/s]: " << bytes_per_region * cfg.concurrency / mean << std::endl;
+}
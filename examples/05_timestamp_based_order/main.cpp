@@ -4,10 +4,8 @@
 #include "examples_helpers.hpp"
 #include "libpmemstream.h"
 
-#include <algorithm>
 #include <iostream>
-#include <memory>
-#include <mutex>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -17,6 +15,7 @@
 /**
  * This example shows how to achieve global ordering of elements concurrently
  * appended to stream. Application operates in the region per thread manner.
+ * Entries are read back, in the order of appends, using global iterator.
  */
 
 /* User data. */
@@ -40,74 +39,6 @@ std::ostream &operator<<(std::ostream &os, const payload &data)
 	return os;
 }
 
-/* pmememstream entry iterator wrapper, which helps to manage entries from
- * different regions in global order. */
-class entry_iterator {
- public:
-	entry_iterator(pmemstream *stream, pmemstream_region &region) : stream(stream)
-	{
-		struct pmemstream_entry_iterator *new_entry_iterator;
-		if (pmemstream_entry_iterator_new(&new_entry_iterator, stream, region) != 0) {
-			throw std::runtime_error("Cannot create entry iterators");
-		}
-		it = std::shared_ptr<pmemstream_entry_iterator>(new_entry_iterator, [](pmemstream_entry_iterator *eit) {
-			pmemstream_entry_iterator_delete(&eit);
-		});
-		pmemstream_entry_iterator_seek_first(it.get());
-		if (pmemstream_entry_iterator_is_valid(it.get()) != 0) {
-			throw std::runtime_error("No entries to iterate");
-		}
-	}
-
-	void operator++()
-	{
-		pmemstream_entry_iterator_next(it.get());
-	}
-
-	bool operator<(entry_iterator &other)
-	{
-		if (pmemstream_entry_iterator_is_valid(it.get()) != 0)
-			return false;
-
-		if (pmemstream_entry_iterator_is_valid(other.it.get()) != 0)
-			return true;
-
-		return get_timestamp() < other.get_timestamp();
-	}
-
-	payload get_data()
-	{
-		if (pmemstream_entry_iterator_is_valid(it.get()) != 0) {
-			throw std::runtime_error("Invalid iterator");
-		}
-		return *reinterpret_cast<const payload *>(
-			pmemstream_entry_data(stream, pmemstream_entry_iterator_get(it.get())));
-	}
-
-	uint64_t get_timestamp()
-	{
-		if (pmemstream_entry_iterator_is_valid(it.get()) != 0) {
-			throw std::runtime_error("Invalid iterator");
-		}
-
-		auto this_entry = pmemstream_entry_iterator_get(it.get());
-		return pmemstream_entry_timestamp(stream, this_entry);
-	}
-
- private:
-	pmemstream *stream;
-	std::shared_ptr<pmemstream_entry_iterator> it;
-};
-
-std::vector<entry_iterator> get_entry_iterators(pmemstream *stream, std::vector<pmemstream_region> regions)
-{
-	std::vector<entry_iterator> entry_iterators;
-	for (auto &region : regions) {
-		entry_iterators.emplace_back(entry_iterator(stream, region));
-	}
-	return entry_iterators;
-}
-
 int main(int argc, char *argv[])
 {
 	if (argc < 2) {
@@ -136,15 +67,21 @@ int main(int argc, char *argv[])
 	});
 
 	/* Read data in order of appends */
-	auto entry_iterators = get_entry_iterators(stream, regions);
+	struct pmemstream_global_iterator *global_iterator;
+	if (pmemstream_global_iterator_new(&global_iterator, stream, regions.data(), regions.size()) != 0) {
+		throw std::runtime_error("Cannot create global iterator");
+	}
 
-	for (size_t i = 0; i < concurrency * samples_per_thread; i++) {
-		auto oldest_data = std::min_element(entry_iterators.begin(), entry_iterators.end());
-		payload entry = oldest_data->get_data();
-		std::cout << entry << " with timestamp: " << oldest_data->get_timestamp() << std::endl;
-		++(*oldest_data);
+	for (pmemstream_global_iterator_seek_first(global_iterator);
+	     pmemstream_global_iterator_is_valid(global_iterator) == 0;
+	     pmemstream_global_iterator_next(global_iterator)) {
+		auto oldest_entry = pmemstream_global_iterator_get(global_iterator);
+		payload entry = *reinterpret_cast<const payload *>(pmemstream_entry_data(stream, oldest_entry));
+		std::cout << entry << " with timestamp: " << pmemstream_entry_timestamp(stream, oldest_entry)
+			  << std::endl;
 	}
 
+	pmemstream_global_iterator_delete(&global_iterator);
 	pmemstream_delete(&stream);
 	pmem2_map_delete(&map);
 
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "parallel.h"
+#include "util.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* State shared by all workers. */
+struct parallel_for_data {
+	size_t count;
+	parallel_for_fn fn;
+	void *arg;
+
+	/* Index of the next item to be taken by any worker. */
+	size_t next_index;
+
+	/* Set to non-zero by the first worker which failed, stops all other workers. */
+	int error;
+};
+
+struct parallel_for_worker {
+	pthread_t thread;
+	size_t worker_id;
+	struct parallel_for_data *data;
+};
+
+static void *parallel_for_worker(void *arg)
+{
+	struct parallel_for_worker *worker = (struct parallel_for_worker *)arg;
+	struct parallel_for_data *data = worker->data;
+
+	while (true) {
+		int error;
+		atomic_load_relaxed(&data->error, &error);
+		if (error) {
+			break;
+		}
+
+		size_t index;
+		atomic_fetch_add_relaxed(&data->next_index, 1, &index);
+		if (index >= data->count) {
+			break;
+		}
+
+		if (data->fn(worker->worker_id, index, data->arg)) {
+			atomic_store_relaxed(&data->error, 1);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+int parallel_for(size_t nthreads, size_t count, parallel_for_fn fn, void *arg)
+{
+	assert(nthreads > 0);
+
+	/* There is no point in running more workers than there are items. */
+	if (nthreads > count) {
+		nthreads = count ? count : 1;
+	}
+
+	struct parallel_for_worker *workers = malloc(nthreads * sizeof(*workers));
+	if (!workers) {
+		return -1;
+	}
+
+	struct parallel_for_data data = {.count = count, .fn = fn, .arg = arg, .next_index = 0, .error = 0};
+
+	/* If spawning some thread fails, the remaining workers simply take over its share of items. */
+	size_t spawned = 1;
+	for (; spawned < nthreads; spawned++) {
+		workers[spawned].worker_id = spawned;
+		workers[spawned].data = &data;
+		if (pthread_create(&workers[spawned].thread, NULL, parallel_for_worker, &workers[spawned])) {
+			break;
+		}
+	}
+
+	workers[0].worker_id = 0;
+	workers[0].data = &data;
+	parallel_for_worker(&workers[0]);
+
+	for (size_t i = 1; i < spawned; i++) {
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	free(workers);
+	return data.error ? -1 : 0;
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+/* Simple pool of worker threads, used for processing independent work items in parallel. */
+
+#ifndef LIBPMEMSTREAM_PARALLEL_H
+#define LIBPMEMSTREAM_PARALLEL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Processes work item 'index'. 'worker_id' (in range [0, nthreads)) identifies the calling worker - no two workers
+ * run with the same id at once. Should return 0 on success. */
+typedef int (*parallel_for_fn)(size_t worker_id, size_t index, void *arg);
+
+/* Calls 'fn' for each index in range [0, count) using up to 'nthreads' workers. Worker 0 runs on the calling
+ * thread, items are taken by the workers one by one, so work is balanced between them. If 'fn' fails, remaining
+ * items are not processed.
+ *
+ * Returns 0 on success, -1 if 'fn' failed for any item or on allocation error. */
+int parallel_for(size_t nthreads, size_t count, parallel_for_fn fn, void *arg);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif /* LIBPMEMSTREAM_PARALLEL_H */
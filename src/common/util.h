@@ -22,6 +22,9 @@
 /* XXX: add support for different architectures. */
 #define CACHELINE_SIZE (64ULL)
 
+/* Hints the CPU to fetch cacheline containing 'addr' for reading. Data is expected to be accessed once. */
+#define PREFETCH_READ_ONCE(addr) __builtin_prefetch((addr), 0, 0)
+
 #ifdef PMEMSTREAM_USE_TSAN
 #define UTIL_TSAN_RELEASE(addr) __tsan_release(addr)
 #define UTIL_TSAN_ACQUIRE(addr) __tsan_acquire(addr)
@@ -78,6 +81,11 @@
 		__atomic_fetch_add((dst), (value), __ATOMIC_RELAXED);                                                  \
 	} while (0)
 
+#define atomic_sub_relaxed(dst, value)                                                                                 \
+	do {                                                                                                           \
+		__atomic_fetch_sub((dst), (value), __ATOMIC_RELAXED);                                                  \
+	} while (0)
+
 #define atomic_add_release(dst, value)                                                                                 \
 	do {                                                                                                           \
 		UTIL_TSAN_RELEASE((void *)(dst));                                                                      \
@@ -91,6 +99,12 @@
 		UTIL_TSAN_ACQUIRE((void *)(dst));                                                                      \
 	} while (0)
 
+/* full memory barrier */
+#define atomic_thread_fence_seq_cst()                                                                                  \
+	do {                                                                                                           \
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);                                                               \
+	} while (0)
+
 /* atomic_compare_exchange */
 #define atomic_compare_exchange_acquire_release(dst, expected, desired, weak, ret)                                     \
 	do {                                                                                                           \
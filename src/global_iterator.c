@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+/* Global (timestamp ordered) iterator - k-way merge of entry iterators over multiple regions. */
+
+#include "iterator.h"
+#include "libpmemstream_internal.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+static uint64_t global_iterator_entry_timestamp(const struct pmemstream_entry_iterator *iterator)
+{
+	const struct span_entry *span_entry =
+		(const struct span_entry *)span_offset_to_span_ptr(&iterator->stream->data, iterator->offset);
+	return span_entry->span_timestamped_base.timestamp;
+}
+
+static void global_iterator_heap_swap(struct global_iterator_heap_node *heap, size_t lhs, size_t rhs)
+{
+	struct global_iterator_heap_node tmp = heap[lhs];
+	heap[lhs] = heap[rhs];
+	heap[rhs] = tmp;
+}
+
+static void global_iterator_heap_sift_down(struct pmemstream_global_iterator *iterator, size_t node)
+{
+	struct global_iterator_heap_node *heap = iterator->heap;
+	while (true) {
+		size_t smallest = node;
+		size_t left = 2 * node + 1;
+		size_t right = 2 * node + 2;
+
+		if (left < iterator->heap_size && heap[left].timestamp < heap[smallest].timestamp)
+			smallest = left;
+		if (right < iterator->heap_size && heap[right].timestamp < heap[smallest].timestamp)
+			smallest = right;
+		if (smallest == node)
+			return;
+
+		global_iterator_heap_swap(heap, node, smallest);
+		node = smallest;
+	}
+}
+
+static void global_iterator_heap_pop(struct pmemstream_global_iterator *iterator)
+{
+	assert(iterator->heap_size > 0);
+
+	iterator->heap[0] = iterator->heap[--iterator->heap_size];
+	global_iterator_heap_sift_down(iterator, 0);
+}
+
+/* Builds heap out of all valid entry iterators. */
+static void global_iterator_heap_build(struct pmemstream_global_iterator *iterator)
+{
+	iterator->heap_size = 0;
+	for (size_t i = 0; i < iterator->entry_iterators_count; i++) {
+		struct pmemstream_entry_iterator *entry_iterator = &iterator->entry_iterators[i];
+		if (pmemstream_entry_iterator_is_valid(entry_iterator) != 0)
+			continue;
+
+		iterator->heap[iterator->heap_size].timestamp = global_iterator_entry_timestamp(entry_iterator);
+		iterator->heap[iterator->heap_size].index = i;
+		++iterator->heap_size;
+	}
+
+	for (size_t i = iterator->heap_size / 2; i > 0; i--) {
+		global_iterator_heap_sift_down(iterator, i - 1);
+	}
+}
+
+int pmemstream_global_iterator_new(struct pmemstream_global_iterator **iterator, struct pmemstream *stream,
+				   const struct pmemstream_region *regions, size_t regions_count)
+{
+	if (!iterator || !stream) {
+		return -1;
+	}
+
+	if (!regions && regions_count) {
+		return -1;
+	}
+
+	/* Allocated regions are collected at once, so that the number of regions cannot change while the iterator is
+	 * being initialized. */
+	struct pmemstream_region *allocated_regions = NULL;
+	if (!regions) {
+		allocated_regions = pmemstream_get_allocated_regions(stream, &regions_count);
+		if (!allocated_regions) {
+			return -1;
+		}
+		regions = allocated_regions;
+	}
+
+	struct pmemstream_global_iterator *iter = malloc(sizeof(*iter));
+	if (!iter) {
+		goto err_iter;
+	}
+
+	*(struct pmemstream **)&iter->stream = stream;
+	iter->entry_iterators_count = regions_count;
+	iter->heap_size = 0;
+
+	iter->entry_iterators = malloc(regions_count * sizeof(*iter->entry_iterators));
+	if (regions_count && !iter->entry_iterators) {
+		goto err_entry_iterators;
+	}
+
+	iter->heap = malloc(regions_count * sizeof(*iter->heap));
+	if (regions_count && !iter->heap) {
+		goto err_heap;
+	}
+
+	for (size_t i = 0; i < regions_count; i++) {
+		int ret = entry_iterator_initialize(&iter->entry_iterators[i], stream, regions[i], true);
+		if (ret) {
+			goto err_initialize;
+		}
+	}
+
+	free(allocated_regions);
+	*iterator = iter;
+
+	return 0;
+
+err_initialize:
+	free(iter->heap);
+err_heap:
+	free(iter->entry_iterators);
+err_entry_iterators:
+	free(iter);
+err_iter:
+	free(allocated_regions);
+	return -1;
+}
+
+int pmemstream_global_iterator_is_valid(struct pmemstream_global_iterator *iterator)
+{
+	if (!iterator) {
+		return -1;
+	}
+
+	if (iterator->heap_size == 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+void pmemstream_global_iterator_seek_first(struct pmemstream_global_iterator *iterator)
+{
+	if (!iterator) {
+		return;
+	}
+
+	for (size_t i = 0; i < iterator->entry_iterators_count; i++) {
+		pmemstream_entry_iterator_seek_first(&iterator->entry_iterators[i]);
+	}
+
+	global_iterator_heap_build(iterator);
+}
+
+void pmemstream_global_iterator_seek_timestamp(struct pmemstream_global_iterator *iterator, uint64_t timestamp)
+{
+	if (!iterator) {
+		return;
+	}
+
+	/* Entries within a single region are always ordered by timestamps. */
+	for (size_t i = 0; i < iterator->entry_iterators_count; i++) {
+		struct pmemstream_entry_iterator *entry_iterator = &iterator->entry_iterators[i];
+		pmemstream_entry_iterator_seek_first(entry_iterator);
+		while (pmemstream_entry_iterator_is_valid(entry_iterator) == 0 &&
+		       global_iterator_entry_timestamp(entry_iterator) < timestamp) {
+			pmemstream_entry_iterator_next(entry_iterator);
+		}
+	}
+
+	global_iterator_heap_build(iterator);
+}
+
+void pmemstream_global_iterator_next(struct pmemstream_global_iterator *iterator)
+{
+	if (!iterator) {
+		return;
+	}
+
+	if (iterator->heap_size == 0) {
+		return;
+	}
+
+	struct pmemstream_entry_iterator *entry_iterator = &iterator->entry_iterators[iterator->heap[0].index];
+	pmemstream_entry_iterator_next(entry_iterator);
+
+	if (pmemstream_entry_iterator_is_valid(entry_iterator) == 0) {
+		iterator->heap[0].timestamp = global_iterator_entry_timestamp(entry_iterator);
+		global_iterator_heap_sift_down(iterator, 0);
+	} else {
+		global_iterator_heap_pop(iterator);
+	}
+}
+
+struct pmemstream_entry pmemstream_global_iterator_get(struct pmemstream_global_iterator *iterator)
+{
+	struct pmemstream_entry entry = {.offset = PMEMSTREAM_INVALID_OFFSET};
+	if (pmemstream_global_iterator_is_valid(iterator) != 0) {
+		return entry;
+	}
+
+	return pmemstream_entry_iterator_get(&iterator->entry_iterators[iterator->heap[0].index]);
+}
+
+size_t pmemstream_global_iterator_get_batch(struct pmemstream_global_iterator *iterator,
+					    struct pmemstream_entry *entries, size_t entries_count)
+{
+	if (!entries) {
+		return 0;
+	}
+
+	size_t i = 0;
+	for (; i < entries_count && pmemstream_global_iterator_is_valid(iterator) == 0; i++) {
+		entries[i] = pmemstream_global_iterator_get(iterator);
+		pmemstream_global_iterator_next(iterator);
+	}
+
+	return i;
+}
+
+void pmemstream_global_iterator_delete(struct pmemstream_global_iterator **iterator)
+{
+	if (!iterator) {
+		return;
+	}
+	if (!(*iterator)) {
+		return;
+	}
+
+	struct pmemstream_global_iterator *iter = *iterator;
+
+	free(iter->heap);
+	free(iter->entry_iterators);
+	free(iter);
+	*iterator = NULL;
+}
@@ -21,7 +21,9 @@ extern "C" {
 #endif
 
 struct pmemstream;
+struct pmemstream_config;
 struct pmemstream_entry_iterator;
+struct pmemstream_global_iterator;
 struct pmemstream_region_iterator;
 struct pmemstream_region_runtime;
 struct pmemstream_region {
@@ -32,6 +34,56 @@ struct pmemstream_entry {
 	uint64_t offset;
 };
 
+/* Specifies which part of the stream's memory is prefaulted at open (see `pmemstream_config_set_prefault`). */
+enum pmemstream_prefault_mode {
+	PMEMSTREAM_PREFAULT_NONE,
+	/* Entire map is prefaulted (before the region allocator is recovered). */
+	PMEMSTREAM_PREFAULT_ALL,
+	/* Only allocated regions are prefaulted (after the region allocator is recovered). */
+	PMEMSTREAM_PREFAULT_REGIONS
+};
+
+/* Specifies when synchronous operations (`pmemstream_append`, `pmemstream_publish`) return. */
+enum pmemstream_persistence_mode {
+	/* After the entry is persisted - it will be available after a crash. */
+	PMEMSTREAM_PERSISTENCE_SYNC,
+	/* After the entry is committed - it is visible to readers, but it is guaranteed to survive a crash only after
+	 * persisted timestamp reaches its timestamp (e.g. after `pmemstream_async_wait_persisted` completes). */
+	PMEMSTREAM_PERSISTENCE_RELAXED
+};
+
+/* Single request of `pmemstream_entry_read_batch`. */
+struct pmemstream_entry_read_request {
+	struct pmemstream_entry entry;
+
+	/* Destination buffer and its size - at most 'size' bytes of entry's data are copied. */
+	void *dst;
+	size_t size;
+
+	/* Output: size of the entry's data. If it's bigger than 'size', the entry was copied only partially. */
+	size_t entry_size;
+};
+
+/* Maximum number of payload bytes which can be compared by the entry filter. */
+#define PMEMSTREAM_ENTRY_FILTER_PREFIX_SIZE 32
+
+/* Filter evaluated by an entry iterator (see `pmemstream_entry_iterator_set_filter`). An entry matches the filter
+ * if all of the following conditions are met:
+ * - its size is in range [min_size, max_size],
+ * - its timestamp is in range [min_timestamp, max_timestamp],
+ * - (data[i] & prefix_mask[i]) == (prefix[i] & prefix_mask[i]) for each i < PMEMSTREAM_ENTRY_FILTER_PREFIX_SIZE,
+ *   where 'data' is the entry's payload. Entries shorter than the compared part of the prefix (up to the last
+ *   non-zero byte of 'prefix_mask') never match. Zeroed 'prefix_mask' accepts all entries.
+ */
+struct pmemstream_entry_filter {
+	size_t min_size;
+	size_t max_size;
+	uint64_t min_timestamp;
+	uint64_t max_timestamp;
+	uint8_t prefix[PMEMSTREAM_ENTRY_FILTER_PREFIX_SIZE];
+	uint8_t prefix_mask[PMEMSTREAM_ENTRY_FILTER_PREFIX_SIZE];
+};
+
 struct pmemstream_async_wait_data {
 	struct pmemstream *stream;
 
@@ -50,27 +102,206 @@ struct pmemstream_async_wait_output {
 	int error_code;
 };
 
+/* Callback invoked by `pmemstream_scan_parallel` for each batch of entries read from 'region'.
+ * 'worker_id' is in range [0, nthreads) and identifies a worker thread calling the callback - it can be used
+ * to index per-worker data (e.g. accumulators) stored in 'ctx', which do not require any synchronization.
+ *
+ * Non-zero return value stops the scan.
+ */
+typedef int (*pmemstream_scan_callback)(struct pmemstream *stream, size_t worker_id, struct pmemstream_region region,
+					const struct pmemstream_entry *entries, size_t entries_count, void *ctx);
+
+/* Callback invoked by `pmemstream_region_compact` for each entry of the compacted region.
+ *
+ * Non-zero return value keeps the entry (it is copied to the new region), zero discards it.
+ */
+typedef int (*pmemstream_compact_callback)(struct pmemstream *stream, struct pmemstream_entry entry, void *ctx);
+
 FUTURE(pmemstream_async_wait_fut, struct pmemstream_async_wait_data, struct pmemstream_async_wait_output);
 
+struct pmemstream_async_next_data {
+	struct pmemstream_entry_iterator *iterator;
+
+	/* Set on the first poll, after the iterator was moved from its initial position. */
+	int started;
+};
+
+struct pmemstream_async_next_output {
+	int error_code;
+
+	/* Entry pointed by the iterator, after completion. */
+	struct pmemstream_entry entry;
+};
+
+FUTURE(pmemstream_async_next_fut, struct pmemstream_async_next_data, struct pmemstream_async_next_output);
+
+struct pmemstream_async_region_read_data {
+	/* Copy performed by the data mover. */
+	struct vdm_operation_future copy_future;
+};
+
+struct pmemstream_async_region_read_output {
+	int error_code;
+
+	/* Number of bytes copied to the destination buffer. */
+	size_t size;
+
+	/* Entry following the last copied one (it might not be committed yet) - next read can start from it. */
+	struct pmemstream_entry next_entry;
+};
+
+FUTURE(pmemstream_async_region_read_fut, struct pmemstream_async_region_read_data,
+       struct pmemstream_async_region_read_output);
+
+/* Entry copied to a buffer by `pmemstream_async_region_read` (see `pmemstream_copied_entry_next`). */
+struct pmemstream_copied_entry {
+	/* Points to the entry's data inside the buffer. */
+	const void *data;
+	size_t size;
+	uint64_t timestamp;
+};
+
+struct pmemstream_async_from_map_data {
+	struct pmemstream **stream;
+	struct pmem2_map *map;
+
+	/* Internal state of the opening. */
+	struct pmemstream *opening_stream;
+	int step;
+	int prefault;
+	size_t prefault_offset;
+	size_t prefault_threads;
+	size_t recovery_threads;
+	size_t region_pool_size;
+	size_t region_pool_count;
+};
+
+struct pmemstream_async_from_map_output {
+	int error_code;
+};
+
+FUTURE(pmemstream_async_from_map_fut, struct pmemstream_async_from_map_data, struct pmemstream_async_from_map_output);
+
 /* Creates new pmemstream instance from the given pmem2_map 'map' and assigns it to 'stream' pointer.
  * 'block_size' defines alignment of regions - must be a power of 2 and multiple of CACHELINE size.
  * See **libpmem2**(7) for details on creating pmem2 mapping.
  *
  * If this function is called with a map representing an empty file, the new pmemstream instance will be initialized.
  * If mapping points to a previously existing pmemstream instance, it re-opens it and reads persisted header's data.
- * In any other case, it's undefined behavior.
+ * Streams created by a version of the library with an incompatible on-media layout are not opened (the function fails
+ * and the stream is left untouched). In any other case, it's undefined behavior.
+ *
+ * By default, regions are recovered lazily (on their first use). To recover all regions at open time, in parallel
+ * by N threads, set env variable PMEMSTREAM_RECOVERY_THREADS=N.
+ *
+ * To prefault the entire map at open time, set env variable PMEMSTREAM_PREFAULT_AT_OPEN. If it is set to "regions",
+ * only allocated regions are prefaulted. Prefaulting is done in parallel by PMEMSTREAM_PREFAULT_THREADS threads.
  *
  * It returns 0 on success, error code otherwise.
  */
 int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pmem2_map *map);
 
-/* Releases the given 'stream' resources and sets 'stream' pointer to NULL. */
+/* Creates new configuration of a stream, with default values of all parameters, except 'block_size' which has to be
+ * set (using pmemstream_config_set_block_size) before the configuration is used. Configuration can be used for opening
+ * multiple streams and it can be deleted right after opening.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_new(struct pmemstream_config **config);
+
+/* Releases the given 'config' resources and sets 'config' pointer to NULL. */
+void pmemstream_config_delete(struct pmemstream_config **config);
+
+/* Sets alignment of regions - must be a power of 2 and multiple of CACHELINE size.
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_block_size(struct pmemstream_config *config, size_t block_size);
+
+/* Sets maximum number of operations which can be processed in the stream at any given moment (1024 by default).
+ * When all slots are taken, a thread has to wait for some of the previous operations to finish.
+ * 'max_concurrency' must be a power of 2.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_max_concurrency(struct pmemstream_config *config, size_t max_concurrency);
+
+/* Sets maximum number of timestamps committed by a single thread at once (15 by default). Bigger batches mean fewer
+ * synchronization points between committing threads, smaller ones - lower latency of a single commit.
+ * 'batch_size' must be greater than 0.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_commit_batch_size(struct pmemstream_config *config, size_t batch_size);
+
+/* Sets which part of the stream's memory is prefaulted at open and by how many threads ('nthreads' equal to 0 is
+ * treated as 1). Prefaulting is disabled by default.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_prefault(struct pmemstream_config *config, enum pmemstream_prefault_mode mode,
+				   size_t nthreads);
+
+/* Sets number of threads used for recovering all regions at open. If 0 (default), regions are recovered lazily
+ * (on their first use).
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_recovery_threads(struct pmemstream_config *config, size_t nthreads);
+
+/* Sets persistence mode of synchronous operations (PMEMSTREAM_PERSISTENCE_SYNC by default).
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_persistence_mode(struct pmemstream_config *config, enum pmemstream_persistence_mode mode);
+
+/* Enables a pool of up to 'count' pre-initialized regions of 'region_size' bytes, kept filled by a background thread
+ * (disabled by default, 'count' equal to 0 disables it). Pooled regions are allocated and prefaulted in advance, so
+ * allocating a region of that size (also a segment of a chained region) takes it from the pool with a single small
+ * persist. Other allocations, and allocations when the pool is empty, use the allocator directly.
+ *
+ * Pooled regions are not visible to the application, but they occupy the stream's space until the stream is deleted
+ * (or until next open, after a crash).
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_config_set_region_pool(struct pmemstream_config *config, size_t region_size, size_t count);
+
+/* Works like pmemstream_from_map, but the stream is tuned according to 'config' (environment variables are not
+ * taken into account).
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_from_config(struct pmemstream **stream, struct pmem2_map *map, const struct pmemstream_config *config);
+
+/* Returns future for opening a pmemstream instance - works like pmemstream_from_map, but each step of the opening
+ * (header check, optional prefault - in chunks, allocator recovery, marking regions for recovery, etc.) is performed
+ * by a separate poll, so the caller is never blocked for long.
+ *
+ * 'stream' is set only when the future completes successfully - the stream cannot be used (e.g. appended to) before.
+ * The future must be polled until completion. On error, output field `error_code` is set to non-zero value.
+ */
+struct pmemstream_async_from_map_fut pmemstream_async_from_map(struct pmemstream **stream, size_t block_size,
+							       struct pmem2_map *map);
+
+/* Returns future for opening a pmemstream instance - works like pmemstream_async_from_map, but the stream is tuned
+ * according to 'config' (like in pmemstream_from_config). 'config' is not used after this function returns.
+ */
+struct pmemstream_async_from_map_fut pmemstream_async_from_config(struct pmemstream **stream, struct pmem2_map *map,
+								  const struct pmemstream_config *config);
+
+/* Releases the given 'stream' resources and sets 'stream' pointer to NULL.
+ *
+ * If all appended entries are already persisted, tails of the regions are stored in the stream, so that
+ * they do not have to be found by iterating over entries at next open.
+ */
 void pmemstream_delete(struct pmemstream **stream);
 
 /* Allocates new region with specified 'size'. Actual size might be bigger due to alignment requirements.
  *
- * Only fixed-sized regions are supported for now (all `pmemstream_region_allocate` calls within a single
- * pmemstream instance have to use the same size).
+ * Regions of different sizes can be allocated within a single stream. Freed regions are split to fit
+ * the requested size and merged with adjacent free regions, so a reused region might only be slightly bigger
+ * than requested. Use pmemstream_region_size to get the actual size.
+ *
+ * Regions can be allocated and freed concurrently by multiple threads.
  *
  * Optional 'region' parameter is updated with the new region information.
  *
@@ -78,11 +309,105 @@ void pmemstream_delete(struct pmemstream **stream);
  */
 int pmemstream_region_allocate(struct pmemstream *stream, size_t size, struct pmemstream_region *region);
 
-/* Frees previously allocated, specified 'region'.
+/* Allocates 'count' regions with specified 'size' and stores them in 'regions' array. If possible, all regions are
+ * carved out of a single free space - this is much cheaper than 'count' calls to pmemstream_region_allocate,
+ * as metadata of all regions is persisted at once. Otherwise, regions are allocated one by one.
+ *
+ * Either all regions are allocated or none of them.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_region_allocate_many(struct pmemstream *stream, size_t size, size_t count,
+				    struct pmemstream_region *regions);
+
+/* Works like pmemstream_region_allocate, but the region additionally stores a marker for each block (of the stream's
+ * block_size) of its data. Markers let the region's tail be found in O(log n) time at recovery, instead of
+ * iterating over all entries. Reverse iteration uses them as well and scans only entries from a single block.
+ * Markers are kept at the end of the region, so its usable size is slightly smaller (16 bytes per block).
+ *
+ * Markers assume that entries in the region are published in the same order in which they were reserved.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_region_allocate_with_markers(struct pmemstream *stream, size_t size, struct pmemstream_region *region);
+
+/* Works like pmemstream_region_allocate, but the region is never full: once an entry does not fit in it, a new
+ * segment of the same size is allocated and linked to the region's last segment. Appends (and entry iterators)
+ * continue in the new segment transparently. Only the first segment is visible as a region (e.g. to region
+ * iterators) - all segments are freed together with it.
+ *
+ * Segment is appended only if all entries reserved in the region are published, otherwise pmemstream_reserve returns
+ * an error, as for a full region. Entries bigger than a single segment cannot be appended. Chained regions cannot be
+ * iterated over in reverse (pmemstream_entry_iterator_seek_last and pmemstream_entry_iterator_prev).
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_region_allocate_chained(struct pmemstream *stream, size_t size, struct pmemstream_region *region);
+
+/* Works like pmemstream_region_allocate, but the region is a ring buffer: it has a persistent head (its first entry),
+ * which is advanced by pmemstream_region_trim. Once an entry does not fit before the end of the region, appends wrap
+ * around to the region's beginning and reuse the space freed by trimming. Entry iterators start at the head. The head
+ * is kept at the end of the region, so its usable size is slightly smaller (one cacheline).
+ *
+ * As for chained regions, appends wrap around only if all entries reserved in the region are published, and ring
+ * regions cannot be iterated over in reverse.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_region_allocate_ring(struct pmemstream *stream, size_t size, struct pmemstream_region *region);
+
+/* Discards all entries of a ring 'region' which precede 'entry' - it becomes the first entry of the region. Space
+ * of the discarded entries is reused by subsequent appends, so they must not be accessed (e.g. by entry iterators)
+ * afterwards. 'entry' must be committed. The new head is persisted before this function returns.
+ *
+ * Trimming the same region concurrently is not allowed, but it can be done concurrently with appends.
+ *
+ * It returns 0 on success, error code otherwise (e.g. if the region is not a ring or 'entry' was already discarded).
+ */
+int pmemstream_region_trim(struct pmemstream *stream, struct pmemstream_region region, struct pmemstream_entry entry);
+
+/* Frees previously allocated, specified 'region'. The region must not be used (e.g. appended to or iterated over)
+ * during and after this call.
  * It returns 0 on success, error code otherwise.
  */
 int pmemstream_region_free(struct pmemstream *stream, struct pmemstream_region region);
 
+/* Discards all entries of the given 'region', so that it can be reused without freeing and allocating it again.
+ * Entries are not overwritten - the region's beginning is persistently marked as its end, which costs only a few
+ * small persists (for regions with markers, markers of used blocks are cleared as well). Segments of a chained region
+ * (other than the first one) are freed and the head of a ring region is moved to the region's beginning.
+ *
+ * There must be no entries reserved, but not yet published, in the region. The region must not be appended to nor
+ * iterated over during this call - entry iterators have to be moved to the region's beginning afterwards
+ * (e.g. by pmemstream_entry_iterator_seek_first).
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_region_clear(struct pmemstream *stream, struct pmemstream_region region);
+
+/* Replaces 'region' with a new region of the same size (stored in 'new_region'), containing only entries for which
+ * 'keep' returns non-zero value. Entries keep their order and timestamps. Kept entries are copied in batches of
+ * consecutive entries, using non-temporal stores, with a single drain at the end.
+ *
+ * The replacement is atomic: after a crash, either the old region (with all of its entries) or the new one is
+ * present. The old region is freed and must not be used afterwards - existing entry iterators and entries of the old
+ * region become invalid. Entries of the region which are committed, but not yet persisted, are waited for.
+ *
+ * There must be no entries reserved, but not yet published, in the region. Appends to the region fail while it is
+ * being compacted. The region must not be iterated over during this call. Chained and ring regions cannot be
+ * compacted.
+ *
+ * It returns 0 on success, error code otherwise.
+ */
+int pmemstream_region_compact(struct pmemstream *stream, struct pmemstream_region region,
+			      struct pmemstream_region *new_region, pmemstream_compact_callback keep, void *ctx);
+
+/* Frees 'count' regions from 'regions' array. Regions of similar sizes are returned to the allocator at once, which
+ * is cheaper than calling pmemstream_region_free for each of them.
+ * It returns 0 on success, error code otherwise (no region is freed if any of them is invalid).
+ */
+int pmemstream_region_free_many(struct pmemstream *stream, const struct pmemstream_region *regions, size_t count);
+
 /* Returns size of the given 'region'. It may be bigger than the size passed to 'pmemstream_region_allocate'
  * due to an alignment.
  * On error returns 0.
@@ -90,7 +415,8 @@ int pmemstream_region_free(struct pmemstream *stream, struct pmemstream_region r
 size_t pmemstream_region_size(struct pmemstream *stream, struct pmemstream_region region);
 
 /* Returns current usable (free) size of the given 'region'.
- * It equals to: 'region's end offset' - 'region's append offset'.
+ * It equals to: 'region's end offset' - 'region's append offset' (for chained regions: of the last segment).
+ * For ring regions, space before the head is included as well.
  *
  * This function serves only as an approximation of available space for use.
  * See `pmemstream_entry_size` to read more about space used by entries.
@@ -189,6 +515,40 @@ int pmemstream_async_append(struct pmemstream *stream, struct vdm *vdm, struct p
 			    struct pmemstream_region_runtime *region_runtime, const void *data, size_t size,
 			    struct pmemstream_entry *new_entry);
 
+/* Returns future for copying committed entries of the 'region' (starting from 'from_entry') to 'dst' buffer
+ * of given 'size', using 'vdm' data mover. It allows copying big ranges of entries (e.g. for replication or
+ * offloading to other medium) in the background - e.g. with a threaded data mover, while the application continues
+ * its work.
+ *
+ * Passing 'from_entry' with offset equal to UINT64_MAX (an invalid entry) starts the read from the first
+ * entry of the region. Only whole entries are copied, in their on-media format (entry metadata followed by data and
+ * padding), so the relative offsets of entries in 'dst' are the same as in the region. Copied entries can be parsed
+ * with `pmemstream_copied_entry_next`. Entries which are not committed at the moment of calling this function are
+ * not copied.
+ *
+ * When returned future is polled to completion, its output holds the number of copied bytes and an entry
+ * following the last copied one. If there are no entries to copy (or the first entry does not fit in 'dst'),
+ * the future completes without copying any data. For chained regions, entries of a single segment are copied
+ * at once (for ring regions - entries up to the point where appends wrapped around). On error, output field
+ * `error_code` is set to non-zero value.
+ */
+struct pmemstream_async_region_read_fut pmemstream_async_region_read(struct pmemstream *stream, struct vdm *vdm,
+								     struct pmemstream_region region,
+								     struct pmemstream_entry from_entry, void *dst,
+								     size_t size);
+
+/* Parses an entry copied by `pmemstream_async_region_read` - 'buffer' is the read's 'dst' and 'size' is the number
+ * of copied bytes (from the future's output). The entry which starts at '*offset' bytes from the beginning of
+ * 'buffer' is stored in 'entry' and '*offset' is moved to the next entry, so all copied entries can be visited
+ * starting from offset 0. The buffer does not need to be kept in the stream's memory (e.g. it can be sent over
+ * the network first).
+ *
+ * It returns 0 on success, or -1 if there are no more entries in the buffer (or it does not hold a valid entry
+ * at '*offset').
+ */
+int pmemstream_copied_entry_next(const void *buffer, size_t size, size_t *offset,
+				 struct pmemstream_copied_entry *entry);
+
 /* Returns the most recent committed timestamp in the given stream. All entries with timestamps less than or equal to
  * that timestamp can be treated as committed.
  *
@@ -231,6 +591,25 @@ struct pmemstream_async_wait_fut pmemstream_async_wait_persisted(struct pmemstre
  */
 const void *pmemstream_entry_data(struct pmemstream *stream, struct pmemstream_entry entry);
 
+/* Copies data of the given 'entry' to 'dst' buffer of given 'size'. If the entry is bigger than the buffer,
+ * only first 'size' bytes are copied. If 'entry_size' is not NULL, the size of the entry's data is stored there -
+ * the read was partial if it's bigger than 'size'.
+ * Unlike reading data through `pmemstream_entry_data`, big entries are read with non-temporal hints,
+ * which (where supported by the platform) limits eviction of the application's data from CPU caches.
+ *
+ * Returns 0 on success (also for a partial read), and error code otherwise.
+ */
+int pmemstream_entry_read(struct pmemstream *stream, struct pmemstream_entry entry, void *dst, size_t size,
+			  size_t *entry_size);
+
+/* Performs `pmemstream_entry_read` for each of 'count' 'requests' and sets their 'entry_size' fields. It's more
+ * efficient than reading entries one by one, as reading an entry overlaps with fetching the next one.
+ *
+ * Returns 0 on success, and error code otherwise. If any of the requests is invalid, no data is copied.
+ */
+int pmemstream_entry_read_batch(struct pmemstream *stream, struct pmemstream_entry_read_request *requests,
+				size_t count);
+
 /* Returns the size of the data of given 'entry'. It's the same value as was passed to `pmemstream_append`.
  * Note that pmemstream_entry contains metadata along with appended data - the space occupied
  * by pmemstream_entry is actually bigger than the size of appended data.
@@ -306,6 +685,35 @@ int pmemstream_entry_iterator_is_valid(struct pmemstream_entry_iterator *iterato
  */
 void pmemstream_entry_iterator_seek_first(struct pmemstream_entry_iterator *iterator);
 
+/* Sets entry 'iterator' to the last committed entry in the region (if such entry exists),
+ * or sets iterator to invalid entry.
+ *
+ * The first call for a given region scans all of its entries to build a sparse index of entries' offsets;
+ * subsequent calls only scan entries appended in the meantime. For chained and ring regions iterator is always set to
+ * invalid entry - they cannot be iterated over in reverse.
+ */
+void pmemstream_entry_iterator_seek_last(struct pmemstream_entry_iterator *iterator);
+
+/* Enables prefetching for the given entry 'iterator' (designed for sequential scans of large amounts of data).
+ * Each time the iterator is moved, the following 'distance' bytes of the region (rounded up to a cacheline size)
+ * are prefetched, along with a header of the next entry. This hides latency of reading the (next) entry while
+ * the current one is processed. Setting 'distance' to 0 disables prefetching (which is the default).
+ *
+ * Returns 0 on success, and error code otherwise.
+ */
+int pmemstream_entry_iterator_set_prefetch(struct pmemstream_entry_iterator *iterator, size_t distance);
+
+/* Sets 'filter' for the given entry 'iterator': `pmemstream_entry_iterator_seek_first()`,
+ * `pmemstream_entry_iterator_next()` and `pmemstream_entry_iterator_async_next()` skip all entries which do not
+ * match it (see `struct pmemstream_entry_filter`).
+ * Filter is evaluated inside the iteration loop, which is much cheaper than checking each entry by the caller.
+ * The filter is copied, passing NULL removes it. Other functions moving the iterator are not affected.
+ *
+ * Returns 0 on success, and error code otherwise.
+ */
+int pmemstream_entry_iterator_set_filter(struct pmemstream_entry_iterator *iterator,
+					 const struct pmemstream_entry_filter *filter);
+
 /* Moves entry 'iterator' to next entry if possible.
  * It iterates over all committed (but not necessarily persisted) entries. They are accessed
  * in the order of appending (which is always linear). Note: entries cannot be removed from the stream,
@@ -320,6 +728,30 @@ void pmemstream_entry_iterator_seek_first(struct pmemstream_entry_iterator *iter
  */
 void pmemstream_entry_iterator_next(struct pmemstream_entry_iterator *iterator);
 
+/* Moves entry 'iterator' to previous entry in the region. It allows reading entries in the reverse order
+ * of appending, e.g. (in combination with `pmemstream_entry_iterator_seek_last()`) reading N most recent entries.
+ * Each call scans only a small, bounded part of the region (using a sparse index of entries' offsets).
+ *
+ * If 'iterator' points to the first entry, it is set to invalid entry. If 'iterator' is past the last
+ * entry (it became invalid after `pmemstream_entry_iterator_next()`), it's moved to the last entry.
+ * For chained and ring regions 'iterator' is always set to invalid entry.
+ * Calling this function on not positioned iterator has no effect.
+ */
+void pmemstream_entry_iterator_prev(struct pmemstream_entry_iterator *iterator);
+
+/* Returns future for moving entry 'iterator' to the next entry in the region, which completes once such entry
+ * becomes visible (is committed). It allows tailing a region without busy polling: if a notifier is passed
+ * to `future_poll`, the future registers its waker and it is woken up when committed timestamp advances.
+ *
+ * If 'iterator' points to a valid entry, it's moved to the next one. If it's past the last entry (e.g. it became
+ * invalid after `pmemstream_entry_iterator_next`) or it was not yet positioned, it waits for the entry at its
+ * current position (or the first entry in the region, respectively).
+ *
+ * After completion, output field `entry` holds the entry pointed by 'iterator'. When the region has no more space
+ * for new entries, the future completes with non-zero `error_code`.
+ */
+struct pmemstream_async_next_fut pmemstream_entry_iterator_async_next(struct pmemstream_entry_iterator *iterator);
+
 /* Gets entry from the given entry 'iterator'.
  *
  * If the given iterator is valid, it returns an entry pointed by it,
@@ -330,6 +762,78 @@ struct pmemstream_entry pmemstream_entry_iterator_get(struct pmemstream_entry_it
 /* Releases the given 'iterator' resources and sets 'iterator' pointer to NULL. */
 void pmemstream_entry_iterator_delete(struct pmemstream_entry_iterator **iterator);
 
+/* Creates a new pmemstream_global_iterator and assigns it to 'iterator' pointer.
+ * Global iterator merges entries from multiple regions and returns them in the order of their timestamps
+ * (which is the order of appends within the whole stream).
+ *
+ * 'regions' is an array of 'regions_count' regions to iterate over. If 'regions' is NULL (and 'regions_count'
+ * is 0), iterator is bound to all regions existing in the stream at the time of this call.
+ *
+ * Default state is undefined: every new iterator should be moved (e.g.) to first element in the stream.
+ *
+ * Returns 0 on success, and error code otherwise.
+ */
+int pmemstream_global_iterator_new(struct pmemstream_global_iterator **iterator, struct pmemstream *stream,
+				   const struct pmemstream_region *regions, size_t regions_count);
+
+/* Checks that global 'iterator' is in valid state.
+ *
+ * Returns 0 when iterator is valid, and error code otherwise.
+ */
+int pmemstream_global_iterator_is_valid(struct pmemstream_global_iterator *iterator);
+
+/* Sets global 'iterator' to the entry with the lowest timestamp (if such entry exists),
+ * or sets iterator to invalid entry.
+ */
+void pmemstream_global_iterator_seek_first(struct pmemstream_global_iterator *iterator);
+
+/* Sets global 'iterator' to the first entry with timestamp greater than or equal to 'timestamp'
+ * (if such entry exists), or sets iterator to invalid entry.
+ */
+void pmemstream_global_iterator_seek_timestamp(struct pmemstream_global_iterator *iterator, uint64_t timestamp);
+
+/* Moves global 'iterator' to the entry with the next (greater) timestamp, if possible.
+ * Each call costs O(log(regions_count)).
+ *
+ * Calling this function on iterator pointing to an invalid entry is undefined behavior.
+ * It should always be called after `pmemstream_global_iterator_is_valid()`.
+ */
+void pmemstream_global_iterator_next(struct pmemstream_global_iterator *iterator);
+
+/* Gets entry from the given global 'iterator'.
+ *
+ * If the given iterator is valid, it returns an entry pointed by it,
+ * otherwise it returns an invalid entry.
+ */
+struct pmemstream_entry pmemstream_global_iterator_get(struct pmemstream_global_iterator *iterator);
+
+/* Copies up to 'entries_count' consecutive entries (in timestamp order), starting from the one pointed by the
+ * global 'iterator', into 'entries' array. Iterator is moved past the last copied entry.
+ *
+ * Returns number of entries written to 'entries' (0 if iterator was not valid).
+ */
+size_t pmemstream_global_iterator_get_batch(struct pmemstream_global_iterator *iterator,
+					    struct pmemstream_entry *entries, size_t entries_count);
+
+/* Releases the given 'iterator' resources and sets 'iterator' pointer to NULL. */
+void pmemstream_global_iterator_delete(struct pmemstream_global_iterator **iterator);
+
+/* Reads all entries from 'regions' (array of 'regions_count' regions) using up to 'nthreads' worker threads
+ * (including the calling thread). If 'regions' is NULL (and 'regions_count' is 0), all regions existing in the
+ * stream at the time of this call are scanned.
+ *
+ * Regions are distributed dynamically among the workers - each worker takes the next unprocessed region once
+ * it finishes the previous one. Entries within each region are passed to 'callback' in batches, in the order
+ * of appends. There is no ordering guarantee between different regions.
+ *
+ * Only entries committed before this call are visible - entries appended concurrently with the scan are skipped.
+ * Scanned regions must not be freed until this function returns.
+ *
+ * Returns 0 on success, and error code otherwise (including the case when 'callback' returned non-zero value).
+ */
+int pmemstream_scan_parallel(struct pmemstream *stream, const struct pmemstream_region *regions,
+			     size_t regions_count, size_t nthreads, pmemstream_scan_callback callback, void *ctx);
+
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
@@ -7,6 +7,7 @@
 #include "region.h"
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <string.h>
 
@@ -22,8 +23,6 @@ int pmemstream_region_iterator_new(struct pmemstream_region_iterator **iterator,
 	}
 
 	*(struct pmemstream **)&iter->stream = stream;
-
-	/* XXX: lock */
 	iter->region.offset = SLIST_INVALID_OFFSET;
 	*iterator = iter;
 
@@ -43,19 +42,38 @@ int pmemstream_region_iterator_is_valid(struct pmemstream_region_iterator *itera
 	return 0;
 }
 
+/* Segments of chained regions (other than the first one) are not visible as regions. Has to be called with the
+ * allocator's lock held. */
+static void pmemstream_region_iterator_skip_segments(struct pmemstream_region_iterator *iterator)
+{
+	while (iterator->region.offset != SLIST_INVALID_OFFSET &&
+	       region_is_continuation(&iterator->stream->data, iterator->region)) {
+		iterator->region.offset = SLIST_NEXT(struct span_region, &iterator->stream->data,
+						     iterator->region.offset, allocator_entry_metadata.next_allocated);
+	}
+}
+
+/* List of allocated regions is modified concurrently (e.g. by the region pool's worker), so it is read under the
+ * allocator's lock. */
 void pmemstream_region_iterator_seek_first(struct pmemstream_region_iterator *iterator)
 {
 	if (!iterator)
 		return;
+	pthread_mutex_lock(&iterator->stream->region_allocator.lock);
 	iterator->region.offset = iterator->stream->header->region_allocator_header.allocated_list.head;
+	pmemstream_region_iterator_skip_segments(iterator);
+	pthread_mutex_unlock(&iterator->stream->region_allocator.lock);
 }
 
 void pmemstream_region_iterator_next(struct pmemstream_region_iterator *iterator)
 {
 	if (!iterator)
 		return;
+	pthread_mutex_lock(&iterator->stream->region_allocator.lock);
 	iterator->region.offset = SLIST_NEXT(struct span_region, &iterator->stream->data, iterator->region.offset,
 					     allocator_entry_metadata.next_allocated);
+	pmemstream_region_iterator_skip_segments(iterator);
+	pthread_mutex_unlock(&iterator->stream->region_allocator.lock);
 }
 
 struct pmemstream_region pmemstream_region_iterator_get(struct pmemstream_region_iterator *iterator)
@@ -94,6 +112,11 @@ int entry_iterator_initialize(struct pmemstream_entry_iterator *iterator, struct
 
 	assert(span_get_type(span_offset_to_span_ptr(&stream->data, region.offset)) == SPAN_REGION);
 
+	/* Segments of chained regions are iterated over only as a part of the whole region. */
+	if (region_is_continuation(&stream->data, region)) {
+		return -1;
+	}
+
 	struct pmemstream_region_runtime *region_rt;
 	ret = region_runtimes_map_get_or_create(stream->region_runtimes_map, region, &region_rt);
 	if (ret) {
@@ -104,7 +127,12 @@ int entry_iterator_initialize(struct pmemstream_entry_iterator *iterator, struct
 						 .offset = PMEMSTREAM_INVALID_OFFSET,
 						 .region = region,
 						 .region_runtime = region_rt,
-						 .perform_recovery = perform_recovery};
+						 .segment = region,
+						 .perform_recovery = perform_recovery,
+						 .max_timestamp = UINT64_MAX,
+						 .prefetch_distance = 0,
+						 .prefetch_offset = 0,
+						 .filter_enabled = false};
 	memcpy(iterator, &iter, sizeof(struct pmemstream_entry_iterator));
 
 	return 0;
@@ -141,9 +169,8 @@ static bool pmemstream_entry_iterator_offset_is_inside_region(struct pmemstream_
 	/* XXX: we should update region_free to change 'region_span' into 'empty_span' and add check here
 	 * if the iterator is not on freed region; right now it would be costly to iterate over "free regions list"
 	 */
-	const struct span_base *span_base = span_offset_to_span_ptr(&iterator->stream->data, iterator->region.offset);
-	uint64_t region_end_offset = iterator->region.offset + span_get_total_size(span_base);
-	return iterator->offset >= iterator->region.offset && iterator->offset <= region_end_offset;
+	uint64_t region_end_offset = region_data_end_offset(&iterator->stream->data, iterator->segment);
+	return iterator->offset >= iterator->segment.offset && iterator->offset <= region_end_offset;
 }
 
 int pmemstream_entry_iterator_is_valid(struct pmemstream_entry_iterator *iterator)
@@ -174,6 +201,164 @@ static void pmemstream_entry_iterator_advance(struct pmemstream_entry_iterator *
 	iterator->offset += span_get_total_size(span_base);
 }
 
+/* Issues prefetches for the range [offset, offset + prefetch_distance), skipping cachelines which were already
+ * prefetched. Additionally, prefetches header of the entry following the current one - otherwise reading it is
+ * a dependent load (its offset is known only after reading size of the current entry). */
+static void pmemstream_entry_iterator_prefetch(struct pmemstream_entry_iterator *iterator)
+{
+	if (iterator->prefetch_distance == 0 || iterator->offset == PMEMSTREAM_INVALID_OFFSET) {
+		return;
+	}
+
+	const struct pmemstream_runtime *data = &iterator->stream->data;
+	uint64_t region_end_offset = region_data_end_offset(data, iterator->segment);
+
+	uint64_t prefetch_end = iterator->offset + iterator->prefetch_distance;
+	if (prefetch_end > region_end_offset) {
+		prefetch_end = region_end_offset;
+	}
+
+	uint64_t offset = ALIGN_DOWN(iterator->offset, CACHELINE_SIZE);
+	if (offset < iterator->prefetch_offset) {
+		offset = iterator->prefetch_offset;
+	}
+
+	for (; offset < prefetch_end; offset += CACHELINE_SIZE) {
+		PREFETCH_READ_ONCE(pmemstream_offset_to_ptr(data, offset));
+	}
+	if (offset > iterator->prefetch_offset) {
+		iterator->prefetch_offset = offset;
+	}
+
+	if (iterator->offset >= region_end_offset) {
+		return;
+	}
+
+	uint64_t next_offset =
+		iterator->offset + span_get_total_size(span_offset_to_span_ptr(data, iterator->offset));
+	if (next_offset >= iterator->prefetch_offset && next_offset < region_end_offset) {
+		PREFETCH_READ_ONCE(pmemstream_offset_to_ptr(data, next_offset));
+	}
+}
+
+int pmemstream_entry_iterator_set_prefetch(struct pmemstream_entry_iterator *iterator, size_t distance)
+{
+	if (!iterator) {
+		return -1;
+	}
+
+	iterator->prefetch_distance = ALIGN_UP(distance, CACHELINE_SIZE);
+	iterator->prefetch_offset = 0;
+	pmemstream_entry_iterator_prefetch(iterator);
+
+	return 0;
+}
+
+int pmemstream_entry_iterator_set_filter(struct pmemstream_entry_iterator *iterator,
+					 const struct pmemstream_entry_filter *filter)
+{
+	if (!iterator) {
+		return -1;
+	}
+
+	if (!filter) {
+		iterator->filter_enabled = false;
+		return 0;
+	}
+
+	struct entry_iterator_filter *f = &iterator->filter;
+	f->min_size = filter->min_size;
+	f->max_size = filter->max_size;
+	f->min_timestamp = filter->min_timestamp;
+	f->max_timestamp = filter->max_timestamp;
+
+	uint8_t prefix[PMEMSTREAM_ENTRY_FILTER_PREFIX_SIZE];
+	f->prefix_size = 0;
+	for (size_t i = 0; i < PMEMSTREAM_ENTRY_FILTER_PREFIX_SIZE; i++) {
+		prefix[i] = filter->prefix[i] & filter->prefix_mask[i];
+		if (filter->prefix_mask[i]) {
+			f->prefix_size = i + 1;
+		}
+	}
+	memcpy(f->prefix, prefix, sizeof(f->prefix));
+	memcpy(f->prefix_mask, filter->prefix_mask, sizeof(f->prefix_mask));
+
+	iterator->filter_enabled = true;
+	return 0;
+}
+
+/* Checks if entry pointed by a valid 'iterator' matches its filter. */
+static bool pmemstream_entry_iterator_matches_filter(struct pmemstream_entry_iterator *iterator)
+{
+	const struct entry_iterator_filter *f = &iterator->filter;
+	const struct span_entry *span_entry =
+		(const struct span_entry *)span_offset_to_span_ptr(&iterator->stream->data, iterator->offset);
+
+	size_t size = span_get_size(&span_entry->span_timestamped_base.span_base);
+	if (size < f->min_size || size > f->max_size || size < f->prefix_size) {
+		return false;
+	}
+
+	uint64_t timestamp = span_entry->span_timestamped_base.timestamp;
+	if (timestamp < f->min_timestamp || timestamp > f->max_timestamp) {
+		return false;
+	}
+
+	if (f->prefix_size == 0) {
+		return true;
+	}
+
+	/* Compare whole prefix at once (branch-free loop over fixed number of words is vectorized by the compiler).
+	 * Only the needed part of payload is read, the rest of the words is masked out anyway. */
+	uint64_t data[ENTRY_FILTER_PREFIX_WORDS] = {0};
+	memcpy(data, span_entry->data, f->prefix_size);
+
+	uint64_t diff = 0;
+	for (size_t i = 0; i < ENTRY_FILTER_PREFIX_WORDS; i++) {
+		diff |= (data[i] & f->prefix_mask[i]) ^ f->prefix[i];
+	}
+
+	return diff == 0;
+}
+
+/* Advances entry iterator by one. Returns true if the iterator points to a valid entry afterwards. */
+static bool pmemstream_entry_iterator_step(struct pmemstream_entry_iterator *iterator)
+{
+	assert(pmemstream_entry_iterator_is_valid(iterator) == 0);
+
+	struct pmemstream_entry_iterator tmp_iterator = *iterator;
+	pmemstream_entry_iterator_advance(&tmp_iterator);
+	if (!pmemstream_entry_iterator_offset_is_inside_region(&tmp_iterator)) {
+		/* This should not happen unless stream was corrupted. */
+		return false;
+	}
+
+	pmemstream_entry_iterator_advance(iterator);
+	/* Verify that all metadata and data fits inside the region after iterator
+	 * increment - this check should not fail unless stream was corrupted. */
+	assert(pmemstream_entry_iterator_offset_is_inside_region(iterator));
+
+	if (check_entry_and_maybe_recover_region(iterator)) {
+		pmemstream_entry_iterator_prefetch(iterator);
+		return true;
+	}
+	return false;
+}
+
+/* Moves valid entry iterator forward, to the first entry matching its filter (if any). */
+static void pmemstream_entry_iterator_skip_filtered(struct pmemstream_entry_iterator *iterator)
+{
+	if (!iterator->filter_enabled) {
+		return;
+	}
+
+	while (!pmemstream_entry_iterator_matches_filter(iterator)) {
+		if (!pmemstream_entry_iterator_step(iterator)) {
+			return;
+		}
+	}
+}
+
 /* Advances entry iterator by one. Verifies entry integrity and initializes region runtime if end of data is found. */
 void pmemstream_entry_iterator_next(struct pmemstream_entry_iterator *iterator)
 {
@@ -185,17 +370,134 @@ void pmemstream_entry_iterator_next(struct pmemstream_entry_iterator *iterator)
 		return;
 	}
 
-	assert(pmemstream_entry_iterator_is_valid(iterator) == 0);
+	if (pmemstream_entry_iterator_step(iterator)) {
+		pmemstream_entry_iterator_skip_filtered(iterator);
+	}
+}
 
-	struct pmemstream_entry_iterator tmp_iterator = *iterator;
-	pmemstream_entry_iterator_advance(&tmp_iterator);
-	if (pmemstream_entry_iterator_offset_is_inside_region(&tmp_iterator)) {
-		pmemstream_entry_iterator_advance(iterator);
-		/* Verify that all metadata and data fits inside the region after iterator
-		 * increment - this check should not fail unless stream was corrupted. */
-		assert(pmemstream_entry_iterator_offset_is_inside_region(iterator));
+/* Checks if there is enough space in the region for an entry to be appended at iterator's offset. Chained and ring
+ * regions are never full - next entry will be appended to a new segment (or at the beginning of the region). */
+static bool pmemstream_entry_iterator_has_space_for_entry(struct pmemstream_entry_iterator *iterator)
+{
+	uint64_t region_end_offset = region_data_end_offset(&iterator->stream->data, iterator->segment);
+	return iterator->offset + sizeof(struct span_entry) <= region_end_offset ||
+		region_is_chained(&iterator->stream->data, iterator->segment) ||
+		region_is_ring(&iterator->stream->data, iterator->region);
+}
+
+/* Moves iterator from its initial position to the place where the next entry is (or will be) located.
+ * Returns -1 if there is no space for next entry in the region. */
+static int pmemstream_entry_iterator_async_next_start(struct pmemstream_entry_iterator *iterator)
+{
+	if (iterator->offset == PMEMSTREAM_INVALID_OFFSET) {
+		pmemstream_entry_iterator_seek_first(iterator);
+		if (iterator->offset == PMEMSTREAM_INVALID_OFFSET) {
+			/* Region is empty - wait for the first entry. */
+			iterator->segment = iterator->region;
+			iterator->offset = region_head_offset(&iterator->stream->data, iterator->region);
+		}
+		return 0;
+	}
+
+	if (pmemstream_entry_iterator_is_valid(iterator) == 0) {
+		uint64_t offset = iterator->offset;
+		pmemstream_entry_iterator_next(iterator);
+		if (iterator->offset == offset) {
+			/* Last entry ends at the end of the region. */
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Checks if the entry awaited by 'iterator' is already available. Entries which do not match the iterator's
+ * filter are skipped. Returns 0 if iterator points to a matching entry, 1 if it has to wait for the next entry
+ * or -1 if there is no space for more entries in the region. */
+static int pmemstream_entry_iterator_async_next_poll(struct pmemstream_entry_iterator *iterator)
+{
+	/* Iterator might be waiting at the end of a full segment - move on once the next one is linked (or once appends
+	 * to a ring region wrap around). */
+	if (pmemstream_entry_iterator_is_valid(iterator) != 0 && !region_follow_chain(iterator)) {
+		region_follow_wrap(iterator);
 	}
-	check_entry_and_maybe_recover_region(iterator);
+
+	while (pmemstream_entry_iterator_is_valid(iterator) == 0) {
+		if (!iterator->filter_enabled || pmemstream_entry_iterator_matches_filter(iterator)) {
+			return 0;
+		}
+
+		uint64_t offset = iterator->offset;
+		pmemstream_entry_iterator_step(iterator);
+		if (iterator->offset == offset) {
+			/* Skipped entry ends at the end of the region. */
+			return -1;
+		}
+	}
+
+	return pmemstream_entry_iterator_has_space_for_entry(iterator) ? 1 : -1;
+}
+
+static enum future_state pmemstream_entry_iterator_async_next_impl(struct future_context *ctx,
+								   struct future_notifier *notifier)
+{
+	if (notifier != NULL) {
+		notifier->notifier_used = FUTURE_NOTIFIER_NONE;
+	}
+
+	struct pmemstream_async_next_data *data = future_context_get_data(ctx);
+	struct pmemstream_async_next_output *out = future_context_get_output(ctx);
+	struct pmemstream_entry_iterator *iterator = data->iterator;
+
+	if (!data->started) {
+		data->started = 1;
+		if (pmemstream_entry_iterator_async_next_start(iterator)) {
+			out->error_code = -1;
+			return FUTURE_STATE_COMPLETE;
+		}
+	}
+
+	int ret = pmemstream_entry_iterator_async_next_poll(iterator);
+	if (ret < 0) {
+		out->error_code = -1;
+		return FUTURE_STATE_COMPLETE;
+	} else if (ret == 0) {
+		out->entry = pmemstream_entry_iterator_get(iterator);
+		return FUTURE_STATE_COMPLETE;
+	}
+
+	if (notifier != NULL && pmemstream_register_commit_waker(iterator->stream, &notifier->waker) == 0) {
+		notifier->notifier_used = FUTURE_NOTIFIER_WAKER;
+
+		/* Entry might have been committed before the waker was registered. */
+		ret = pmemstream_entry_iterator_async_next_poll(iterator);
+		if (ret <= 0) {
+			notifier->notifier_used = FUTURE_NOTIFIER_NONE;
+			out->error_code = ret;
+			out->entry = pmemstream_entry_iterator_get(iterator);
+			return FUTURE_STATE_COMPLETE;
+		}
+	}
+
+	return FUTURE_STATE_RUNNING;
+}
+
+struct pmemstream_async_next_fut pmemstream_entry_iterator_async_next(struct pmemstream_entry_iterator *iterator)
+{
+	struct pmemstream_async_next_fut future;
+	future.data.iterator = iterator;
+	future.data.started = 0;
+	future.output.entry.offset = PMEMSTREAM_INVALID_OFFSET;
+
+	if (!iterator) {
+		future.output.error_code = -1;
+		FUTURE_INIT_COMPLETE(&future);
+	} else {
+		future.output.error_code = 0;
+		FUTURE_INIT(&future, pmemstream_entry_iterator_async_next_impl);
+	}
+
+	return future;
 }
 
 void pmemstream_entry_iterator_seek_first(struct pmemstream_entry_iterator *iterator)
@@ -205,13 +507,67 @@ void pmemstream_entry_iterator_seek_first(struct pmemstream_entry_iterator *iter
 	}
 	struct pmemstream_entry_iterator tmp_iterator = *iterator;
 
-	tmp_iterator.offset = region_first_entry_offset(iterator->region);
+	tmp_iterator.segment = iterator->region;
+	tmp_iterator.offset = region_head_offset(&iterator->stream->data, iterator->region);
 	if (!check_entry_and_maybe_recover_region(&tmp_iterator)) {
 		iterator->offset = PMEMSTREAM_INVALID_OFFSET;
 		return;
 	}
+	iterator->segment = tmp_iterator.segment;
 	iterator->offset = tmp_iterator.offset;
 	assert(pmemstream_entry_iterator_is_valid(iterator) == 0);
+
+	iterator->prefetch_offset = 0;
+	pmemstream_entry_iterator_prefetch(iterator);
+
+	pmemstream_entry_iterator_skip_filtered(iterator);
+}
+
+void pmemstream_entry_iterator_seek_last(struct pmemstream_entry_iterator *iterator)
+{
+	if (!iterator) {
+		return;
+	}
+
+	if (iterator->perform_recovery) {
+		/* Same as after iterating past the last entry - region becomes ready for appends. Recovery looks
+		 * for the tail and indexes all entries on the way, so the lookup below does not scan the region. */
+		if (region_runtime_iterate_and_initialize_for_write_locked(iterator->stream, iterator->region,
+									   iterator->region_runtime)) {
+			iterator->offset = PMEMSTREAM_INVALID_OFFSET;
+			return;
+		}
+	}
+
+	uint64_t last_offset;
+	if (region_runtime_find_last_entry(iterator->stream, iterator->region_runtime, &last_offset)) {
+		iterator->offset = PMEMSTREAM_INVALID_OFFSET;
+		return;
+	}
+
+	iterator->offset = last_offset;
+	/* Entries before the current one would be accessed next - forward prefetching is of no use. */
+	iterator->prefetch_offset = 0;
+}
+
+void pmemstream_entry_iterator_prev(struct pmemstream_entry_iterator *iterator)
+{
+	if (!iterator) {
+		return;
+	}
+
+	if (iterator->offset == PMEMSTREAM_INVALID_OFFSET) {
+		return;
+	}
+
+	uint64_t prev_offset;
+	if (region_runtime_find_entry_before(iterator->stream, iterator->region_runtime, iterator->offset,
+					     &prev_offset)) {
+		prev_offset = PMEMSTREAM_INVALID_OFFSET;
+	}
+
+	iterator->offset = prev_offset;
+	iterator->prefetch_offset = 0;
 }
 
 struct pmemstream_entry pmemstream_entry_iterator_get(struct pmemstream_entry_iterator *iterator)
@@ -15,12 +15,46 @@
 extern "C" {
 #endif
 
+/* Number of 64-bit words compared by the entry filter. */
+#define ENTRY_FILTER_PREFIX_WORDS (PMEMSTREAM_ENTRY_FILTER_PREFIX_SIZE / sizeof(uint64_t))
+
+/* Internal representation of struct pmemstream_entry_filter. */
+struct entry_iterator_filter {
+	size_t min_size;
+	size_t max_size;
+	uint64_t min_timestamp;
+	uint64_t max_timestamp;
+
+	/* Prefix (already masked) and its mask, stored as words so that they can be compared at once. */
+	uint64_t prefix[ENTRY_FILTER_PREFIX_WORDS];
+	uint64_t prefix_mask[ENTRY_FILTER_PREFIX_WORDS];
+
+	/* Number of payload bytes which have to be compared (up to the last non-zero byte of the mask). */
+	size_t prefix_size;
+};
+
 struct pmemstream_entry_iterator {
 	bool perform_recovery;
 	struct pmemstream *const stream;
 	const struct pmemstream_region region;
 	struct pmemstream_region_runtime *const region_runtime;
+
+	/* Segment of a chained region which contains offset ('region' for regions which are not chained). */
+	struct pmemstream_region segment;
 	uint64_t offset;
+
+	/* Entries with timestamps greater than this value are treated as not (yet) committed. Allows iterating
+	 * over a consistent snapshot of the stream. */
+	uint64_t max_timestamp;
+
+	/* Number of bytes (after current offset) to be prefetched, 0 means prefetching is disabled. */
+	size_t prefetch_distance;
+	/* End of already prefetched range. */
+	uint64_t prefetch_offset;
+
+	/* If set, entries not matching the filter are skipped by seek_first and next. */
+	bool filter_enabled;
+	struct entry_iterator_filter filter;
 };
 
 struct pmemstream_region_iterator {
@@ -28,6 +62,25 @@ struct pmemstream_region_iterator {
 	struct pmemstream_region region;
 };
 
+struct global_iterator_heap_node {
+	/* Timestamp of an entry currently pointed by entry_iterators[index]. */
+	uint64_t timestamp;
+	size_t index;
+};
+
+struct pmemstream_global_iterator {
+	struct pmemstream *const stream;
+
+	/* One entry iterator per each region bound to this iterator. */
+	struct pmemstream_entry_iterator *entry_iterators;
+	size_t entry_iterators_count;
+
+	/* Binary min-heap (ordered by timestamp) of valid entry iterators. Top of the heap points to
+	 * the current entry of the global iterator. */
+	struct global_iterator_heap_node *heap;
+	size_t heap_size;
+};
+
 /* Initializes pmemstream_entry_iterator pointed to by 'iterator'. 'perform_recovery' specifies whether this iterator
  * should perform region recovery when last valid entry is found. */
 int entry_iterator_initialize(struct pmemstream_entry_iterator *iterator, struct pmemstream *stream,
@@ -10,11 +10,28 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+/* Entries with data bigger than this are read with non-temporal prefetches (see pmemstream_entry_read). */
+#define ENTRY_READ_NON_TEMPORAL_THRESHOLD 4096UL
+
+/* Number of bytes prefetched ahead of currently copied data. */
+#define ENTRY_READ_PREFETCH_DISTANCE 1024UL
+
+/* Big entries are copied in blocks of this size, interleaved with prefetching the following data. */
+#define ENTRY_READ_BLOCK_SIZE 256UL
+
+/* Returns true if the stream has a signature, but it was created with a different layout version. */
+static bool pmemstream_is_incompatible(struct pmemstream *stream)
+{
+	return strcmp(stream->header->signature, PMEMSTREAM_SIGNATURE) == 0 &&
+	       stream->header->layout_version != PMEMSTREAM_LAYOUT_VERSION;
+}
+
 static int pmemstream_is_initialized(struct pmemstream *stream)
 {
 	if (strcmp(stream->header->signature, PMEMSTREAM_SIGNATURE) != 0) {
@@ -37,9 +54,15 @@ static void pmemstream_init(struct pmemstream *stream)
 
 	allocator_initialize(&stream->data, &stream->header->region_allocator_header, stream->usable_size);
 
+	stream->header->layout_version = PMEMSTREAM_LAYOUT_VERSION;
 	stream->header->stream_size = stream->stream_size;
 	stream->header->block_size = stream->block_size;
 	stream->header->persisted_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	stream->header->active_regions.overflow = 0;
+	for (size_t i = 0; i < PMEMSTREAM_ACTIVE_REGIONS_MAX; i++) {
+		stream->header->active_regions.offsets[i] = PMEMSTREAM_INVALID_OFFSET;
+	}
+	stream->header->clean_shutdown = 0;
 	stream->data.persist(stream->header, sizeof(struct pmemstream_header));
 	stream->persisted_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
 	stream->data.memcpy(stream->header->signature, PMEMSTREAM_SIGNATURE, strlen(PMEMSTREAM_SIGNATURE),
@@ -57,6 +80,12 @@ static size_t pmemstream_usable_size(size_t stream_size, size_t block_size)
 	return ALIGN_DOWN(stream_size - pmemstream_header_size_aligned(block_size), block_size);
 }
 
+static size_t pmemstream_region_total_size_aligned(struct pmemstream *stream, size_t size)
+{
+	struct span_region span_region = {.span_base = span_base_create(size, SPAN_REGION)};
+	return ALIGN_UP(span_get_total_size(&span_region.span_base), stream->block_size);
+}
+
 static int pmemstream_validate_sizes(size_t block_size, struct pmem2_map *map)
 {
 	if (block_size == 0) {
@@ -95,8 +124,69 @@ static int pmemstream_validate_sizes(size_t block_size, struct pmem2_map *map)
 	return 0;
 }
 
-/* XXX: this function could be made asynchronous perhaps? */
-static int pmemstream_mark_regions_for_recovery(struct pmemstream *stream)
+static void pmemstream_mark_region_for_recovery(struct pmemstream *stream, struct pmemstream_region region)
+{
+	/* Each segment of a chained region is marked - segments which were sealed before the crash might still
+	 * contain entries which were not persisted. */
+	for (; region.offset != PMEMSTREAM_INVALID_OFFSET; region = region_next_segment(&stream->data, region)) {
+		struct span_region *span_region =
+			(struct span_region *)span_offset_to_span_ptr(&stream->data, region.offset);
+		if (span_region->max_valid_timestamp > stream->header->persisted_timestamp) {
+			span_region->max_valid_timestamp = stream->header->persisted_timestamp;
+			stream->data.flush(&span_region->max_valid_timestamp, sizeof(span_region->max_valid_timestamp));
+		} else {
+			/* If max_valid_timestamp is equal to a valid timestamp, this means that these regions
+			 * hasn't recovered after previous restart yet (or the segment is sealed), skip it. */
+		}
+	}
+}
+
+struct pmemstream_region *pmemstream_get_allocated_regions(struct pmemstream *stream, size_t *regions_count)
+{
+	/* Allocated list must not be modified while it is walked. */
+	pthread_mutex_lock(&stream->region_allocator.lock);
+
+	/* Segments of chained regions (other than the first one) are not visible as regions. */
+	size_t count = 0;
+	uint64_t offset;
+	SLIST_FOREACH(struct span_region, &stream->data, &stream->header->region_allocator_header.allocated_list,
+		      offset, allocator_entry_metadata.next_allocated)
+	{
+		struct pmemstream_region region = {.offset = offset};
+		if (!region_is_continuation(&stream->data, region)) {
+			++count;
+		}
+	}
+
+	/* Allocate at least one element, so that NULL always means an error. */
+	struct pmemstream_region *regions = malloc((count ? count : 1) * sizeof(*regions));
+	if (!regions) {
+		pthread_mutex_unlock(&stream->region_allocator.lock);
+		return NULL;
+	}
+
+	/* Regions allocated after counting are not taken into account. */
+	size_t i = 0;
+	SLIST_FOREACH(struct span_region, &stream->data, &stream->header->region_allocator_header.allocated_list,
+		      offset, allocator_entry_metadata.next_allocated)
+	{
+		struct pmemstream_region region = {.offset = offset};
+		if (region_is_continuation(&stream->data, region)) {
+			continue;
+		}
+		if (i == count) {
+			break;
+		}
+		regions[i++] = region;
+	}
+
+	pthread_mutex_unlock(&stream->region_allocator.lock);
+
+	*regions_count = i;
+	return regions;
+}
+
+static int pmemstream_mark_all_regions_for_recovery(struct pmemstream *stream)
 {
 	struct pmemstream_region_iterator *iterator;
 	int ret = pmemstream_region_iterator_new(&iterator, stream);
@@ -104,39 +194,128 @@ static int pmemstream_mark_regions_for_recovery(struct pmemstream *stream)
 		return ret;
 	}
 
-	/* XXX: we could keep list of active regions in stream header/lanes and only iterate over them. */
-	struct pmemstream_region region;
 	pmemstream_region_iterator_seek_first(iterator);
 
 	while (pmemstream_region_iterator_is_valid(iterator) == 0) {
-		region = pmemstream_region_iterator_get(iterator);
-		struct span_region *span_region =
-			(struct span_region *)span_offset_to_span_ptr(&stream->data, region.offset);
-		if (span_region->max_valid_timestamp == UINT64_MAX) {
-			span_region->max_valid_timestamp = stream->header->persisted_timestamp;
-			stream->data.flush(&span_region->max_valid_timestamp, sizeof(span_region->max_valid_timestamp));
-		} else {
-			/* If max_valid_timestamp is equal to a valid timestamp, this means that these regions
-			 * hasn't recovered after previous restart yet, skip it. */
-		}
+		pmemstream_mark_region_for_recovery(stream, pmemstream_region_iterator_get(iterator));
 		pmemstream_region_iterator_next(iterator);
 	}
-	stream->data.drain();
 
 	pmemstream_region_iterator_delete(&iterator);
 
 	return 0;
 }
 
+/* Marks for recovery all regions which might have been appended to since the previous open. Other regions contain
+ * only persisted entries and are left untouched. Afterwards, the set of active regions is cleared. */
+static int pmemstream_mark_regions_for_recovery(struct pmemstream *stream)
+{
+	struct pmemstream_active_regions *active_regions = &stream->header->active_regions;
+
+	if (active_regions->overflow) {
+		int ret = pmemstream_mark_all_regions_for_recovery(stream);
+		if (ret) {
+			return ret;
+		}
+	} else {
+		for (size_t i = 0; i < PMEMSTREAM_ACTIVE_REGIONS_MAX; i++) {
+			struct pmemstream_region region = {.offset = active_regions->offsets[i]};
+			if (region.offset == PMEMSTREAM_INVALID_OFFSET) {
+				continue;
+			}
+			/* Should not happen unless the stream is corrupted. */
+			if (pmemstream_validate_stream_and_offset(stream, region.offset) ||
+			    span_get_type(span_offset_to_span_ptr(&stream->data, region.offset)) != SPAN_REGION) {
+				continue;
+			}
+			pmemstream_mark_region_for_recovery(stream, region);
+		}
+	}
+	stream->data.drain();
+
+	/* Marked regions will be added to the set again on their first append. */
+	for (size_t i = 0; i < PMEMSTREAM_ACTIVE_REGIONS_MAX; i++) {
+		active_regions->offsets[i] = PMEMSTREAM_INVALID_OFFSET;
+	}
+	active_regions->overflow = 0;
+	stream->data.persist(active_regions, sizeof(*active_regions));
+
+	return 0;
+}
+
+static void pmemstream_invalidate_tail_hint(struct pmemstream *stream, struct pmemstream_region region)
+{
+	struct span_region *span_region = (struct span_region *)span_offset_to_span_ptr(&stream->data, region.offset);
+	if (span_region->tail_offset_hint != PMEMSTREAM_INVALID_OFFSET) {
+		span_region->tail_offset_hint = PMEMSTREAM_INVALID_OFFSET;
+		stream->data.persist(&span_region->tail_offset_hint, sizeof(span_region->tail_offset_hint));
+	}
+}
+
+/* Persistently adds region to the set of active regions. Must be done before anything is appended to the region
+ * (in the current session). If the set is full, all regions will be marked for recovery at next open. */
+static void pmemstream_add_active_region(struct pmemstream *stream, struct pmemstream_region region,
+					 struct pmemstream_region_runtime *region_runtime)
+{
+	struct pmemstream_active_regions *active_regions = &stream->header->active_regions;
+
+	pthread_mutex_lock(&stream->active_regions_lock);
+	if (region_runtime_is_active_acquire(region_runtime)) {
+		/* Some other thread has already added this region. */
+		goto out;
+	}
+
+	size_t free_slot = PMEMSTREAM_ACTIVE_REGIONS_MAX;
+	for (size_t i = 0; i < PMEMSTREAM_ACTIVE_REGIONS_MAX; i++) {
+		if (active_regions->offsets[i] == region.offset) {
+			goto set_active;
+		}
+		if (active_regions->offsets[i] == PMEMSTREAM_INVALID_OFFSET &&
+		    free_slot == PMEMSTREAM_ACTIVE_REGIONS_MAX) {
+			free_slot = i;
+		}
+	}
+
+	if (free_slot != PMEMSTREAM_ACTIVE_REGIONS_MAX) {
+		active_regions->offsets[free_slot] = region.offset;
+		stream->data.persist(&active_regions->offsets[free_slot], sizeof(active_regions->offsets[free_slot]));
+	} else if (!active_regions->overflow) {
+		active_regions->overflow = 1;
+		stream->data.persist(&active_regions->overflow, sizeof(active_regions->overflow));
+	}
+
+set_active:
+	/* Tail hint (stored on clean shutdown) is no longer valid once anything is appended. */
+	pmemstream_invalidate_tail_hint(stream, region);
+	region_runtime_set_active_release(region_runtime);
+out:
+	pthread_mutex_unlock(&stream->active_regions_lock);
+}
+
+static void pmemstream_remove_active_region(struct pmemstream *stream, struct pmemstream_region region)
+{
+	struct pmemstream_active_regions *active_regions = &stream->header->active_regions;
+
+	pthread_mutex_lock(&stream->active_regions_lock);
+	for (size_t i = 0; i < PMEMSTREAM_ACTIVE_REGIONS_MAX; i++) {
+		if (active_regions->offsets[i] == region.offset) {
+			active_regions->offsets[i] = PMEMSTREAM_INVALID_OFFSET;
+			stream->data.persist(&active_regions->offsets[i], sizeof(active_regions->offsets[i]));
+			break;
+		}
+	}
+	pthread_mutex_unlock(&stream->active_regions_lock);
+}
+
 static int pmemstream_initialize_async_ops(struct pmemstream *stream)
 {
 	// XXX: aligned alloc?
-	stream->async_ops = malloc(PMEMSTREAM_MAX_CONCURRENCY * sizeof(struct async_operation));
+	stream->async_ops = malloc(stream->max_concurrency * sizeof(struct async_operation));
 	if (!stream->async_ops) {
 		return -1;
 	}
 
-	for (size_t i = 0; i < PMEMSTREAM_MAX_CONCURRENCY; i++) {
+	for (size_t i = 0; i < stream->max_concurrency; i++) {
 		FUTURE_INIT_COMPLETE(&stream->async_ops[i].future);
 		stream->async_ops[i].timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
 	}
@@ -144,32 +323,80 @@ static int pmemstream_initialize_async_ops(struct pmemstream *stream)
 	return 0;
 }
 
-static void pmemstream_force_prefault(struct pmem2_map *map)
+static size_t pmemstream_env_get_size(const char *name)
 {
-	volatile char *cur_addr = pmem2_map_get_address(map);
-	char *addr_end = (char *)cur_addr + pmem2_map_get_size(map);
-	long pagesize = sysconf(_SC_PAGESIZE);
-	int tmp;
-	for (; cur_addr < addr_end; cur_addr += pagesize) {
-		*cur_addr = *cur_addr;
-		tmp = *cur_addr;
-		(void)tmp;
+	const char *value = getenv(name);
+	if (!value) {
+		return 0;
+	}
+
+	char *end;
+	unsigned long long result = strtoull(value, &end, 10);
+	if (end == value || *end != '\0') {
+		return 0;
 	}
+
+	return (size_t)result;
 }
 
-int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pmem2_map *map)
+/* PMEMSTREAM_PREFAULT_AT_OPEN=regions prefaults only allocated regions, any other value - the entire map. */
+static enum pmemstream_prefault_mode pmemstream_env_get_prefault_mode(void)
 {
-	if (!stream) {
-		return -1;
+	const char *value = getenv("PMEMSTREAM_PREFAULT_AT_OPEN");
+	if (!value) {
+		return PMEMSTREAM_PREFAULT_NONE;
 	}
-
-	if (pmemstream_validate_sizes(block_size, map)) {
-		return -1;
+	if (strcmp(value, "regions") == 0) {
+		return PMEMSTREAM_PREFAULT_REGIONS;
 	}
+	return PMEMSTREAM_PREFAULT_ALL;
+}
 
+static void pmemstream_open_options_default(struct pmemstream_open_options *options)
+{
+	options->recovery_threads = 0;
+	options->prefault = PMEMSTREAM_PREFAULT_NONE;
+	options->prefault_threads = 0;
+	options->max_concurrency = PMEMSTREAM_DEFAULT_MAX_CONCURRENCY;
+	options->commit_batch_size = PMEMSTREAM_DEFAULT_TIMESTAMP_PROCESSING_BATCH;
+	options->persistence_mode = PMEMSTREAM_PERSISTENCE_SYNC;
+	options->region_pool_size = 0;
+	options->region_pool_count = 0;
+}
+
+static void pmemstream_open_options_from_env(struct pmemstream_open_options *options)
+{
+	pmemstream_open_options_default(options);
+	options->recovery_threads = pmemstream_env_get_size("PMEMSTREAM_RECOVERY_THREADS");
+	options->prefault = pmemstream_env_get_prefault_mode();
+	options->prefault_threads = pmemstream_env_get_size("PMEMSTREAM_PREFAULT_THREADS");
+}
+
+/*
+ * Opening a stream is split into steps, so that it can be performed both synchronously (pmemstream_from_map) and
+ * incrementally, by polling a future (pmemstream_async_from_map).
+ */
+enum pmemstream_open_step {
+	PMEMSTREAM_OPEN_STEP_HEADER,
+	PMEMSTREAM_OPEN_STEP_PREFAULT,
+	PMEMSTREAM_OPEN_STEP_ALLOCATOR,
+	PMEMSTREAM_OPEN_STEP_PREFAULT_REGIONS,
+	PMEMSTREAM_OPEN_STEP_MARK_REGIONS,
+	PMEMSTREAM_OPEN_STEP_RUNTIME,
+	PMEMSTREAM_OPEN_STEP_RECOVER_REGIONS,
+	PMEMSTREAM_OPEN_STEP_REGION_POOL
+};
+
+/* Number of bytes prefaulted by a single poll of pmemstream_async_from_map future. */
+#define PMEMSTREAM_ASYNC_OPEN_PREFAULT_CHUNK (64UL * 1024 * 1024)
+
+/* Allocates pmemstream instance for the 'map'. Persistent data is not accessed yet. */
+static struct pmemstream *pmemstream_open_new(size_t block_size, struct pmem2_map *map,
+					      const struct pmemstream_open_options *options)
+{
 	struct pmemstream *s = aligned_alloc(alignof(struct pmemstream), sizeof(struct pmemstream));
 	if (!s) {
-		return -1;
+		return NULL;
 	}
 
 	size_t spans_offset = pmemstream_header_size_aligned(block_size);
@@ -185,12 +412,26 @@ int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pm
 	s->data.flush = pmem2_get_flush_fn(map);
 	s->data.drain = pmem2_get_drain_fn(map);
 
-	if (pmemstream_is_initialized(s) != 0) {
-		pmemstream_init(s);
+	s->max_concurrency = options->max_concurrency ? options->max_concurrency : PMEMSTREAM_DEFAULT_MAX_CONCURRENCY;
+	s->timestamp_processing_batch =
+		options->commit_batch_size ? options->commit_batch_size : PMEMSTREAM_DEFAULT_TIMESTAMP_PROCESSING_BATCH;
+	s->persistence_mode = options->persistence_mode;
+	s->region_pool = NULL;
+	assert(IS_POW2(s->max_concurrency));
+
+	return s;
+}
+
+/* Checks the signature (initializes a new stream if it is missing) and reads timestamps from the header.
+ * Fails if the stream was created with a different layout version - it is left untouched then. */
+static int pmemstream_open_header(struct pmemstream *s)
+{
+	if (pmemstream_is_incompatible(s)) {
+		return -1;
 	}
 
-	if (getenv("PMEMSTREAM_PREFAULT_AT_OPEN")) {
-		pmemstream_force_prefault(map);
+	if (pmemstream_is_initialized(s) != 0) {
+		pmemstream_init(s);
 	}
 
 	s->committed_timestamp = s->header->persisted_timestamp;
@@ -198,19 +439,159 @@ int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pm
 	s->next_timestamp = s->header->persisted_timestamp + 1;
 	s->persisted_timestamp = s->header->persisted_timestamp;
 
-	allocator_runtime_initialize(&s->data, &s->header->region_allocator_header);
+	return 0;
+}
+
+/* Frees 'segment' and all segments linked after it. */
+static void pmemstream_free_segments(struct pmemstream *stream, struct pmemstream_region segment)
+{
+	while (segment.offset != PMEMSTREAM_INVALID_OFFSET) {
+		struct pmemstream_region next = region_next_segment(&stream->data, segment);
+		allocator_region_free(&stream->region_allocator, &stream->data,
+				      &stream->header->region_allocator_header, segment.offset);
+		segment = next;
+	}
+}
+
+/* Frees segments of chained regions which are not linked from any allocated region - they are left over if growing,
+ * clearing or freeing a chained region was interrupted. If there is no memory for the lookup, they are freed on next
+ * open. */
+static void pmemstream_free_orphaned_segments(struct pmemstream *s)
+{
+	struct singly_linked_list *allocated_list = &s->header->region_allocator_header.allocated_list;
+	size_t segments_count = 0;
+	uint64_t offset;
+	SLIST_FOREACH(struct span_region, &s->data, allocated_list, offset, allocator_entry_metadata.next_allocated)
+	{
+		struct pmemstream_region region = {.offset = offset};
+		if (region_is_continuation(&s->data, region)) {
+			++segments_count;
+		}
+	}
+
+	if (segments_count == 0) {
+		return;
+	}
+
+	/* Segments linked from allocated regions (offset -> offset of the previous segment). */
+	critnib *linked = critnib_new();
+	struct pmemstream_region *orphans = malloc(segments_count * sizeof(*orphans));
+	if (!linked || !orphans) {
+		goto out;
+	}
+
+	SLIST_FOREACH(struct span_region, &s->data, allocated_list, offset, allocator_entry_metadata.next_allocated)
+	{
+		struct pmemstream_region region = {.offset = offset};
+		struct pmemstream_region next = region_next_segment(&s->data, region);
+		if (next.offset == PMEMSTREAM_INVALID_OFFSET) {
+			continue;
+		}
+		if (critnib_insert(linked, next.offset, (void *)offset, 0)) {
+			goto out;
+		}
+	}
+
+	size_t orphans_count = 0;
+	SLIST_FOREACH(struct span_region, &s->data, allocated_list, offset, allocator_entry_metadata.next_allocated)
+	{
+		struct pmemstream_region region = {.offset = offset};
+		uintptr_t key;
+		void *value;
+		if (region_is_continuation(&s->data, region) && !critnib_find(linked, offset, FIND_EQ, &key, &value)) {
+			orphans[orphans_count++] = region;
+		}
+	}
+
+	/* Segments linked after an orphan are not linked from any other region either. */
+	for (size_t i = 0; i < orphans_count; i++) {
+		pmemstream_free_segments(s, orphans[i]);
+	}
+
+out:
+	free(orphans);
+	if (linked) {
+		critnib_delete(linked);
+	}
+}
+
+/* Makes the region which replaces compacted 'region' visible and frees 'region'. It is redone at open, if
+ * interrupted. */
+static void pmemstream_region_compact_finish(struct pmemstream *stream, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(&stream->data, region.offset);
+	assert(span_region->chain & SPAN_REGION_CHAIN_COMPACTED);
+
+	uint64_t new_region_offset = span_region->chain & ~SPAN_REGION_CHAIN_FLAGS_MASK;
+	struct span_region *new_span_region =
+		(struct span_region *)span_offset_to_span_ptr(&stream->data, new_region_offset);
+	if (new_span_region->chain != SPAN_REGION_CHAIN_NO_NEXT) {
+		new_span_region->chain = SPAN_REGION_CHAIN_NO_NEXT;
+		stream->data.persist(&new_span_region->chain, sizeof(new_span_region->chain));
+	}
+
+	allocator_region_free(&stream->region_allocator, &stream->data, &stream->header->region_allocator_header,
+			      region.offset);
+}
+
+/* Finishes compactions which were interrupted after the compacted region was linked to the new one. Must be done
+ * before orphaned segments are freed - new regions are hidden (as continuations) until then. */
+static void pmemstream_finish_compactions(struct pmemstream *s)
+{
+	struct singly_linked_list *allocated_list = &s->header->region_allocator_header.allocated_list;
+	while (true) {
+		/* Compacted region is removed from the list, so the list is walked again after each of them. */
+		struct pmemstream_region compacted = {.offset = PMEMSTREAM_INVALID_OFFSET};
+		uint64_t offset;
+		SLIST_FOREACH(struct span_region, &s->data, allocated_list, offset,
+			      allocator_entry_metadata.next_allocated)
+		{
+			const struct span_region *span_region =
+				(const struct span_region *)span_offset_to_span_ptr(&s->data, offset);
+			if (span_region->chain & SPAN_REGION_CHAIN_COMPACTED) {
+				compacted.offset = offset;
+				break;
+			}
+		}
+
+		if (compacted.offset == PMEMSTREAM_INVALID_OFFSET) {
+			return;
+		}
+		pmemstream_region_compact_finish(s, compacted);
+	}
+}
 
-	int ret = pmemstream_mark_regions_for_recovery(s);
+static int pmemstream_open_recover_allocator(struct pmemstream *s)
+{
+	int ret = allocator_runtime_initialize(&s->region_allocator, &s->data, &s->header->region_allocator_header);
 	if (ret) {
 		return ret;
 	}
 
+	pmemstream_finish_compactions(s);
+	pmemstream_free_orphaned_segments(s);
+
+	/* Flag is cleared before anything is modified, tail hints are used only if the previous session ended with
+	 * pmemstream_delete. */
+	s->use_tail_hints = s->header->clean_shutdown != 0;
+	if (s->use_tail_hints) {
+		s->header->clean_shutdown = 0;
+		s->data.persist(&s->header->clean_shutdown, sizeof(s->header->clean_shutdown));
+	}
+
+	return 0;
+}
+
+/* Initializes all runtime (DRAM) data of the stream. */
+static int pmemstream_open_initialize_runtime(struct pmemstream *s)
+{
 	s->region_runtimes_map = region_runtimes_map_new(&s->data);
 	if (!s->region_runtimes_map) {
 		goto err_region_runtimes;
 	}
 
-	ret = pmemstream_initialize_async_ops(s);
+	int ret = pmemstream_initialize_async_ops(s);
 	if (ret) {
 		goto err_async_ops;
 	}
@@ -220,7 +601,7 @@ int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pm
 		goto err_data_mover;
 	}
 
-	ret = sem_init(&s->async_ops_semaphore, 0, PMEMSTREAM_MAX_CONCURRENCY);
+	ret = sem_init(&s->async_ops_semaphore, 0, (unsigned)s->max_concurrency);
 	if (ret) {
 		goto err_sem_init;
 	}
@@ -230,9 +611,25 @@ int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pm
 		goto err_ready_timestamps;
 	}
 
-	*stream = s;
+	s->commit_wakers = NULL;
+	s->commit_wakers_count = 0;
+	s->commit_wakers_capacity = 0;
+	ret = pthread_mutex_init(&s->commit_wakers_lock, NULL);
+	if (ret) {
+		goto err_commit_wakers;
+	}
+
+	ret = pthread_mutex_init(&s->active_regions_lock, NULL);
+	if (ret) {
+		goto err_active_regions;
+	}
+
 	return 0;
 
+err_active_regions:
+	pthread_mutex_destroy(&s->commit_wakers_lock);
+err_commit_wakers:
+	critnib_delete(s->ready_timestamps);
 err_ready_timestamps:
 	sem_destroy(&s->async_ops_semaphore);
 err_sem_init:
@@ -242,158 +639,1036 @@ err_data_mover:
 err_async_ops:
 	region_runtimes_map_destroy(s->region_runtimes_map);
 err_region_runtimes:
-	free(s);
 	return -1;
 }
 
-void pmemstream_delete(struct pmemstream **stream)
+static void pmemstream_destroy_runtime(struct pmemstream *s)
 {
-	if (!stream) {
-		return;
-	}
-	if (!(*stream)) {
-		return;
-	}
-	struct pmemstream *s = *stream;
-
 	region_runtimes_map_destroy(s->region_runtimes_map);
 	free(s->async_ops);
 	data_mover_sync_delete(s->data_mover_sync);
 	sem_destroy(&s->async_ops_semaphore);
 	critnib_delete(s->ready_timestamps);
+	pthread_mutex_destroy(&s->commit_wakers_lock);
+	free(s->commit_wakers);
+	pthread_mutex_destroy(&s->active_regions_lock);
+}
 
-	free(s);
-	*stream = NULL;
+/* Last step of opening a stream - starts the region pool (if enabled). Pool is filled only when the stream is fully
+ * opened, because its worker uses the allocator concurrently. */
+static int pmemstream_open_start_region_pool(struct pmemstream *s, size_t region_pool_size, size_t region_pool_count)
+{
+	if (region_pool_count == 0) {
+		return 0;
+	}
+
+	size_t size = pmemstream_region_total_size_aligned(s, region_pool_size) - sizeof(struct span_region);
+	s->region_pool = pmemstream_region_pool_new(s, size, region_pool_count);
+	return s->region_pool ? 0 : -1;
 }
 
-uint64_t pmemstream_persisted_timestamp(struct pmemstream *stream)
+int pmemstream_from_map(struct pmemstream **stream, size_t block_size, struct pmem2_map *map)
 {
-	if (!stream) {
-		return PMEMSTREAM_INVALID_TIMESTAMP;
+	struct pmemstream_open_options options;
+	pmemstream_open_options_from_env(&options);
+
+	return pmemstream_from_map_with_options(stream, block_size, map, &options);
+}
+
+int pmemstream_config_new(struct pmemstream_config **config)
+{
+	if (!config) {
+		return -1;
 	}
 
-	uint64_t timestamp;
-	atomic_load_acquire(&stream->persisted_timestamp, &timestamp);
+	struct pmemstream_config *c = malloc(sizeof(*c));
+	if (!c) {
+		return -1;
+	}
 
-#ifndef NDEBUG
-	uint64_t timestamp_on_pmem;
-	atomic_load_acquire(&stream->header->persisted_timestamp, &timestamp_on_pmem);
-	assert(timestamp <= timestamp_on_pmem);
-#endif
+	c->block_size = 0;
+	pmemstream_open_options_default(&c->options);
 
-	return timestamp;
+	*config = c;
+	return 0;
+}
+
+void pmemstream_config_delete(struct pmemstream_config **config)
+{
+	if (!config) {
+		return;
+	}
+
+	free(*config);
+	*config = NULL;
+}
+
+int pmemstream_config_set_block_size(struct pmemstream_config *config, size_t block_size)
+{
+	if (!config) {
+		return -1;
+	}
+	if (block_size == 0 || block_size % CACHELINE_SIZE != 0 || !IS_POW2(block_size)) {
+		return -1;
+	}
+
+	config->block_size = block_size;
+	return 0;
+}
+
+int pmemstream_config_set_max_concurrency(struct pmemstream_config *config, size_t max_concurrency)
+{
+	if (!config) {
+		return -1;
+	}
+	/* Limited by the semaphore which guards the concurrent operations window. */
+	if (!IS_POW2(max_concurrency) || max_concurrency > SEM_VALUE_MAX) {
+		return -1;
+	}
+
+	config->options.max_concurrency = max_concurrency;
+	return 0;
+}
+
+int pmemstream_config_set_commit_batch_size(struct pmemstream_config *config, size_t batch_size)
+{
+	if (!config) {
+		return -1;
+	}
+	if (batch_size == 0) {
+		return -1;
+	}
+
+	config->options.commit_batch_size = batch_size;
+	return 0;
+}
+
+int pmemstream_config_set_prefault(struct pmemstream_config *config, enum pmemstream_prefault_mode mode,
+				   size_t nthreads)
+{
+	if (!config) {
+		return -1;
+	}
+	if (mode != PMEMSTREAM_PREFAULT_NONE && mode != PMEMSTREAM_PREFAULT_ALL &&
+	    mode != PMEMSTREAM_PREFAULT_REGIONS) {
+		return -1;
+	}
+
+	config->options.prefault = mode;
+	config->options.prefault_threads = nthreads;
+	return 0;
 }
 
-uint64_t pmemstream_committed_timestamp(struct pmemstream *stream)
-{
-	if (!stream) {
-		return PMEMSTREAM_INVALID_TIMESTAMP;
+int pmemstream_config_set_recovery_threads(struct pmemstream_config *config, size_t nthreads)
+{
+	if (!config) {
+		return -1;
+	}
+
+	config->options.recovery_threads = nthreads;
+	return 0;
+}
+
+int pmemstream_config_set_persistence_mode(struct pmemstream_config *config, enum pmemstream_persistence_mode mode)
+{
+	if (!config) {
+		return -1;
+	}
+	if (mode != PMEMSTREAM_PERSISTENCE_SYNC && mode != PMEMSTREAM_PERSISTENCE_RELAXED) {
+		return -1;
+	}
+
+	config->options.persistence_mode = mode;
+	return 0;
+}
+
+int pmemstream_config_set_region_pool(struct pmemstream_config *config, size_t region_size, size_t count)
+{
+	if (!config) {
+		return -1;
+	}
+	if (count != 0 && region_size == 0) {
+		return -1;
+	}
+
+	config->options.region_pool_size = region_size;
+	config->options.region_pool_count = count;
+	return 0;
+}
+
+int pmemstream_from_config(struct pmemstream **stream, struct pmem2_map *map, const struct pmemstream_config *config)
+{
+	if (!config) {
+		return -1;
+	}
+
+	return pmemstream_from_map_with_options(stream, config->block_size, map, &config->options);
+}
+
+int pmemstream_from_map_with_options(struct pmemstream **stream, size_t block_size, struct pmem2_map *map,
+				     const struct pmemstream_open_options *options)
+{
+	if (!stream) {
+		return -1;
+	}
+
+	if (pmemstream_validate_sizes(block_size, map)) {
+		return -1;
+	}
+
+	struct pmemstream *s = pmemstream_open_new(block_size, map, options);
+	if (!s) {
+		return -1;
+	}
+
+	int ret = pmemstream_open_header(s);
+	if (ret) {
+		goto err_header;
+	}
+
+	if (options->prefault == PMEMSTREAM_PREFAULT_ALL) {
+		ret = pmemstream_prefault(s, map, PMEMSTREAM_PREFAULT_ALL, options->prefault_threads);
+		if (ret) {
+			goto err_prefault;
+		}
+	}
+
+	ret = pmemstream_open_recover_allocator(s);
+	if (ret) {
+		goto err_allocator;
+	}
+
+	/* Allocated regions are known only after the allocator is recovered. */
+	if (options->prefault == PMEMSTREAM_PREFAULT_REGIONS) {
+		ret = pmemstream_prefault(s, map, PMEMSTREAM_PREFAULT_REGIONS, options->prefault_threads);
+		if (ret) {
+			goto err_prefault_regions;
+		}
+	}
+
+	ret = pmemstream_mark_regions_for_recovery(s);
+	if (ret) {
+		goto err_mark;
+	}
+
+	ret = pmemstream_open_initialize_runtime(s);
+	if (ret) {
+		goto err_runtime;
+	}
+
+	if (options->recovery_threads) {
+		ret = pmemstream_recover_regions_parallel(s, options->recovery_threads);
+		if (ret) {
+			goto err_recovery;
+		}
+	}
+
+	ret = pmemstream_open_start_region_pool(s, options->region_pool_size, options->region_pool_count);
+	if (ret) {
+		goto err_recovery;
+	}
+
+	*stream = s;
+	return 0;
+
+err_recovery:
+	pmemstream_destroy_runtime(s);
+err_runtime:
+err_mark:
+err_prefault_regions:
+	allocator_runtime_destroy(&s->region_allocator);
+err_allocator:
+err_prefault:
+err_header:
+	free(s);
+	return -1;
+}
+
+static enum future_state pmemstream_async_from_map_impl(struct future_context *ctx, struct future_notifier *notifier)
+{
+	if (notifier != NULL) {
+		notifier->notifier_used = FUTURE_NOTIFIER_NONE;
+	}
+
+	struct pmemstream_async_from_map_data *data = future_context_get_data(ctx);
+	struct pmemstream_async_from_map_output *out = future_context_get_output(ctx);
+	struct pmemstream *s = data->opening_stream;
+
+	/* Each poll performs a single step (or a part of prefaulting), so that the caller is never blocked for long. */
+	switch (data->step) {
+		case PMEMSTREAM_OPEN_STEP_HEADER:
+			if (pmemstream_open_header(s)) {
+				goto err;
+			}
+			data->step = data->prefault == PMEMSTREAM_PREFAULT_ALL ? PMEMSTREAM_OPEN_STEP_PREFAULT
+									       : PMEMSTREAM_OPEN_STEP_ALLOCATOR;
+			return FUTURE_STATE_RUNNING;
+		case PMEMSTREAM_OPEN_STEP_PREFAULT: {
+			size_t map_size = pmem2_map_get_size(data->map);
+			size_t size = map_size - data->prefault_offset;
+			if (size > PMEMSTREAM_ASYNC_OPEN_PREFAULT_CHUNK) {
+				size = PMEMSTREAM_ASYNC_OPEN_PREFAULT_CHUNK;
+			}
+			uint8_t *addr = (uint8_t *)pmem2_map_get_address(data->map) + data->prefault_offset;
+			pmemstream_prefault_range(addr, size);
+			data->prefault_offset += size;
+			if (data->prefault_offset == map_size) {
+				data->step = PMEMSTREAM_OPEN_STEP_ALLOCATOR;
+			}
+			return FUTURE_STATE_RUNNING;
+		}
+		case PMEMSTREAM_OPEN_STEP_ALLOCATOR:
+			if (pmemstream_open_recover_allocator(s)) {
+				goto err;
+			}
+			if (data->prefault == PMEMSTREAM_PREFAULT_REGIONS) {
+				data->step = PMEMSTREAM_OPEN_STEP_PREFAULT_REGIONS;
+			} else {
+				data->step = PMEMSTREAM_OPEN_STEP_MARK_REGIONS;
+			}
+			return FUTURE_STATE_RUNNING;
+		case PMEMSTREAM_OPEN_STEP_PREFAULT_REGIONS:
+			if (pmemstream_prefault(s, data->map, PMEMSTREAM_PREFAULT_REGIONS, data->prefault_threads)) {
+				goto err;
+			}
+			data->step = PMEMSTREAM_OPEN_STEP_MARK_REGIONS;
+			return FUTURE_STATE_RUNNING;
+		case PMEMSTREAM_OPEN_STEP_MARK_REGIONS:
+			if (pmemstream_mark_regions_for_recovery(s)) {
+				goto err;
+			}
+			data->step = PMEMSTREAM_OPEN_STEP_RUNTIME;
+			return FUTURE_STATE_RUNNING;
+		case PMEMSTREAM_OPEN_STEP_RUNTIME:
+			if (pmemstream_open_initialize_runtime(s)) {
+				goto err;
+			}
+			data->step = PMEMSTREAM_OPEN_STEP_RECOVER_REGIONS;
+			return FUTURE_STATE_RUNNING;
+		case PMEMSTREAM_OPEN_STEP_RECOVER_REGIONS:
+			if (data->recovery_threads && pmemstream_recover_regions_parallel(s, data->recovery_threads)) {
+				pmemstream_destroy_runtime(s);
+				goto err;
+			}
+			data->step = PMEMSTREAM_OPEN_STEP_REGION_POOL;
+			return FUTURE_STATE_RUNNING;
+		case PMEMSTREAM_OPEN_STEP_REGION_POOL:
+			if (pmemstream_open_start_region_pool(s, data->region_pool_size, data->region_pool_count)) {
+				pmemstream_destroy_runtime(s);
+				goto err;
+			}
+			break;
+		default:
+			assert(false);
+			goto err;
+	}
+
+	/* Stream is published only when it is fully opened - it cannot be used before. */
+	data->opening_stream = NULL;
+	*data->stream = s;
+	out->error_code = 0;
+	return FUTURE_STATE_COMPLETE;
+
+err:
+	/* Step is advanced only after it succeeds. */
+	if (data->step > PMEMSTREAM_OPEN_STEP_ALLOCATOR) {
+		allocator_runtime_destroy(&s->region_allocator);
+	}
+	free(s);
+	data->opening_stream = NULL;
+	out->error_code = -1;
+	return FUTURE_STATE_COMPLETE;
+}
+
+static struct pmemstream_async_from_map_fut
+pmemstream_async_from_map_with_options(struct pmemstream **stream, size_t block_size, struct pmem2_map *map,
+				       const struct pmemstream_open_options *options)
+{
+	struct pmemstream_async_from_map_fut future;
+	future.data.stream = stream;
+	future.data.map = map;
+	future.data.opening_stream = NULL;
+	future.data.step = PMEMSTREAM_OPEN_STEP_HEADER;
+	future.data.prefault = options->prefault;
+	future.data.prefault_offset = 0;
+	future.data.prefault_threads = options->prefault_threads;
+	future.data.recovery_threads = options->recovery_threads;
+	future.data.region_pool_size = options->region_pool_size;
+	future.data.region_pool_count = options->region_pool_count;
+	future.output.error_code = -1;
+
+	if (!stream || pmemstream_validate_sizes(block_size, map)) {
+		FUTURE_INIT_COMPLETE(&future);
+		return future;
+	}
+
+	future.data.opening_stream = pmemstream_open_new(block_size, map, options);
+	if (!future.data.opening_stream) {
+		FUTURE_INIT_COMPLETE(&future);
+		return future;
+	}
+
+	future.output.error_code = 0;
+	FUTURE_INIT(&future, pmemstream_async_from_map_impl);
+	return future;
+}
+
+struct pmemstream_async_from_map_fut pmemstream_async_from_map(struct pmemstream **stream, size_t block_size,
+							       struct pmem2_map *map)
+{
+	struct pmemstream_open_options options;
+	pmemstream_open_options_from_env(&options);
+
+	return pmemstream_async_from_map_with_options(stream, block_size, map, &options);
+}
+
+struct pmemstream_async_from_map_fut pmemstream_async_from_config(struct pmemstream **stream, struct pmem2_map *map,
+								  const struct pmemstream_config *config)
+{
+	if (!config) {
+		struct pmemstream_async_from_map_fut future;
+		future.data.stream = stream;
+		future.data.map = map;
+		future.data.opening_stream = NULL;
+		future.output.error_code = -1;
+		FUTURE_INIT_COMPLETE(&future);
+		return future;
+	}
+
+	return pmemstream_async_from_map_with_options(stream, config->block_size, map, &config->options);
+}
+
+/* If all entries are persisted, stores regions' tails (so that they can be initialized without iterating at next
+ * open) and marks the stream as cleanly shut down. */
+static void pmemstream_store_clean_shutdown(struct pmemstream *stream)
+{
+	/* In relaxed persistence mode, committed entries might not be persisted yet. */
+	uint64_t committed_timestamp = pmemstream_committed_timestamp(stream);
+	if (committed_timestamp > pmemstream_persisted_timestamp(stream)) {
+		struct pmemstream_async_wait_fut future = pmemstream_async_wait_persisted(stream, committed_timestamp);
+		while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+			;
+	}
+
+	uint64_t next_timestamp;
+	uint64_t persisted_timestamp;
+	atomic_load_acquire(&stream->next_timestamp, &next_timestamp);
+	atomic_load_acquire(&stream->persisted_timestamp, &persisted_timestamp);
+	if (persisted_timestamp + 1 != next_timestamp) {
+		/* Some operations are still in progress. */
+		return;
+	}
+
+	region_runtimes_map_store_tail_hints(stream->region_runtimes_map, persisted_timestamp);
+
+	/* All entries are persisted - no region requires marking at next open. */
+	struct pmemstream_active_regions *active_regions = &stream->header->active_regions;
+	for (size_t i = 0; i < PMEMSTREAM_ACTIVE_REGIONS_MAX; i++) {
+		active_regions->offsets[i] = PMEMSTREAM_INVALID_OFFSET;
+	}
+	active_regions->overflow = 0;
+	stream->data.persist(active_regions, sizeof(*active_regions));
+
+	stream->header->clean_shutdown = 1;
+	stream->data.persist(&stream->header->clean_shutdown, sizeof(stream->header->clean_shutdown));
+}
+
+void pmemstream_delete(struct pmemstream **stream)
+{
+	if (!stream) {
+		return;
+	}
+	if (!(*stream)) {
+		return;
+	}
+	struct pmemstream *s = *stream;
+
+	if (s->region_pool) {
+		pmemstream_region_pool_delete(s->region_pool);
+	}
+	pmemstream_store_clean_shutdown(s);
+	pmemstream_destroy_runtime(s);
+	allocator_runtime_destroy(&s->region_allocator);
+
+	free(s);
+	*stream = NULL;
+}
+
+uint64_t pmemstream_persisted_timestamp(struct pmemstream *stream)
+{
+	if (!stream) {
+		return PMEMSTREAM_INVALID_TIMESTAMP;
+	}
+
+	uint64_t timestamp;
+	atomic_load_acquire(&stream->persisted_timestamp, &timestamp);
+
+#ifndef NDEBUG
+	uint64_t timestamp_on_pmem;
+	atomic_load_acquire(&stream->header->persisted_timestamp, &timestamp_on_pmem);
+	assert(timestamp <= timestamp_on_pmem);
+#endif
+
+	return timestamp;
+}
+
+uint64_t pmemstream_committed_timestamp(struct pmemstream *stream)
+{
+	if (!stream) {
+		return PMEMSTREAM_INVALID_TIMESTAMP;
+	}
+
+	uint64_t timestamp;
+	atomic_load_acquire(&stream->committed_timestamp, &timestamp);
+	return timestamp;
+}
+
+/* Allocates a region with 'size' bytes of data and sets its markers and chain. Region is taken from the region pool
+ * if possible (pooled regions have no markers), from the allocator otherwise. */
+static uint64_t pmemstream_region_allocate_offset(struct pmemstream *stream, size_t size, uint64_t marker_block_size,
+						  uint64_t chain)
+{
+	uint64_t offset = PMEMSTREAM_INVALID_OFFSET;
+	if (stream->region_pool && marker_block_size == 0) {
+		offset = pmemstream_region_pool_pop(stream->region_pool, size);
+	}
+
+	if (offset == PMEMSTREAM_INVALID_OFFSET) {
+		return allocator_region_allocate(&stream->region_allocator, &stream->data,
+						 &stream->header->region_allocator_header, size, marker_block_size,
+						 chain);
+	}
+
+	/* Pooled region is already initialized (and hidden) - it only has to be made visible, with a single persist. */
+	struct span_region *span_region = (struct span_region *)span_offset_to_span_ptr(&stream->data, offset);
+	if (span_region->chain != chain) {
+		atomic_store_release(&span_region->chain, chain);
+		stream->data.persist(&span_region->chain, sizeof(span_region->chain));
+	}
+	return offset;
+}
+
+// stream owns the region object - the user gets a reference, but it's not
+// necessary to hold on to it and explicitly delete it.
+static int pmemstream_region_allocate_internal(struct pmemstream *stream, size_t size, uint64_t marker_block_size,
+					       uint64_t chain, struct pmemstream_region *region)
+{
+	if (!stream || !size) {
+		return -1;
+	}
+
+	size_t total_size = pmemstream_region_total_size_aligned(stream, size);
+	size_t requested_size = total_size - sizeof(struct span_region);
+
+	if (marker_block_size && region_markers_validate(requested_size, marker_block_size)) {
+		return -1;
+	}
+
+	const uint64_t offset = pmemstream_region_allocate_offset(stream, requested_size, marker_block_size, chain);
+	if (offset == PMEMSTREAM_INVALID_OFFSET) {
+		return -1;
+	}
+
+	if (region) {
+		region->offset = offset;
+	}
+
+#ifndef NDEBUG
+	const struct span_base *span_base = span_offset_to_span_ptr(&stream->data, offset);
+	const struct span_region *span_region = (const struct span_region *)span_base;
+	assert(offset % stream->block_size == 0);
+	assert(span_get_type(span_base) == SPAN_REGION);
+	assert(span_get_total_size(span_base) >= total_size);
+	assert(((uintptr_t)span_region->data) % CACHELINE_SIZE == 0);
+#endif
+
+	return 0;
+}
+
+int pmemstream_region_allocate(struct pmemstream *stream, size_t size, struct pmemstream_region *region)
+{
+	return pmemstream_region_allocate_internal(stream, size, 0, SPAN_REGION_CHAIN_NO_NEXT, region);
+}
+
+int pmemstream_region_allocate_chained(struct pmemstream *stream, size_t size, struct pmemstream_region *region)
+{
+	uint64_t chain = SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_GROWABLE;
+	return pmemstream_region_allocate_internal(stream, size, 0, chain, region);
+}
+
+int pmemstream_region_allocate_many(struct pmemstream *stream, size_t size, size_t count,
+				    struct pmemstream_region *regions)
+{
+	if (!stream || !size || !count || !regions) {
+		return -1;
+	}
+
+	size_t total_size = pmemstream_region_total_size_aligned(stream, size);
+	size_t requested_size = total_size - sizeof(struct span_region);
+
+	struct allocator_header *allocator_header = &stream->header->region_allocator_header;
+	const uint64_t offset = allocator_regions_allocate(&stream->region_allocator, &stream->data, allocator_header,
+							   requested_size, count);
+	if (offset != PMEMSTREAM_INVALID_OFFSET) {
+		for (size_t i = 0; i < count; i++) {
+			regions[i].offset = offset + i * total_size;
+		}
+		return 0;
+	}
+
+	/* There is no free space big enough for all regions - they are allocated one by one. */
+	for (size_t i = 0; i < count; i++) {
+		int ret = pmemstream_region_allocate(stream, size, &regions[i]);
+		if (ret) {
+			pmemstream_region_free_many(stream, regions, i);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+int pmemstream_region_allocate_with_markers(struct pmemstream *stream, size_t size, struct pmemstream_region *region)
+{
+	if (!stream) {
+		return -1;
+	}
+
+	return pmemstream_region_allocate_internal(stream, size, stream->block_size, SPAN_REGION_CHAIN_NO_NEXT,
+						   region);
+}
+
+int pmemstream_region_allocate_ring(struct pmemstream *stream, size_t size, struct pmemstream_region *region)
+{
+	/* Region is allocated hidden, so that it is not visible (and it is freed on open after a crash) until its
+	 * ring layout is initialized. */
+	struct pmemstream_region new_region;
+	uint64_t chain = SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_CONTINUATION;
+	int ret = pmemstream_region_allocate_internal(stream, size, 0, chain, &new_region);
+	if (ret) {
+		return ret;
+	}
+
+	ret = region_ring_initialize(&stream->data, new_region);
+	if (ret) {
+		allocator_region_free(&stream->region_allocator, &stream->data,
+				      &stream->header->region_allocator_header, new_region.offset);
+		return ret;
+	}
+
+	if (region) {
+		*region = new_region;
+	}
+
+	return 0;
+}
+
+size_t pmemstream_region_size(struct pmemstream *stream, struct pmemstream_region region)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return 0;
+	}
+
+	const struct span_base *span_region = span_offset_to_span_ptr(&stream->data, region.offset);
+	assert(span_get_type(span_region) == SPAN_REGION);
+	return span_get_size(span_region);
+}
+
+size_t pmemstream_region_usable_size(struct pmemstream *stream, struct pmemstream_region region)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return 0;
+	}
+
+	assert(span_get_type(span_offset_to_span_ptr(&stream->data, region.offset)) == SPAN_REGION);
+	struct pmemstream_region_runtime *region_runtime;
+	ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
+	if (ret) {
+		return 0;
+	}
+	uint64_t region_end_offset = region_data_end_offset(&stream->data, region_runtime_get_segment(region_runtime));
+	uint64_t append_offset = region_runtime_get_append_offset_relaxed(region_runtime);
+
+	if (region_is_ring(&stream->data, region)) {
+		/* Space before the head is reused once appends wrap around. */
+		uint64_t head_offset = region_runtime_get_head_offset_acquire(region_runtime);
+		if (append_offset < head_offset) {
+			return head_offset - append_offset;
+		}
+		return region_end_offset - append_offset + head_offset - region_first_entry_offset(region);
+	}
+
+	return region_end_offset - append_offset;
+}
+
+int pmemstream_region_trim(struct pmemstream *stream, struct pmemstream_region region, struct pmemstream_entry entry)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	ret = pmemstream_validate_stream_and_offset(stream, entry.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (!region_is_ring(&stream->data, region)) {
+		return -1;
+	}
+
+	struct pmemstream_region_runtime *region_runtime;
+	ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
+	if (ret) {
+		return ret;
+	}
+
+	return region_runtime_trim(stream, region_runtime, entry.offset);
+}
+
+int pmemstream_region_free(struct pmemstream *stream, struct pmemstream_region region)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (region_is_continuation(&stream->data, region)) {
+		return -1;
+	}
+
+	/* Region's runtime is removed before the region is freed - afterwards, the same offset might be concurrently
+	 * allocated (and get a new runtime) by another thread. */
+	pmemstream_remove_active_region(stream, region);
+	region_runtimes_map_remove(stream->region_runtimes_map, region);
+
+	/* Remaining segments of a chained region are freed after the first one, so that none of them is ever linked
+	 * from a free region. If this is interrupted, they are freed on next open. */
+	struct pmemstream_region segment = region_next_segment(&stream->data, region);
+	allocator_region_free(&stream->region_allocator, &stream->data, &stream->header->region_allocator_header,
+			      region.offset);
+	pmemstream_free_segments(stream, segment);
+
+	return 0;
+}
+
+int pmemstream_region_clear(struct pmemstream *stream, struct pmemstream_region region)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (region_is_continuation(&stream->data, region)) {
+		return -1;
+	}
+
+	/* Runtime is not initialized for write - there is no need to find the tail which is going to be discarded. */
+	struct pmemstream_region_runtime *region_runtime;
+	ret = region_runtimes_map_get_or_create(stream->region_runtimes_map, region, &region_runtime);
+	if (ret) {
+		return ret;
+	}
+
+	/* As for the first append - region has to be recovered after a crash and its tail hint is no longer valid. */
+	if (!region_runtime_is_active_acquire(region_runtime)) {
+		pmemstream_add_active_region(stream, region, region_runtime);
+	}
+
+	struct pmemstream_region segment;
+	ret = region_runtime_clear(region_runtime, &segment);
+	if (ret) {
+		return ret;
+	}
+
+	/* Unlinked segments are freed on next open if this is interrupted. */
+	pmemstream_free_segments(stream, segment);
+
+	return 0;
+}
+
+/* Copies entries from range [begin, end) to 'destination', using non-temporal stores. Caller must drain them. */
+static void pmemstream_region_compact_copy_run(struct pmemstream *stream, uint64_t destination, uint64_t begin,
+					       uint64_t end)
+{
+	stream->data.memcpy((void *)pmemstream_offset_to_ptr(&stream->data, destination),
+			    pmemstream_offset_to_ptr(&stream->data, begin), end - begin,
+			    PMEM2_F_MEM_NONTEMPORAL | PMEM2_F_MEM_NODRAIN);
+}
+
+/* Copies entries of 'region', for which 'keep' returns non-zero value, to (hidden) 'new_region' - consecutive
+ * entries are copied at once. Entries are only flushed, caller must drain them. Only entries with timestamps up to
+ * 'max_timestamp' are copied. */
+static int pmemstream_region_compact_copy(struct pmemstream *stream, struct pmemstream_region region,
+					  struct pmemstream_region new_region, uint64_t max_timestamp,
+					  pmemstream_compact_callback keep, void *ctx)
+{
+	struct pmemstream_entry_iterator iterator;
+	int ret = entry_iterator_initialize(&iterator, stream, region, false);
+	if (ret) {
+		return ret;
+	}
+	iterator.max_timestamp = max_timestamp;
+
+	/* Range of entries [run_begin, run_end) which is copied to 'run_destination'. */
+	uint64_t run_begin = PMEMSTREAM_INVALID_OFFSET;
+	uint64_t run_end = PMEMSTREAM_INVALID_OFFSET;
+	uint64_t run_destination = region_first_entry_offset(new_region);
+	uint64_t destination = run_destination;
+
+	for (pmemstream_entry_iterator_seek_first(&iterator); pmemstream_entry_iterator_is_valid(&iterator) == 0;
+	     pmemstream_entry_iterator_next(&iterator)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(&iterator);
+		if (!keep(stream, entry, ctx)) {
+			continue;
+		}
+
+		if (entry.offset != run_end) {
+			if (run_begin != PMEMSTREAM_INVALID_OFFSET) {
+				pmemstream_region_compact_copy_run(stream, run_destination, run_begin, run_end);
+			}
+			run_begin = entry.offset;
+			run_destination = destination;
+		}
+
+		const struct span_entry *span_entry =
+			(const struct span_entry *)span_offset_to_span_ptr(&stream->data, entry.offset);
+		size_t entry_total_size = span_get_total_size(&span_entry->span_timestamped_base.span_base);
+		region_markers_update(&stream->data, new_region, destination, entry_total_size,
+				      span_entry->span_timestamped_base.timestamp);
+
+		run_end = entry.offset + entry_total_size;
+		destination += entry_total_size;
+	}
+
+	if (run_begin != PMEMSTREAM_INVALID_OFFSET) {
+		pmemstream_region_compact_copy_run(stream, run_destination, run_begin, run_end);
+	}
+
+	/* Memory after the last entry might contain stale entries. */
+	if (destination + sizeof(struct span_empty) <= region_data_end_offset(&stream->data, new_region)) {
+		struct span_empty span_empty = {.span_base = span_base_create(0, SPAN_EMPTY)};
+		struct span_base *span_base = (struct span_base *)pmemstream_offset_to_ptr(&stream->data, destination);
+		span_base_atomic_store(span_base, span_empty.span_base);
+		stream->data.flush(span_base, sizeof(*span_base));
+	}
+
+	return 0;
+}
+
+int pmemstream_region_compact(struct pmemstream *stream, struct pmemstream_region region,
+			      struct pmemstream_region *new_region, pmemstream_compact_callback keep, void *ctx)
+{
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret) {
+		return ret;
+	}
+
+	if (!new_region || !keep) {
+		return -1;
+	}
+
+	/* Entries of chained and ring regions are not stored contiguously. */
+	struct span_region *span_region = (struct span_region *)span_offset_to_span_ptr(&stream->data, region.offset);
+	if (span_region->chain != SPAN_REGION_CHAIN_NO_NEXT) {
+		return -1;
+	}
+
+	struct pmemstream_region_runtime *region_runtime;
+	ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
+	if (ret) {
+		return ret;
+	}
+
+	/* From now on, appends to the region fail - its entries do not change until it is replaced. */
+	ret = region_runtime_compaction_begin(region_runtime);
+	if (ret) {
+		return ret;
+	}
+
+	/* Timestamps are preserved, so only persisted entries can be copied - otherwise, they might be valid in the new
+	 * region after a crash, while being discarded in the old one. All entries of the region are published, so
+	 * their timestamps were already acquired. */
+	uint64_t next_timestamp;
+	atomic_load_acquire(&stream->next_timestamp, &next_timestamp);
+	uint64_t max_timestamp = next_timestamp - 1;
+	struct pmemstream_async_wait_fut future = pmemstream_async_wait_persisted(stream, max_timestamp);
+	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+		;
+
+	/* New region is hidden (and freed at next open) until the old one is linked to it. Its markers are initialized
+	 * by the allocator. */
+	struct pmemstream_region compacted = {
+		.offset = allocator_region_allocate(&stream->region_allocator, &stream->data,
+						    &stream->header->region_allocator_header,
+						    span_get_size(&span_region->span_base),
+						    span_region->marker_block_size,
+						    SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_CONTINUATION)};
+	if (compacted.offset == PMEMSTREAM_INVALID_OFFSET) {
+		region_runtime_compaction_abort(region_runtime);
+		return -1;
 	}
 
-	uint64_t timestamp;
-	atomic_load_acquire(&stream->committed_timestamp, &timestamp);
-	return timestamp;
-}
+	ret = pmemstream_region_compact_copy(stream, region, compacted, max_timestamp, keep, ctx);
+	if (ret) {
+		goto err;
+	}
+	stream->data.drain();
 
-static size_t pmemstream_region_total_size_aligned(struct pmemstream *stream, size_t size)
-{
-	struct span_region span_region = {.span_base = span_base_create(size, SPAN_REGION)};
-	return ALIGN_UP(span_get_total_size(&span_region.span_base), stream->block_size);
-}
+	/* Commit point - from now on, the old region is replaced by the new one. */
+	atomic_store_release(&span_region->chain, compacted.offset | SPAN_REGION_CHAIN_COMPACTED);
+	stream->data.persist(&span_region->chain, sizeof(span_region->chain));
 
-// stream owns the region object - the user gets a reference, but it's not
-// necessary to hold on to it and explicitly delete it.
-int pmemstream_region_allocate(struct pmemstream *stream, size_t size, struct pmemstream_region *region)
-{
-	// XXX: lock
+	pmemstream_remove_active_region(stream, region);
+	region_runtimes_map_remove(stream->region_runtimes_map, region);
+	pmemstream_region_compact_finish(stream, region);
 
-	if (!stream || !size) {
-		return -1;
-	}
+	*new_region = compacted;
+	return 0;
 
-	size_t total_size = pmemstream_region_total_size_aligned(stream, size);
-	size_t requested_size = total_size - sizeof(struct span_region);
+err:
+	allocator_region_free(&stream->region_allocator, &stream->data, &stream->header->region_allocator_header,
+			      compacted.offset);
+	region_runtime_compaction_abort(region_runtime);
+	return ret;
+}
 
-	const uint64_t offset =
-		allocator_region_allocate(&stream->data, &stream->header->region_allocator_header, requested_size);
-	if (offset == PMEMSTREAM_INVALID_OFFSET) {
+int pmemstream_region_free_many(struct pmemstream *stream, const struct pmemstream_region *regions, size_t count)
+{
+	if (!stream || (!regions && count)) {
 		return -1;
 	}
 
-	if (region) {
-		region->offset = offset;
+	for (size_t i = 0; i < count; i++) {
+		int ret = pmemstream_validate_stream_and_offset(stream, regions[i].offset);
+		if (ret) {
+			return ret;
+		}
+		if (region_is_continuation(&stream->data, regions[i])) {
+			return -1;
+		}
 	}
 
-#ifndef NDEBUG
-	const struct span_base *span_base = span_offset_to_span_ptr(&stream->data, offset);
-	const struct span_region *span_region = (const struct span_region *)span_base;
-	assert(offset % stream->block_size == 0);
-	assert(span_get_type(span_base) == SPAN_REGION);
-	assert(span_get_total_size(span_base) == total_size);
-	assert(((uintptr_t)span_region->data) % CACHELINE_SIZE == 0);
-#endif
+	/* Regions are passed to the allocator in batches of limited size, to avoid dynamic allocation. */
+	uint64_t offsets[PMEMSTREAM_REGION_FREE_BATCH];
+	struct pmemstream_region segments[PMEMSTREAM_REGION_FREE_BATCH];
+	for (size_t i = 0; i < count; i += PMEMSTREAM_REGION_FREE_BATCH) {
+		size_t batch = count - i < PMEMSTREAM_REGION_FREE_BATCH ? count - i : PMEMSTREAM_REGION_FREE_BATCH;
+		for (size_t j = 0; j < batch; j++) {
+			pmemstream_remove_active_region(stream, regions[i + j]);
+			region_runtimes_map_remove(stream->region_runtimes_map, regions[i + j]);
+			offsets[j] = regions[i + j].offset;
+			segments[j] = region_next_segment(&stream->data, regions[i + j]);
+		}
+		allocator_regions_free(&stream->region_allocator, &stream->data,
+				       &stream->header->region_allocator_header, offsets, batch);
+
+		/* Same as in pmemstream_region_free - segments are freed after the first ones. */
+		for (size_t j = 0; j < batch; j++) {
+			pmemstream_free_segments(stream, segments[j]);
+		}
+	}
 
 	return 0;
 }
 
-size_t pmemstream_region_size(struct pmemstream *stream, struct pmemstream_region region)
+// returns pointer to the data of the entry
+const void *pmemstream_entry_data(struct pmemstream *stream, struct pmemstream_entry entry)
 {
-	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	int ret = pmemstream_validate_stream_and_offset(stream, entry.offset);
 	if (ret) {
-		return 0;
+		return NULL;
 	}
 
-	const struct span_base *span_region = span_offset_to_span_ptr(&stream->data, region.offset);
-	assert(span_get_type(span_region) == SPAN_REGION);
-	return span_get_size(span_region);
+	struct span_entry *span_entry = (struct span_entry *)span_offset_to_span_ptr(&stream->data, entry.offset);
+	return span_entry->data;
 }
 
-size_t pmemstream_region_usable_size(struct pmemstream *stream, struct pmemstream_region region)
+/* Copies 'size' bytes of entry data from persistent memory. Big entries are prefetched ahead of copying with
+ * non-temporal hint, so that (where supported) they do not evict other data from CPU caches. */
+static void pmemstream_copy_entry_data(void *dst, const void *src, size_t size)
 {
-	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
-	if (ret) {
-		return 0;
+	if (size < ENTRY_READ_NON_TEMPORAL_THRESHOLD) {
+		memcpy(dst, src, size);
+		return;
 	}
 
-	const struct span_base *span_region = span_offset_to_span_ptr(&stream->data, region.offset);
-	assert(span_get_type(span_region) == SPAN_REGION);
-	uint64_t region_end_offset = region.offset + span_get_total_size(span_region);
+	const uint8_t *src8 = (const uint8_t *)src;
+	uint8_t *dst8 = (uint8_t *)dst;
 
-	struct pmemstream_region_runtime *region_runtime;
-	ret = pmemstream_region_runtime_initialize(stream, region, &region_runtime);
-	if (ret) {
-		return 0;
+	for (size_t offset = 0; offset < ENTRY_READ_PREFETCH_DISTANCE && offset < size; offset += CACHELINE_SIZE) {
+		PREFETCH_READ_ONCE(src8 + offset);
 	}
-	uint64_t append_offset = region_runtime_get_append_offset_relaxed(region_runtime);
 
-	return region_end_offset - append_offset;
+	for (size_t offset = 0; offset < size; offset += ENTRY_READ_BLOCK_SIZE) {
+		size_t prefetch_offset = offset + ENTRY_READ_PREFETCH_DISTANCE;
+		for (size_t i = 0; i < ENTRY_READ_BLOCK_SIZE && prefetch_offset + i < size; i += CACHELINE_SIZE) {
+			PREFETCH_READ_ONCE(src8 + prefetch_offset + i);
+		}
+
+		size_t block_size = size - offset < ENTRY_READ_BLOCK_SIZE ? size - offset : ENTRY_READ_BLOCK_SIZE;
+		memcpy(dst8 + offset, src8 + offset, block_size);
+	}
 }
 
-int pmemstream_region_free(struct pmemstream *stream, struct pmemstream_region region)
+int pmemstream_entry_read(struct pmemstream *stream, struct pmemstream_entry entry, void *dst, size_t size,
+			  size_t *entry_size)
 {
-	// XXX: unlock
-
-	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	int ret = pmemstream_validate_stream_and_offset(stream, entry.offset);
 	if (ret) {
 		return ret;
 	}
 
-	allocator_region_free(&stream->data, &stream->header->region_allocator_header, region.offset);
-	region_runtimes_map_remove(stream->region_runtimes_map, region);
+	if (!dst && size) {
+		return -1;
+	}
 
+	const struct span_entry *span_entry =
+		(const struct span_entry *)span_offset_to_span_ptr(&stream->data, entry.offset);
+	size_t data_size = span_get_size(&span_entry->span_timestamped_base.span_base);
+
+	pmemstream_copy_entry_data(dst, span_entry->data, size < data_size ? size : data_size);
+	if (entry_size) {
+		*entry_size = data_size;
+	}
 	return 0;
 }
 
-// returns pointer to the data of the entry
-const void *pmemstream_entry_data(struct pmemstream *stream, struct pmemstream_entry entry)
+int pmemstream_entry_read_batch(struct pmemstream *stream, struct pmemstream_entry_read_request *requests,
+				size_t count)
 {
-	int ret = pmemstream_validate_stream_and_offset(stream, entry.offset);
-	if (ret) {
-		return NULL;
+	if (!requests && count) {
+		return -1;
 	}
 
-	struct span_entry *span_entry = (struct span_entry *)span_offset_to_span_ptr(&stream->data, entry.offset);
-	return span_entry->data;
+	for (size_t i = 0; i < count; i++) {
+		int ret = pmemstream_validate_stream_and_offset(stream, requests[i].entry.offset);
+		if (ret) {
+			return ret;
+		}
+		if (!requests[i].dst && requests[i].size) {
+			return -1;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		/* Size of the next entry is needed right after copying the current one - fetch it in the meantime. */
+		if (i + 1 < count) {
+			PREFETCH_READ_ONCE(span_offset_to_span_ptr(&stream->data, requests[i + 1].entry.offset));
+		}
+
+		const struct span_entry *span_entry =
+			(const struct span_entry *)span_offset_to_span_ptr(&stream->data, requests[i].entry.offset);
+		size_t entry_size = span_get_size(&span_entry->span_timestamped_base.span_base);
+		size_t size = requests[i].size < entry_size ? requests[i].size : entry_size;
+
+		pmemstream_copy_entry_data(requests[i].dst, span_entry->data, size);
+		requests[i].entry_size = entry_size;
+	}
+
+	return 0;
 }
 
 // returns the size of the entry
@@ -425,6 +1700,11 @@ int pmemstream_region_runtime_initialize(struct pmemstream *stream, struct pmems
 		return ret;
 	}
 
+	/* Entries are appended to a chained region through its first segment only. */
+	if (region_is_continuation(&stream->data, region)) {
+		return -1;
+	}
+
 	ret = region_runtimes_map_get_or_create(stream->region_runtimes_map, region, region_runtime);
 	if (ret) {
 		return ret;
@@ -443,8 +1723,7 @@ static size_t pmemstream_entry_total_size_aligned(size_t size)
 
 struct async_operation *pmemstream_async_operation(struct pmemstream *stream, uint64_t timestamp)
 {
-	// XXX: require MAX_CONCURRENCY to be power of two and use bit ops
-	uint64_t ops_index = timestamp % PMEMSTREAM_MAX_CONCURRENCY;
+	uint64_t ops_index = timestamp & (stream->max_concurrency - 1);
 	return &stream->async_ops[ops_index];
 }
 
@@ -480,6 +1759,67 @@ static void pmemstream_publish_timestamp(struct pmemstream *stream, uint64_t tim
 	atomic_store_release(&pmemstream_async_operation(stream, timestamp)->timestamp, timestamp);
 }
 
+/* Appends a new segment to a chained region whose last segment cannot fit an entry of 'entry_total_size' bytes.
+ * Segment is sealed only once all entries reserved in it are published - until then (and for regions which are not
+ * chained), -1 is returned as for any full region. */
+static int pmemstream_region_grow(struct pmemstream *stream, struct pmemstream_region region,
+				  struct pmemstream_region_runtime *region_runtime, size_t entry_total_size)
+{
+	if (!region_is_chained(&stream->data, region) || region_runtime_has_pending_entries(region_runtime)) {
+		return -1;
+	}
+
+	/* All segments have the size of the first one - entry which does not fit in it would not fit anywhere. */
+	if (region_first_entry_offset(region) + entry_total_size > region_data_end_offset(&stream->data, region)) {
+		return -1;
+	}
+
+	size_t size = span_get_size(span_offset_to_span_ptr(&stream->data, region.offset));
+	uint64_t chain = SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_GROWABLE | SPAN_REGION_CHAIN_CONTINUATION;
+	uint64_t offset = pmemstream_region_allocate_offset(stream, size, 0, chain);
+	if (offset == PMEMSTREAM_INVALID_OFFSET) {
+		return -1;
+	}
+
+	/* All entries of the full segment are published, so their timestamps are already acquired. */
+	uint64_t next_timestamp;
+	atomic_load_acquire(&stream->next_timestamp, &next_timestamp);
+
+	struct pmemstream_region segment = {.offset = offset};
+	region_runtime_append_segment(region_runtime, segment, next_timestamp - 1);
+
+	return 0;
+}
+
+/* Makes sure that an entry of 'entry_total_size' bytes can be appended to a ring region - wraps appends around to
+ * the region's beginning if needed. An empty span must always fit after the entry, so that it never overwrites
+ * the head (and there is space for the wrap marker). As for chained regions, appends wrap around only if all entries
+ * reserved in the region are published. Returns -1 if there is not enough space before the head. */
+static int pmemstream_region_ring_make_space(struct pmemstream *stream, struct pmemstream_region region,
+					     struct pmemstream_region_runtime *region_runtime, size_t entry_total_size)
+{
+	uint64_t append_offset = region_runtime_get_append_offset_acquire(region_runtime);
+	uint64_t head_offset = region_runtime_get_head_offset_acquire(region_runtime);
+	size_t required_size = entry_total_size + sizeof(struct span_entry);
+
+	if (append_offset < head_offset) {
+		/* Appends already wrapped around. */
+		return append_offset + required_size <= head_offset ? 0 : -1;
+	}
+
+	if (append_offset + required_size <= region_data_end_offset(&stream->data, region)) {
+		return 0;
+	}
+
+	if (region_runtime_has_pending_entries(region_runtime) ||
+	    region_first_entry_offset(region) + required_size > head_offset) {
+		return -1;
+	}
+
+	region_runtime_wrap(region_runtime);
+	return 0;
+}
+
 int pmemstream_reserve(struct pmemstream *stream, struct pmemstream_region region,
 		       struct pmemstream_region_runtime *region_runtime, size_t size,
 		       struct pmemstream_entry *reserved_entry, void **data_addr)
@@ -504,14 +1844,34 @@ int pmemstream_reserve(struct pmemstream *stream, struct pmemstream_region regio
 		}
 	}
 
+	if (!region_runtime_is_active_acquire(region_runtime)) {
+		pmemstream_add_active_region(stream, region, region_runtime);
+	}
+
 	uint64_t offset = region_runtime_get_append_offset_acquire(region_runtime);
-	uint8_t *destination = (uint8_t *)pmemstream_offset_to_ptr(&stream->data, offset);
-	assert(offset >= region.offset + offsetof(struct span_region, data));
-	if (offset + entry_total_size_span_aligned > region.offset + span_get_total_size(span_region)) {
-		return -1;
+	struct pmemstream_region segment = region_runtime_get_segment(region_runtime);
+	if (region_is_ring(&stream->data, region)) {
+		ret = pmemstream_region_ring_make_space(stream, region, region_runtime, entry_total_size_span_aligned);
+		if (ret) {
+			return ret;
+		}
+		offset = region_runtime_get_append_offset_acquire(region_runtime);
+	} else if (offset + entry_total_size_span_aligned > region_data_end_offset(&stream->data, segment)) {
+		ret = pmemstream_region_grow(stream, region, region_runtime, entry_total_size_span_aligned);
+		if (ret) {
+			return ret;
+		}
+		offset = region_runtime_get_append_offset_acquire(region_runtime);
+		segment = region_runtime_get_segment(region_runtime);
 	}
 
-	region_runtime_increase_append_offset(region_runtime, entry_total_size_span_aligned);
+	uint8_t *destination = (uint8_t *)pmemstream_offset_to_ptr(&stream->data, offset);
+	assert(offset >= region_first_entry_offset(segment));
+
+	ret = region_runtime_increase_append_offset(region_runtime, entry_total_size_span_aligned);
+	if (ret) {
+		return ret;
+	}
 
 	reserved_entry->offset = offset;
 	/* data is right after the entry metadata */
@@ -520,6 +1880,17 @@ int pmemstream_reserve(struct pmemstream *stream, struct pmemstream_region regio
 	return ret;
 }
 
+/* Blocks until entry with 'timestamp' is persisted (or only committed, in relaxed persistence mode). */
+static void pmemstream_sync_wait(struct pmemstream *stream, uint64_t timestamp)
+{
+	// XXX: runtime_wait or blocking call
+	struct pmemstream_async_wait_fut future = stream->persistence_mode == PMEMSTREAM_PERSISTENCE_RELAXED
+		? pmemstream_async_wait_committed(stream, timestamp)
+		: pmemstream_async_wait_persisted(stream, timestamp);
+	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+		;
+}
+
 int pmemstream_publish(struct pmemstream *stream, struct pmemstream_region region,
 		       struct pmemstream_region_runtime *region_runtime, struct pmemstream_entry entry, size_t size)
 {
@@ -528,11 +1899,7 @@ int pmemstream_publish(struct pmemstream *stream, struct pmemstream_region regio
 		return ret;
 	}
 
-	// XXX: runtime_wait or blocking call
-	uint64_t timestamp = pmemstream_entry_timestamp(stream, entry);
-	struct pmemstream_async_wait_fut future = pmemstream_async_wait_persisted(stream, timestamp);
-	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
-		;
+	pmemstream_sync_wait(stream, pmemstream_entry_timestamp(stream, entry));
 
 	return 0;
 }
@@ -558,11 +1925,7 @@ int pmemstream_append(struct pmemstream *stream, struct pmemstream_region region
 		*new_entry = entry;
 	}
 
-	// XXX: runtime_wait or blocking call
-	struct pmemstream_async_wait_fut future =
-		pmemstream_async_wait_persisted(stream, pmemstream_entry_timestamp(stream, entry));
-	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
-		;
+	pmemstream_sync_wait(stream, pmemstream_entry_timestamp(stream, entry));
 
 	return 0;
 }
@@ -611,6 +1974,9 @@ static int pmemstream_async_publish_generic(struct pmemstream *stream, struct pm
 	span_timestamped_base_atomic_store((struct span_timestamped_base *)destination,
 					   span_entry.span_timestamped_base);
 
+	region_markers_update(&stream->data, region, entry.offset, entry_total_size_span_aligned, timestamp);
+	region_runtime_entry_published(region_runtime);
+
 	pmemstream_publish_timestamp(stream, timestamp);
 
 	return 0;
@@ -670,8 +2036,8 @@ static bool pmemstream_acquire_timestamps_for_processing(struct pmemstream_async
 		return false;
 
 	uint64_t last_timestamp = data->timestamp;
-	if (last_timestamp - processing_timestamp > PMEMSTREAM_TIMESTAMP_PROCESSING_BATCH)
-		last_timestamp = processing_timestamp + PMEMSTREAM_TIMESTAMP_PROCESSING_BATCH;
+	if (last_timestamp - processing_timestamp > data->stream->timestamp_processing_batch)
+		last_timestamp = processing_timestamp + data->stream->timestamp_processing_batch;
 
 	const bool weak = false;
 	bool success = false;
@@ -713,6 +2079,70 @@ static bool pmemstream_process_async_ops(struct pmemstream_async_wait_data *data
 	return false;
 }
 
+int pmemstream_register_commit_waker(struct pmemstream *stream, const struct future_waker *waker)
+{
+	int ret = 0;
+	pthread_mutex_lock(&stream->commit_wakers_lock);
+
+	for (size_t i = 0; i < stream->commit_wakers_count; i++) {
+		if (stream->commit_wakers[i].data == waker->data && stream->commit_wakers[i].wake == waker->wake) {
+			goto unlock;
+		}
+	}
+
+	if (stream->commit_wakers_count == stream->commit_wakers_capacity) {
+		size_t new_capacity = stream->commit_wakers_capacity ? 2 * stream->commit_wakers_capacity : 8;
+		struct future_waker *new_wakers =
+			realloc(stream->commit_wakers, new_capacity * sizeof(*stream->commit_wakers));
+		if (!new_wakers) {
+			ret = -1;
+			goto unlock;
+		}
+		stream->commit_wakers = new_wakers;
+		stream->commit_wakers_capacity = new_capacity;
+	}
+
+	stream->commit_wakers[stream->commit_wakers_count] = *waker;
+	atomic_store_relaxed(&stream->commit_wakers_count, stream->commit_wakers_count + 1);
+
+unlock:
+	pthread_mutex_unlock(&stream->commit_wakers_lock);
+
+	/* Pairs with the fence in pmemstream_wake_commit_wakers: either the caller will observe increased
+	 * committed_timestamp (when checking it again), or the committer will see the registered waker. */
+	atomic_thread_fence_seq_cst();
+
+	return ret;
+}
+
+static void pmemstream_wake_commit_wakers(struct pmemstream *stream)
+{
+	atomic_thread_fence_seq_cst();
+
+	/* Fast path - nobody is waiting. */
+	size_t count;
+	atomic_load_relaxed(&stream->commit_wakers_count, &count);
+	if (count == 0) {
+		return;
+	}
+
+	/* Take ownership of registered wakers, so that they can be called without holding the lock (a waker might
+	 * poll the future and register itself again). */
+	pthread_mutex_lock(&stream->commit_wakers_lock);
+	struct future_waker *wakers = stream->commit_wakers;
+	count = stream->commit_wakers_count;
+	stream->commit_wakers = NULL;
+	stream->commit_wakers_capacity = 0;
+	atomic_store_relaxed(&stream->commit_wakers_count, 0);
+	pthread_mutex_unlock(&stream->commit_wakers_lock);
+
+	for (size_t i = 0; i < count; i++) {
+		FUTURE_WAKER_WAKE(&wakers[i]);
+	}
+
+	free(wakers);
+}
+
 static void pmemstream_increase_committed_timestamp(struct pmemstream *stream, size_t num)
 {
 #ifndef NDEBUG
@@ -730,6 +2160,8 @@ static void pmemstream_increase_committed_timestamp(struct pmemstream *stream, s
 	for (uint64_t i = 0; i < num; i++) {
 		sem_post(&stream->async_ops_semaphore);
 	}
+
+	pmemstream_wake_commit_wakers(stream);
 }
 
 static bool pmemstream_should_acquire_next_timestamp_batch(struct pmemstream_async_wait_data *data)
@@ -871,6 +2303,152 @@ static enum future_state pmemstream_async_wait_persisted_impl(struct future_cont
 	return FUTURE_STATE_RUNNING;
 }
 
+/* Sets 'end_offset' to the end of range of committed entries, which starts at 'from_offset' and fits in 'size'
+ * bytes. If there is no such entry, 'end_offset' is equal to 'from_offset'. Range never spans multiple segments of
+ * a chained region - if 'from_offset' is at the end of a full segment, it is moved to the next one. Similarly,
+ * range never wraps around the end of a ring region. */
+static int pmemstream_region_read_range(struct pmemstream *stream, struct pmemstream_region region,
+					uint64_t *from_offset, size_t size, uint64_t *end_offset)
+{
+	struct pmemstream_entry_iterator iterator;
+	/* Reading is done on behalf of the caller, region recovery is left for the writer. */
+	int ret = entry_iterator_initialize(&iterator, stream, region, false);
+	if (ret) {
+		return ret;
+	}
+
+	struct pmemstream_region segment = region;
+	while (*from_offset < region_first_entry_offset(segment) ||
+	       *from_offset > region_data_end_offset(&stream->data, segment)) {
+		segment = region_next_segment(&stream->data, segment);
+		if (segment.offset == PMEMSTREAM_INVALID_OFFSET) {
+			return -1;
+		}
+	}
+
+	/* Only entries committed before the read started are copied. */
+	iterator.max_timestamp = pmemstream_committed_timestamp(stream);
+	iterator.segment = segment;
+	iterator.offset = *from_offset;
+	if (pmemstream_entry_iterator_is_valid(&iterator) != 0) {
+		if (!region_follow_chain(&iterator)) {
+			region_follow_wrap(&iterator);
+		}
+		*from_offset = iterator.offset;
+	}
+
+	*end_offset = *from_offset;
+	while (pmemstream_entry_iterator_is_valid(&iterator) == 0) {
+		const struct span_base *span_base = span_offset_to_span_ptr(&stream->data, iterator.offset);
+		uint64_t next_offset = iterator.offset + span_get_total_size(span_base);
+		if (next_offset - *from_offset > size) {
+			break;
+		}
+
+		*end_offset = next_offset;
+		pmemstream_entry_iterator_next(&iterator);
+		if (iterator.offset != next_offset) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static enum future_state pmemstream_async_region_read_impl(struct future_context *ctx,
+							   struct future_notifier *notifier)
+{
+	struct pmemstream_async_region_read_data *data = future_context_get_data(ctx);
+	if (future_poll(FUTURE_AS_RUNNABLE(&data->copy_future), notifier) != FUTURE_STATE_COMPLETE) {
+		return FUTURE_STATE_RUNNING;
+	}
+
+	return FUTURE_STATE_COMPLETE;
+}
+
+struct pmemstream_async_region_read_fut pmemstream_async_region_read(struct pmemstream *stream, struct vdm *vdm,
+								     struct pmemstream_region region,
+								     struct pmemstream_entry from_entry, void *dst,
+								     size_t size)
+{
+	struct pmemstream_async_region_read_fut future;
+	future.output.error_code = -1;
+	future.output.size = 0;
+	future.output.next_entry = from_entry;
+
+	int ret = pmemstream_validate_stream_and_offset(stream, region.offset);
+	if (ret || !vdm || (!dst && size)) {
+		FUTURE_INIT_COMPLETE(&future);
+		return future;
+	}
+
+	if (from_entry.offset != PMEMSTREAM_INVALID_OFFSET) {
+		ret = pmemstream_validate_stream_and_offset(stream, from_entry.offset);
+		if (ret) {
+			FUTURE_INIT_COMPLETE(&future);
+			return future;
+		}
+	}
+
+	uint64_t from_offset = from_entry.offset;
+	if (from_offset == PMEMSTREAM_INVALID_OFFSET) {
+		from_offset = region_head_offset(&stream->data, region);
+	}
+
+	uint64_t end_offset;
+	ret = pmemstream_region_read_range(stream, region, &from_offset, size, &end_offset);
+	if (ret) {
+		FUTURE_INIT_COMPLETE(&future);
+		return future;
+	}
+
+	future.output.error_code = 0;
+	future.output.size = end_offset - from_offset;
+	future.output.next_entry.offset = end_offset;
+
+	if (future.output.size == 0) {
+		FUTURE_INIT_COMPLETE(&future);
+		return future;
+	}
+
+	void *src = (void *)span_offset_to_span_ptr(&stream->data, from_offset);
+	future.data.copy_future = vdm_memcpy(vdm, dst, src, future.output.size, 0);
+	FUTURE_INIT(&future, pmemstream_async_region_read_impl);
+
+	return future;
+}
+
+int pmemstream_copied_entry_next(const void *buffer, size_t size, size_t *offset,
+				 struct pmemstream_copied_entry *entry)
+{
+	if (!buffer || !offset || !entry) {
+		return -1;
+	}
+
+	if (*offset > size || size - *offset < sizeof(struct span_entry)) {
+		return -1;
+	}
+
+	/* Buffer provided by the user does not have to be aligned - metadata is not accessed in place. */
+	const uint8_t *span_ptr = (const uint8_t *)buffer + *offset;
+	struct span_timestamped_base span_timestamped;
+	memcpy(&span_timestamped, span_ptr, sizeof(span_timestamped));
+	if (span_get_type(&span_timestamped.span_base) != SPAN_ENTRY) {
+		return -1;
+	}
+
+	size_t total_size = span_get_total_size(&span_timestamped.span_base);
+	if (size - *offset < total_size) {
+		return -1;
+	}
+
+	entry->data = span_ptr + offsetof(struct span_entry, data);
+	entry->size = span_get_size(&span_timestamped.span_base);
+	entry->timestamp = span_timestamped.timestamp;
+	*offset += total_size;
+	return 0;
+}
+
 /* XXX: possible extra variants
  * - pmemstream_wait_committed/persisted (blocking)
  * - pmemstream_process_committed/persisted (process as many committed/persisted ops as possible without blocking)
@@ -7,6 +7,7 @@
 #define LIBPMEMSTREAM_INTERNAL_H
 
 #include <assert.h>
+#include <pthread.h>
 #include <semaphore.h>
 
 #include <libminiasync.h>
@@ -15,7 +16,7 @@
 #include "libpmemstream.h"
 #include "pmemstream_runtime.h"
 #include "region.h"
-#include "region_allocator/allocator_base.h"
+#include "region_allocator/region_allocator.h"
 #include "span.h"
 
 #ifdef __cplusplus
@@ -25,20 +26,46 @@ extern "C" {
 #define PMEMSTREAM_SIGNATURE ("PMEMSTREAM")
 #define PMEMSTREAM_SIGNATURE_SIZE (64)
 
+/* Version of the on-media layout, incremented on every incompatible change. Streams with a different version
+ * (including ones created before the version was stored - with stream size in its place) are not opened.
+ * Version 2: set of active regions, block markers (span_region.marker_block_size), clean shutdown flag, regions'
+ * tail hints, segregated free lists and redo log of the region allocator, chained regions (span_region.chain), ring
+ * regions (SPAN_REGION_CHAIN_RING flag and span_region_ring head at the end of the region), compacted regions
+ * (SPAN_REGION_CHAIN_COMPACTED flag). */
+#define PMEMSTREAM_LAYOUT_VERSION (2ULL)
+
 /* In some cases we relay on incrementing timestamp by 1.
  * Because of that we require FIRST timestamp to be exactly "1 away" from INVALID. */
 #define PMEMSTREAM_INVALID_TIMESTAMP (0ULL)
 #define PMEMSTREAM_FIRST_TIMESTAMP (PMEMSTREAM_INVALID_TIMESTAMP + 1ULL)
 static_assert(PMEMSTREAM_INVALID_TIMESTAMP + 1 == PMEMSTREAM_FIRST_TIMESTAMP, "wrong timestamp's macros values");
 
-/* XXX: make this a parameter & remove "constraint" in the manpage */
-/* It has to be power of two */
-#define PMEMSTREAM_MAX_CONCURRENCY 1024ULL
+/* Default values of tunables (see pmemstream_config). Max concurrency has to be power of two. */
+#define PMEMSTREAM_DEFAULT_MAX_CONCURRENCY 1024ULL
+#define PMEMSTREAM_DEFAULT_TIMESTAMP_PROCESSING_BATCH 15ULL
+
+/* Maximum number of regions passed to the allocator at once by pmemstream_region_free_many. */
+#define PMEMSTREAM_REGION_FREE_BATCH 64ULL
+
+/* Maximum number of regions tracked in the persistent set of active regions. */
+#define PMEMSTREAM_ACTIVE_REGIONS_MAX 128ULL
 
-#define PMEMSTREAM_TIMESTAMP_PROCESSING_BATCH 15ULL
+/*
+ * Persistent set of regions which might have been written to since the stream was opened. Only these regions
+ * have to be marked for recovery at next open - other regions contain only persisted entries.
+ * A region is added on the first append (in given session) and the set is cleared at open, after marking.
+ */
+struct pmemstream_active_regions {
+	/* Set if there were more active regions than fit in 'offsets' - all regions have to be marked then. */
+	uint64_t overflow;
+
+	/* Offsets of active regions, PMEMSTREAM_INVALID_OFFSET marks a free slot. */
+	uint64_t offsets[PMEMSTREAM_ACTIVE_REGIONS_MAX];
+};
 
 struct pmemstream_header {
 	char signature[PMEMSTREAM_SIGNATURE_SIZE];
+	uint64_t layout_version;
 	uint64_t stream_size;
 	uint64_t block_size;
 
@@ -48,6 +75,12 @@ struct pmemstream_header {
 	uint64_t persisted_timestamp;
 
 	struct allocator_header region_allocator_header;
+
+	struct pmemstream_active_regions active_regions;
+
+	/* Set by pmemstream_delete if all entries were persisted and tail hints were stored in regions.
+	 * Cleared at open. */
+	uint64_t clean_shutdown;
 };
 
 /* Description of an async operation. */
@@ -61,6 +94,36 @@ struct async_operation {
 	uint64_t size;
 };
 
+/* Options used when opening a stream. */
+struct pmemstream_open_options {
+	/* Number of threads used for recovering all regions at open. If 0, regions are recovered lazily
+	 * (on the first append or after iterating over all entries). */
+	size_t recovery_threads;
+
+	enum pmemstream_prefault_mode prefault;
+
+	/* Number of threads used for prefaulting, 0 is treated as 1. */
+	size_t prefault_threads;
+
+	/* Size of the concurrent operations window, must be power of two. 0 means default. */
+	size_t max_concurrency;
+
+	/* Maximum number of timestamps committed at once. 0 means default. */
+	size_t commit_batch_size;
+
+	enum pmemstream_persistence_mode persistence_mode;
+
+	/* Size of data of regions kept in the region pool and their number. Pool is disabled if 'region_pool_count'
+	 * is 0. */
+	size_t region_pool_size;
+	size_t region_pool_count;
+};
+
+struct pmemstream_config {
+	size_t block_size;
+	struct pmemstream_open_options options;
+};
+
 struct pmemstream {
 	/* Points to pmem-resided header. */
 	struct pmemstream_header *header;
@@ -74,6 +137,8 @@ struct pmemstream {
 
 	struct region_runtimes_map *region_runtimes_map;
 
+	struct allocator_runtime region_allocator;
+
 	/* All entries with timestamps less than or equal to 'committed_timestamp' can be treated as committed. */
 	alignas(CACHELINE_SIZE) uint64_t committed_timestamp;
 
@@ -95,10 +160,64 @@ struct pmemstream {
 	/* Contains timestamps which are ready to be committed. */
 	critnib *ready_timestamps;
 
-	/* Protects against exceeding PMEMSTREAM_MAX_CONCURRENCY. */
+	/* Number of elements of 'async_ops', power of two. */
+	size_t max_concurrency;
+
+	/* Maximum number of timestamps committed at once by a single thread. */
+	uint64_t timestamp_processing_batch;
+
+	enum pmemstream_persistence_mode persistence_mode;
+
+	/* Protects against exceeding max_concurrency. */
 	sem_t async_ops_semaphore;
+
+	/* Wakers of futures waiting for new committed entries. Each waker is called (and removed) when
+	 * committed_timestamp is increased. 'commit_wakers_count' can be read without holding the lock. */
+	pthread_mutex_t commit_wakers_lock;
+	struct future_waker *commit_wakers;
+	size_t commit_wakers_count;
+	size_t commit_wakers_capacity;
+
+	/* Protects header->active_regions. */
+	pthread_mutex_t active_regions_lock;
+
+	/* Set if the stream was cleanly shut down - regions' tail hints can be used instead of iterating. */
+	bool use_tail_hints;
+
+	/* Pre-initialized regions, NULL if the pool is disabled. */
+	struct pmemstream_region_pool *region_pool;
 };
 
+/* Same as pmemstream_from_map, but takes 'options' into account instead of reading them from the environment. */
+int pmemstream_from_map_with_options(struct pmemstream **stream, size_t block_size, struct pmem2_map *map,
+				     const struct pmemstream_open_options *options);
+
+/* Returns array of all allocated regions (must be freed by the caller) and sets 'regions_count'. */
+struct pmemstream_region *pmemstream_get_allocated_regions(struct pmemstream *stream, size_t *regions_count);
+
+/* Recovers all regions (making them ready for appends) using 'nthreads' threads. */
+int pmemstream_recover_regions_parallel(struct pmemstream *stream, size_t nthreads);
+
+/* Populates all pages in range [addr, addr + size). Uses MADV_POPULATE_WRITE if supported, touches each page
+ * otherwise. */
+void pmemstream_prefault_range(void *addr, size_t size);
+
+/* Prefaults memory specified by 'mode' using 'nthreads' threads, each of them populating separate ranges. */
+int pmemstream_prefault(struct pmemstream *stream, struct pmem2_map *map, enum pmemstream_prefault_mode mode,
+			size_t nthreads);
+
+/* Starts a background worker which keeps up to 'capacity' allocated (and prefaulted) regions with 'size' bytes of
+ * data ready to be taken. Pooled regions are hidden as continuations, so they are freed at next open after a crash.
+ * Returns NULL on failure. */
+struct pmemstream_region_pool *pmemstream_region_pool_new(struct pmemstream *stream, size_t size, size_t capacity);
+
+/* Stops the worker and frees all regions left in the pool. */
+void pmemstream_region_pool_delete(struct pmemstream_region_pool *pool);
+
+/* Takes a region with 'size' bytes of data from the pool. Returns PMEMSTREAM_INVALID_OFFSET if the pool is empty or
+ * holds regions of different size. Taken region is still hidden - the caller must set its chain. */
+uint64_t pmemstream_region_pool_pop(struct pmemstream_region_pool *pool, size_t size);
+
 static inline int pmemstream_validate_stream_and_offset(struct pmemstream *stream, uint64_t offset)
 {
 	if (!stream) {
@@ -110,6 +229,12 @@ static inline int pmemstream_validate_stream_and_offset(struct pmemstream *strea
 	return 0;
 }
 
+/* Registers 'waker' to be called once, after committed timestamp is increased. Registering the same waker
+ * multiple times (before it's called) has no effect.
+ *
+ * Returns 0 on success, error code otherwise. */
+int pmemstream_register_commit_waker(struct pmemstream *stream, const struct future_waker *waker);
+
 /* Convert offset to pointer to span. offset must be 8-bytes aligned. */
 static inline const struct span_base *span_offset_to_span_ptr(const struct pmemstream_runtime *data, uint64_t offset)
 {
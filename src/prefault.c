@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+/* Prefaulting of the stream's memory at open. */
+
+#include "common/parallel.h"
+#include "common/util.h"
+#include "libpmemstream_internal.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Ranges are split into chunks aligned to huge page sizes, so that each chunk is populated by a single thread,
+ * using whole 2 MiB / 1 GiB pages (if the mapping uses them). */
+#define PREFAULT_CHUNK_SIZE_2M (2UL * 1024 * 1024)
+#define PREFAULT_CHUNK_SIZE_1G (1024UL * 1024 * 1024)
+
+/* Chunks of 1 GiB are used only if each thread gets at least this many of them (for balancing the work). */
+#define PREFAULT_MIN_1G_CHUNKS_PER_THREAD 4UL
+
+/* Set if MADV_POPULATE_WRITE is not supported by the kernel - pages are touched one by one then. */
+static int prefault_madvise_unsupported;
+
+struct prefault_range {
+	uint8_t *addr;
+	size_t size;
+};
+
+/* Ranges to prefault, shared by all prefault workers. */
+struct prefault_data {
+	struct prefault_range *ranges;
+	size_t ranges_count;
+	size_t ranges_capacity;
+};
+
+static void prefault_touch_pages(volatile uint8_t *addr, size_t size, size_t pagesize)
+{
+	volatile uint8_t *addr_end = addr + size;
+	uint8_t tmp;
+	for (; addr < addr_end; addr += pagesize) {
+		*addr = *addr;
+		tmp = *addr;
+		(void)tmp;
+	}
+}
+
+void pmemstream_prefault_range(void *addr, size_t size)
+{
+	size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+	uintptr_t begin = ALIGN_DOWN((uintptr_t)addr, pagesize);
+	uintptr_t end = ALIGN_UP((uintptr_t)addr + size, pagesize);
+	if (begin == end) {
+		return;
+	}
+
+#ifdef MADV_POPULATE_WRITE
+	int unsupported;
+	atomic_load_relaxed(&prefault_madvise_unsupported, &unsupported);
+	if (!unsupported) {
+		/* Populates (write-faults) all pages in the range without modifying them, in a single syscall. */
+		if (madvise((void *)begin, end - begin, MADV_POPULATE_WRITE) == 0) {
+			return;
+		}
+		if (errno == EINVAL) {
+			atomic_store_relaxed(&prefault_madvise_unsupported, 1);
+		}
+	}
+#endif
+
+	prefault_touch_pages((volatile uint8_t *)begin, end - begin, pagesize);
+}
+
+static int prefault_data_add_range(struct prefault_data *data, uint8_t *addr, size_t size)
+{
+	if (data->ranges_count == data->ranges_capacity) {
+		size_t new_capacity = data->ranges_capacity ? 2 * data->ranges_capacity : 64;
+		struct prefault_range *ranges = realloc(data->ranges, new_capacity * sizeof(*ranges));
+		if (!ranges) {
+			return -1;
+		}
+		data->ranges = ranges;
+		data->ranges_capacity = new_capacity;
+	}
+
+	data->ranges[data->ranges_count].addr = addr;
+	data->ranges[data->ranges_count].size = size;
+	data->ranges_count++;
+	return 0;
+}
+
+/* Splits [addr, addr + size) at 'chunk_size' boundaries and adds resulting chunks to 'data'. */
+static int prefault_data_add_chunks(struct prefault_data *data, uint8_t *addr, size_t size, size_t chunk_size)
+{
+	uint8_t *end = addr + size;
+	while (addr < end) {
+		uint8_t *chunk_end = (uint8_t *)ALIGN_DOWN((uintptr_t)addr + chunk_size, chunk_size);
+		if (chunk_end > end) {
+			chunk_end = end;
+		}
+		if (prefault_data_add_range(data, addr, (size_t)(chunk_end - addr))) {
+			return -1;
+		}
+		addr = chunk_end;
+	}
+	return 0;
+}
+
+/* Collects ranges to prefault: entire map or only allocated regions. Sets 'total_size'. */
+static int prefault_collect_ranges(struct pmemstream *stream, struct pmem2_map *map, enum pmemstream_prefault_mode mode,
+				   struct prefault_data *ranges, size_t *total_size)
+{
+	if (mode == PMEMSTREAM_PREFAULT_ALL) {
+		*total_size = pmem2_map_get_size(map);
+		return prefault_data_add_range(ranges, pmem2_map_get_address(map), *total_size);
+	}
+
+	assert(mode == PMEMSTREAM_PREFAULT_REGIONS);
+
+	size_t regions_count;
+	struct pmemstream_region *regions = pmemstream_get_allocated_regions(stream, &regions_count);
+	if (!regions) {
+		return -1;
+	}
+
+	int ret = 0;
+	*total_size = 0;
+	for (size_t i = 0; i < regions_count && !ret; i++) {
+		/* All segments of chained regions are prefaulted. */
+		struct pmemstream_region segment = regions[i];
+		for (; segment.offset != PMEMSTREAM_INVALID_OFFSET;
+		     segment = region_next_segment(&stream->data, segment)) {
+			const struct span_base *span_region = span_offset_to_span_ptr(&stream->data, segment.offset);
+			/* Whole segment, including its metadata. */
+			size_t size = span_get_total_size(span_region);
+			ret = prefault_data_add_range(ranges, (uint8_t *)span_region, size);
+			if (ret) {
+				break;
+			}
+			*total_size += size;
+		}
+	}
+
+	free(regions);
+	return ret;
+}
+
+static int prefault_worker(size_t worker_id, size_t range_idx, void *arg)
+{
+	(void)worker_id;
+	struct prefault_data *data = (struct prefault_data *)arg;
+	pmemstream_prefault_range(data->ranges[range_idx].addr, data->ranges[range_idx].size);
+	return 0;
+}
+
+int pmemstream_prefault(struct pmemstream *stream, struct pmem2_map *map, enum pmemstream_prefault_mode mode,
+			size_t nthreads)
+{
+	if (mode == PMEMSTREAM_PREFAULT_NONE) {
+		return 0;
+	}
+	if (nthreads == 0) {
+		nthreads = 1;
+	}
+
+	struct prefault_data ranges = {.ranges = NULL, .ranges_count = 0, .ranges_capacity = 0};
+	struct prefault_data data = {.ranges = NULL, .ranges_count = 0, .ranges_capacity = 0};
+
+	int ret = -1;
+	size_t total_size;
+	if (prefault_collect_ranges(stream, map, mode, &ranges, &total_size)) {
+		goto out;
+	}
+
+	/* Big ranges are split, so that the work can be distributed between threads. */
+	size_t chunk_size = PREFAULT_CHUNK_SIZE_2M;
+	if (total_size / nthreads >= PREFAULT_MIN_1G_CHUNKS_PER_THREAD * PREFAULT_CHUNK_SIZE_1G) {
+		chunk_size = PREFAULT_CHUNK_SIZE_1G;
+	}
+	for (size_t i = 0; i < ranges.ranges_count; i++) {
+		if (prefault_data_add_chunks(&data, ranges.ranges[i].addr, ranges.ranges[i].size, chunk_size)) {
+			goto out;
+		}
+	}
+
+	ret = parallel_for(nthreads, data.ranges_count, prefault_worker, &data);
+
+out:
+	free(data.ranges);
+	free(ranges.ranges);
+	return ret;
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+/* Parallel recovery of regions at stream open. */
+
+#include "common/parallel.h"
+#include "libpmemstream_internal.h"
+#include "region.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+/* State shared by all recovery workers. */
+struct recovery_data {
+	struct pmemstream *stream;
+	const struct pmemstream_region *regions;
+};
+
+static int recover_region(size_t worker_id, size_t region_idx, void *arg)
+{
+	(void)worker_id;
+	struct recovery_data *data = (struct recovery_data *)arg;
+	struct pmemstream *stream = data->stream;
+	struct pmemstream_region region = data->regions[region_idx];
+
+	struct pmemstream_region_runtime *region_runtime;
+	int ret = region_runtimes_map_get_or_create(stream->region_runtimes_map, region, &region_runtime);
+	if (ret) {
+		return ret;
+	}
+
+	return region_runtime_iterate_and_initialize_for_write_locked(stream, region, region_runtime);
+}
+
+int pmemstream_recover_regions_parallel(struct pmemstream *stream, size_t nthreads)
+{
+	assert(nthreads > 0);
+
+	size_t regions_count;
+	struct pmemstream_region *regions = pmemstream_get_allocated_regions(stream, &regions_count);
+	if (!regions) {
+		return -1;
+	}
+
+	struct recovery_data data = {.stream = stream, .regions = regions};
+	int ret = parallel_for(nthreads, regions_count, recover_region, &data);
+
+	free(regions);
+	return ret;
+}
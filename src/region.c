@@ -7,6 +7,10 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdlib.h>
+
+/* Granularity of the sparse entry index (see struct pmemstream_region_runtime). */
+#define REGION_INDEX_CHUNK_SIZE 4096UL
 
 /* After opening pmemstream, each region_runtime is in one of those 2 states.
  * The only possible state transition is: REGION_RUNTIME_STATE_READ_READY -> REGION_RUNTIME_STATE_WRITE_READY
@@ -39,13 +43,48 @@ struct pmemstream_region_runtime {
 	 */
 	struct pmemstream_region region;
 
+	/* Segment to which entries are appended - the last segment of a chained region, 'region' otherwise. */
+	struct pmemstream_region segment;
+
 	/*
 	 * Offset at which new entries will be appended.
 	 */
 	uint64_t append_offset;
 
+	/* Head of a ring region (see span_region_ring). Updated only after the persistent head is. */
+	uint64_t head_offset;
+
 	/* Protects region initialization step. */
 	pthread_mutex_t region_lock;
+
+	/* Set once the region is added to the persistent set of active regions (in the current session). */
+	bool active;
+
+	/* Number of reserved, but not yet published entries. Tail hint is not stored if this is non-zero. */
+	uint64_t pending_entries;
+
+	/* Set while the region is being compacted - entries cannot be reserved then. */
+	bool compacting;
+
+	/*
+	 * Sparse index of entries, used for reverse iteration. Region data is divided into chunks of
+	 * REGION_INDEX_CHUNK_SIZE bytes and for each chunk, offset of the first entry which starts in it
+	 * is stored (or PMEMSTREAM_INVALID_OFFSET if there is no such entry).
+	 * The index is seeded while the region is recovered (which has to iterate over all entries to find
+	 * the tail anyway) or, for regions which were not recovered this way, built on first use. Afterwards
+	 * it is only extended with new entries.
+	 */
+	uint64_t *index_chunks;
+	size_t index_chunks_count;
+
+	/* Offset right after the last indexed entry. */
+	uint64_t index_end_offset;
+
+	/* Offset of the last indexed entry or PMEMSTREAM_INVALID_OFFSET if there is none. */
+	uint64_t index_last_entry_offset;
+
+	/* Protects the index. */
+	pthread_mutex_t index_lock;
 };
 
 /*
@@ -83,7 +122,9 @@ static int free_region_runtime_cb(uintptr_t key, void *value, void *privdata)
 
 	/* XXX: Handle error */
 	pthread_mutex_destroy(&region_runtime->region_lock);
+	pthread_mutex_destroy(&region_runtime->index_lock);
 
+	free(region_runtime->index_chunks);
 	free(value);
 	return 0;
 }
@@ -107,14 +148,28 @@ static int region_runtimes_map_create_or_fail(struct region_runtimes_map *map, s
 
 	runtime->data = map->data;
 	runtime->region = region;
+	runtime->segment = region;
 	runtime->state = REGION_RUNTIME_STATE_READ_READY;
 	runtime->append_offset = PMEMSTREAM_INVALID_OFFSET;
+	runtime->head_offset = PMEMSTREAM_INVALID_OFFSET;
+	runtime->active = false;
+	runtime->pending_entries = 0;
+	runtime->compacting = false;
+	runtime->index_chunks = NULL;
+	runtime->index_chunks_count = 0;
+	runtime->index_end_offset = region_first_entry_offset(region);
+	runtime->index_last_entry_offset = PMEMSTREAM_INVALID_OFFSET;
 
 	int ret = pthread_mutex_init(&runtime->region_lock, NULL);
 	if (ret) {
 		goto err_region_lock;
 	}
 
+	ret = pthread_mutex_init(&runtime->index_lock, NULL);
+	if (ret) {
+		goto err_index_lock;
+	}
+
 	ret = critnib_insert(map->container, region.offset, runtime, 0 /* no update */);
 	if (ret) {
 		goto err_critnib_insert;
@@ -125,6 +180,8 @@ static int region_runtimes_map_create_or_fail(struct region_runtimes_map *map, s
 
 err_critnib_insert:
 	/* XXX: Handle error */
+	pthread_mutex_destroy(&runtime->index_lock);
+err_index_lock:
 	pthread_mutex_destroy(&runtime->region_lock);
 err_region_lock:
 	free(runtime);
@@ -190,24 +247,498 @@ uint64_t region_runtime_get_append_offset_acquire(const struct pmemstream_region
 void region_runtimes_map_remove(struct region_runtimes_map *map, struct pmemstream_region region)
 {
 	struct pmemstream_region_runtime *runtime = critnib_remove(map->container, region.offset);
-	free(runtime);
+	if (runtime) {
+		free_region_runtime_cb(region.offset, runtime, NULL);
+	}
 }
 
-void region_runtime_increase_append_offset(struct pmemstream_region_runtime *region_runtime, uint64_t diff)
+int region_runtime_increase_append_offset(struct pmemstream_region_runtime *region_runtime, uint64_t diff)
 {
 	assert(region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_WRITE_READY);
+	atomic_add_relaxed(&region_runtime->pending_entries, 1);
+
+	/* Pairs with the fence in region_runtime_compaction_begin: either the compaction sees the pending entry, or
+	 * the entry sees the compaction (and is not reserved). */
+	atomic_thread_fence_seq_cst();
+	bool compacting;
+	atomic_load_relaxed(&region_runtime->compacting, &compacting);
+	if (compacting) {
+		atomic_sub_relaxed(&region_runtime->pending_entries, 1);
+		return -1;
+	}
+
 	atomic_add_relaxed(&region_runtime->append_offset, diff);
+	return 0;
+}
+
+void region_runtime_entry_published(struct pmemstream_region_runtime *region_runtime)
+{
+	atomic_sub_relaxed(&region_runtime->pending_entries, 1);
+}
+
+bool region_runtime_has_pending_entries(const struct pmemstream_region_runtime *region_runtime)
+{
+	uint64_t pending_entries;
+	atomic_load_acquire(&region_runtime->pending_entries, &pending_entries);
+	return pending_entries != 0;
+}
+
+int region_runtime_compaction_begin(struct pmemstream_region_runtime *region_runtime)
+{
+	bool expected = false;
+	bool started;
+	atomic_compare_exchange_acquire_release(&region_runtime->compacting, &expected, true, false, &started);
+	if (!started) {
+		return -1;
+	}
+
+	atomic_thread_fence_seq_cst();
+	if (region_runtime_has_pending_entries(region_runtime)) {
+		region_runtime_compaction_abort(region_runtime);
+		return -1;
+	}
+
+	return 0;
+}
+
+void region_runtime_compaction_abort(struct pmemstream_region_runtime *region_runtime)
+{
+	atomic_store_release(&region_runtime->compacting, false);
+}
+
+struct pmemstream_region region_runtime_get_segment(const struct pmemstream_region_runtime *region_runtime)
+{
+	assert(region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_WRITE_READY);
+	return region_runtime->segment;
+}
+
+bool region_is_chained(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	return (span_region->chain & SPAN_REGION_CHAIN_GROWABLE) != 0;
+}
+
+bool region_is_continuation(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	return (span_region->chain & SPAN_REGION_CHAIN_CONTINUATION) != 0;
+}
+
+struct pmemstream_region region_next_segment(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+
+	/* Chain is linked concurrently with iterating over the region. */
+	uint64_t chain;
+	atomic_load_acquire(&span_region->chain, &chain);
+
+	struct pmemstream_region next = {.offset = chain & ~SPAN_REGION_CHAIN_FLAGS_MASK};
+	if (!(chain & SPAN_REGION_CHAIN_GROWABLE) || next.offset == SPAN_REGION_CHAIN_NO_NEXT) {
+		next.offset = PMEMSTREAM_INVALID_OFFSET;
+	}
+	return next;
+}
+
+bool region_is_ring(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	return (span_region->chain & SPAN_REGION_CHAIN_RING) != 0;
+}
+
+static size_t region_ring_size(const struct span_region *span_region)
+{
+	return (span_region->chain & SPAN_REGION_CHAIN_RING) ? sizeof(struct span_region_ring) : 0;
+}
+
+static struct span_region_ring *region_ring(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	uint64_t ring_offset =
+		region.offset + span_get_total_size(&span_region->span_base) - sizeof(struct span_region_ring);
+	return (struct span_region_ring *)pmemstream_offset_to_ptr(data, ring_offset);
+}
+
+int region_ring_initialize(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	struct span_region *span_region = (struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	/* Region is hidden (as a segment which is not linked from anywhere, so it is freed on open) until it has the
+	 * ring layout. */
+	assert(span_region->chain == (SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_CONTINUATION));
+	assert(span_region->marker_block_size == 0);
+
+	/* There must be space for at least one entry and the empty span after it. */
+	if (region_first_entry_offset(region) + 2 * sizeof(struct span_entry) + sizeof(struct span_region_ring) >
+	    region.offset + span_get_total_size(&span_region->span_base)) {
+		return -1;
+	}
+
+	/* Head must be set before the region is switched to the ring layout. Region becomes visible with the same
+	 * store. */
+	struct span_region_ring *ring = region_ring(data, region);
+	ring->head_offset = region_first_entry_offset(region);
+	data->persist(&ring->head_offset, sizeof(ring->head_offset));
+
+	span_region->chain = SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_RING;
+	data->persist(&span_region->chain, sizeof(span_region->chain));
+
+	return 0;
+}
+
+uint64_t region_head_offset(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	if (!region_is_ring(data, region)) {
+		return region_first_entry_offset(region);
+	}
+
+	uint64_t head_offset;
+	atomic_load_acquire(&region_ring(data, region)->head_offset, &head_offset);
+	return head_offset;
+}
+
+uint64_t region_runtime_get_head_offset_acquire(const struct pmemstream_region_runtime *region_runtime)
+{
+	assert(region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_WRITE_READY);
+	uint64_t head_offset;
+	atomic_load_acquire(&region_runtime->head_offset, &head_offset);
+	return head_offset;
+}
+
+int region_runtime_trim(struct pmemstream *stream, struct pmemstream_region_runtime *region_runtime,
+			uint64_t entry_offset)
+{
+	assert(region_is_ring(region_runtime->data, region_runtime->region));
+
+	struct pmemstream_region region = region_runtime->region;
+	uint64_t head_offset = region_runtime_get_head_offset_acquire(region_runtime);
+	uint64_t append_offset = region_runtime_get_append_offset_acquire(region_runtime);
+
+	/* Entries are stored in [head, append offset) or, once appends wrapped around, in [head, end of data) and
+	 * [first entry, append offset). */
+	bool in_range = head_offset <= append_offset ? entry_offset >= head_offset && entry_offset < append_offset
+						     : entry_offset >= head_offset || entry_offset < append_offset;
+	if (!in_range || entry_offset < region_first_entry_offset(region) ||
+	    entry_offset + sizeof(struct span_entry) > region_data_end_offset(region_runtime->data, region)) {
+		return -1;
+	}
+
+	const struct span_entry *span_entry =
+		(const struct span_entry *)span_offset_to_span_ptr(region_runtime->data, entry_offset);
+	struct span_timestamped_base span_timestamped =
+		span_timestamped_base_atomic_load(&span_entry->span_timestamped_base);
+	if (span_get_type(&span_timestamped.span_base) != SPAN_ENTRY ||
+	    span_timestamped.timestamp == PMEMSTREAM_INVALID_TIMESTAMP ||
+	    span_timestamped.timestamp > pmemstream_committed_timestamp(stream)) {
+		return -1;
+	}
+
+	if (entry_offset == head_offset) {
+		return 0;
+	}
+
+	/* Space before the new head is reused only once the head is persisted - otherwise, recovery could start
+	 * at an overwritten entry. */
+	struct span_region_ring *ring = region_ring(region_runtime->data, region);
+	atomic_store_release(&ring->head_offset, entry_offset);
+	region_runtime->data->persist(&ring->head_offset, sizeof(ring->head_offset));
+
+	atomic_store_release(&region_runtime->head_offset, entry_offset);
+
+	return 0;
+}
+
+void region_runtime_wrap(struct pmemstream_region_runtime *region_runtime)
+{
+	assert(region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_WRITE_READY);
+	assert(!region_runtime_has_pending_entries(region_runtime));
+	assert(region_is_ring(region_runtime->data, region_runtime->region));
+
+	const struct pmemstream_runtime *data = region_runtime->data;
+	uint64_t first_entry_offset = region_first_entry_offset(region_runtime->region);
+	uint64_t data_end_offset = region_data_end_offset(data, region_runtime->region);
+	uint64_t append_offset = region_runtime_get_append_offset_relaxed(region_runtime);
+	assert(region_runtime_get_head_offset_acquire(region_runtime) > first_entry_offset);
+	assert(append_offset + sizeof(struct span_entry) <= data_end_offset);
+
+	/* First entry is already trimmed - it is cleared before the wrap marker is stored, so that iterators (and
+	 * recovery) which follow the marker stop at the beginning of the region. */
+	struct span_empty span_empty = {.span_base = span_base_create(0, SPAN_EMPTY)};
+	struct span_base *first_span = (struct span_base *)pmemstream_offset_to_ptr(data, first_entry_offset);
+	span_base_atomic_store(first_span, span_empty.span_base);
+	data->persist(first_span, sizeof(*first_span));
+
+	/* Marker covers the rest of region's data. */
+	struct span_empty wrap_marker = {
+		.span_base = span_base_create(data_end_offset - append_offset - sizeof(struct span_empty), SPAN_EMPTY)};
+	struct span_base *marker_span = (struct span_base *)pmemstream_offset_to_ptr(data, append_offset);
+	span_base_atomic_store(marker_span, wrap_marker.span_base);
+	data->persist(marker_span, sizeof(*marker_span));
+
+	atomic_store_release(&region_runtime->append_offset, first_entry_offset);
+}
+
+static struct pmemstream_region region_last_segment(const struct pmemstream_runtime *data,
+						    struct pmemstream_region region)
+{
+	struct pmemstream_region next = region_next_segment(data, region);
+	while (next.offset != PMEMSTREAM_INVALID_OFFSET) {
+		region = next;
+		next = region_next_segment(data, region);
+	}
+	return region;
+}
+
+void region_runtime_append_segment(struct pmemstream_region_runtime *region_runtime, struct pmemstream_region segment,
+				   uint64_t max_timestamp)
+{
+	assert(region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_WRITE_READY);
+	assert(!region_runtime_has_pending_entries(region_runtime));
+	assert(region_is_continuation(region_runtime->data, segment));
+
+	struct span_region *span_region =
+		(struct span_region *)span_offset_to_span_ptr(region_runtime->data, region_runtime->segment.offset);
+
+	/* Sealed segment never gets new entries - anything after its last entry (e.g. discarded by recovery) is
+	 * never valid. Seal is persisted before the link, iterators rely on it when following the chain. */
+	atomic_store_relaxed(&span_region->max_valid_timestamp, max_timestamp);
+	region_runtime->data->persist(&span_region->max_valid_timestamp, sizeof(span_region->max_valid_timestamp));
+
+	/* Data of the new segment starts with an empty span (cleared by the allocator). */
+	uint64_t chain = segment.offset | (span_region->chain & SPAN_REGION_CHAIN_FLAGS_MASK);
+	atomic_store_release(&span_region->chain, chain);
+	region_runtime->data->persist(&span_region->chain, sizeof(span_region->chain));
+
+	region_runtime->segment = segment;
+	atomic_store_release(&region_runtime->append_offset, region_first_entry_offset(segment));
+}
+
+static int store_tail_hint_cb(uintptr_t key, void *value, void *privdata)
+{
+	struct pmemstream_region_runtime *region_runtime = (struct pmemstream_region_runtime *)value;
+	uint64_t timestamp = *(const uint64_t *)privdata;
+
+	uint64_t pending_entries;
+	atomic_load_relaxed(&region_runtime->pending_entries, &pending_entries);
+	if (region_runtime_get_state_acquire(region_runtime) != REGION_RUNTIME_STATE_WRITE_READY ||
+	    pending_entries != 0) {
+		/* Tail is unknown (or not stable) - region will be iterated at next open. */
+		return 0;
+	}
+
+	struct span_region *span_region =
+		(struct span_region *)span_offset_to_span_ptr(region_runtime->data, region_runtime->region.offset);
+	span_region->tail_timestamp_hint = timestamp;
+	span_region->tail_offset_hint = region_runtime_get_append_offset_relaxed(region_runtime);
+	region_runtime->data->flush(&span_region->tail_offset_hint, 2 * sizeof(uint64_t));
+
+	return 0;
+}
+
+void region_runtimes_map_store_tail_hints(struct region_runtimes_map *map, uint64_t timestamp)
+{
+	critnib_iter(map->container, 0, UINT64_MAX, store_tail_hint_cb, &timestamp);
+}
+
+bool region_runtime_is_active_acquire(const struct pmemstream_region_runtime *region_runtime)
+{
+	bool active;
+	atomic_load_acquire(&region_runtime->active, &active);
+	return active;
+}
+
+void region_runtime_set_active_release(struct pmemstream_region_runtime *region_runtime)
+{
+	atomic_store_release(&region_runtime->active, true);
+}
+
+uint64_t region_data_end_offset(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	return region.offset + span_get_total_size(&span_region->span_base) - span_region_markers_size(span_region) -
+		region_ring_size(span_region);
+}
+
+static struct span_region_block_marker *region_markers(const struct pmemstream_runtime *data,
+							struct pmemstream_region region)
+{
+	return (struct span_region_block_marker *)pmemstream_offset_to_ptr(data, region_data_end_offset(data, region));
+}
+
+int region_markers_validate(size_t size, size_t block_size)
+{
+	if (block_size == 0 || block_size % sizeof(struct span_entry) != 0) {
+		return -1;
+	}
+
+	struct span_region span_region = {.span_base = span_base_create(size, SPAN_REGION),
+					  .marker_block_size = block_size};
+	if (offsetof(struct span_region, data) + span_region_markers_size(&span_region) + sizeof(struct span_entry) >
+	    span_get_total_size(&span_region.span_base)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+void region_markers_update(const struct pmemstream_runtime *data, struct pmemstream_region region,
+			   uint64_t entry_offset, size_t entry_total_size, uint64_t timestamp)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	uint64_t block_size = span_region->marker_block_size;
+	if (block_size == 0) {
+		return;
+	}
+
+	/* Entry ends at the first entry boundary of each block which starts in (entry_offset, entry_end]. */
+	uint64_t first_entry_offset = region_first_entry_offset(region);
+	size_t first_block = (entry_offset - first_entry_offset) / block_size + 1;
+	size_t last_block = (entry_offset + entry_total_size - first_entry_offset) / block_size;
+	size_t markers_count = span_region_markers_count(span_region);
+	if (last_block >= markers_count) {
+		last_block = markers_count - 1;
+	}
+	if (first_block > last_block) {
+		return;
+	}
+
+	/* Timestamp is stored last, marker with a torn offset is rejected by region_marker_is_valid. */
+	struct span_region_block_marker *markers = region_markers(data, region);
+	for (size_t block = first_block; block <= last_block; block++) {
+		atomic_store_relaxed(&markers[block].entry_offset, entry_offset);
+		atomic_store_relaxed(&markers[block].timestamp, timestamp);
+	}
+
+	/* Markers are drained together with the entry, when it is persisted. */
+	data->flush(&markers[first_block], (last_block - first_block + 1) * sizeof(struct span_region_block_marker));
+}
+
+/* Checks if marker of 'block' points to a valid entry. Such entry (and all entries before it) can be safely
+ * skipped by the recovery. */
+static bool region_marker_is_valid(const struct pmemstream_runtime *data, struct pmemstream_region region,
+				   size_t block, uint64_t max_valid_timestamp)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	const struct span_region_block_marker *marker = &region_markers(data, region)[block];
+
+	uint64_t timestamp;
+	uint64_t entry_offset;
+	atomic_load_relaxed(&marker->timestamp, &timestamp);
+	atomic_load_relaxed(&marker->entry_offset, &entry_offset);
+
+	if (timestamp == PMEMSTREAM_INVALID_TIMESTAMP || timestamp > max_valid_timestamp) {
+		return false;
+	}
+
+	uint64_t block_offset = region_first_entry_offset(region) + block * span_region->marker_block_size;
+	uint64_t data_end_offset = region_data_end_offset(data, region);
+	if (entry_offset < region_first_entry_offset(region) || entry_offset >= block_offset ||
+	    entry_offset + sizeof(struct span_entry) > data_end_offset) {
+		return false;
+	}
+
+	/* Marker might be left over from entries discarded by previous recovery - verify it against the entry. */
+	const struct span_entry *span_entry = (const struct span_entry *)span_offset_to_span_ptr(data, entry_offset);
+	struct span_timestamped_base span_timestamped =
+		span_timestamped_base_atomic_load(&span_entry->span_timestamped_base);
+	if (span_get_type(&span_timestamped.span_base) != SPAN_ENTRY || span_timestamped.timestamp != timestamp) {
+		return false;
+	}
+
+	uint64_t entry_end_offset = entry_offset + span_get_total_size(&span_timestamped.span_base);
+	return entry_end_offset >= block_offset && entry_end_offset <= data_end_offset;
+}
+
+/* Returns offset from which region has to be iterated to find its tail. For regions with block markers, this is
+ * the end of the entry pointed by the last valid marker (found by binary search). */
+static uint64_t region_recovery_start_offset(struct pmemstream *stream, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(&stream->data, region.offset);
+	size_t markers_count = span_region_markers_count(span_region);
+	if (markers_count == 0) {
+		return region_head_offset(&stream->data, region);
+	}
+
+	uint64_t max_valid_timestamp;
+	atomic_load_relaxed(&span_region->max_valid_timestamp, &max_valid_timestamp);
+	uint64_t committed_timestamp = pmemstream_committed_timestamp(stream);
+	if (committed_timestamp < max_valid_timestamp) {
+		max_valid_timestamp = committed_timestamp;
+	}
+
+	/* Markers are set in order of appends, find the last valid one. Block 0 has no marker - it always starts
+	 * with the first entry. */
+	size_t valid_block = 0;
+	size_t low = 1;
+	size_t high = markers_count;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (region_marker_is_valid(&stream->data, region, mid, max_valid_timestamp)) {
+			valid_block = mid;
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	if (valid_block == 0) {
+		return region_first_entry_offset(region);
+	}
+
+	const struct span_region_block_marker *marker = &region_markers(&stream->data, region)[valid_block];
+	return marker->entry_offset;
+}
+
+static bool region_has_markers(const struct pmemstream_runtime *data, struct pmemstream_region region)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	return span_region->marker_block_size != 0;
+}
+
+/* Clears markers which were set by entries discarded by the recovery (they are placed right after the tail). */
+static void region_markers_clear_after(const struct pmemstream_runtime *data, struct pmemstream_region region,
+				       uint64_t tail_offset)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	size_t markers_count = span_region_markers_count(span_region);
+	if (markers_count == 0) {
+		return;
+	}
+
+	struct span_region_block_marker *markers = region_markers(data, region);
+	size_t block = (tail_offset - region_first_entry_offset(region)) / span_region->marker_block_size + 1;
+	size_t first_block = block;
+	for (; block < markers_count && markers[block].timestamp != PMEMSTREAM_INVALID_TIMESTAMP; block++) {
+		atomic_store_relaxed(&markers[block].timestamp, PMEMSTREAM_INVALID_TIMESTAMP);
+	}
+
+	if (block > first_block) {
+		data->persist(&markers[first_block], (block - first_block) * sizeof(struct span_region_block_marker));
+	}
 }
 
 static void region_runtime_initialize_for_write_no_lock(struct pmemstream_region_runtime *region_runtime,
-							uint64_t tail_offset)
+							struct pmemstream_region segment, uint64_t tail_offset)
 {
 	/* invariant, region_initialization should always happen under a lock. */
 	assert(pthread_mutex_trylock(&region_runtime->region_lock) != 0);
 	assert(region_runtime);
 	assert(tail_offset != PMEMSTREAM_INVALID_OFFSET);
 
+	region_runtime->segment = segment;
 	region_runtime->append_offset = tail_offset;
+	region_runtime->head_offset = region_head_offset(region_runtime->data, region_runtime->region);
+
+	region_markers_clear_after(region_runtime->data, segment, tail_offset);
 
 	uint8_t *next_entry_dst = (uint8_t *)pmemstream_offset_to_ptr(region_runtime->data, tail_offset);
 
@@ -216,7 +747,7 @@ static void region_runtime_initialize_for_write_no_lock(struct pmemstream_region
 	region_runtime->data->persist(next_entry_dst, sizeof(struct span_base));
 
 	struct span_region *span_region =
-		(struct span_region *)span_offset_to_span_ptr(region_runtime->data, region_runtime->region.offset);
+		(struct span_region *)span_offset_to_span_ptr(region_runtime->data, segment.offset);
 	atomic_store_relaxed(&span_region->max_valid_timestamp, UINT64_MAX);
 	region_runtime->data->persist(&span_region->max_valid_timestamp, sizeof(span_region->max_valid_timestamp));
 
@@ -224,12 +755,12 @@ static void region_runtime_initialize_for_write_no_lock(struct pmemstream_region
 }
 
 static void region_runtime_initialize_for_write_locked(struct pmemstream_region_runtime *region_runtime,
-						       uint64_t offset)
+						       struct pmemstream_region segment, uint64_t offset)
 {
 	if (region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_READ_READY) {
 		pthread_mutex_lock(&region_runtime->region_lock);
 		if (region_runtime_get_state_acquire(region_runtime) == REGION_RUNTIME_STATE_READ_READY) {
-			region_runtime_initialize_for_write_no_lock(region_runtime, offset);
+			region_runtime_initialize_for_write_no_lock(region_runtime, segment, offset);
 		}
 		pthread_mutex_unlock(&region_runtime->region_lock);
 	}
@@ -243,29 +774,193 @@ uint64_t region_first_entry_offset(struct pmemstream_region region)
 	return region.offset + offsetof(struct span_region, data);
 }
 
-static int region_runtime_iterate_and_initialize_for_write_no_lock(struct pmemstream *stream,
-								   struct pmemstream_region region,
-								   struct pmemstream_region_runtime *region_runtime)
+/* Allocates the index. Must be called under index_lock. */
+static int region_runtime_index_create_no_lock(struct pmemstream_region_runtime *region_runtime)
 {
-	/* invariant, region_initialization should always happen under a lock. */
-	assert(pthread_mutex_trylock(&region_runtime->region_lock) != 0);
+	size_t region_data_size = region_data_end_offset(region_runtime->data, region_runtime->region) -
+		region_first_entry_offset(region_runtime->region);
+	size_t chunks_count = ALIGN_UP(region_data_size, REGION_INDEX_CHUNK_SIZE) / REGION_INDEX_CHUNK_SIZE;
+
+	uint64_t *chunks = malloc((chunks_count ? chunks_count : 1) * sizeof(*chunks));
+	if (!chunks) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < chunks_count; i++) {
+		chunks[i] = PMEMSTREAM_INVALID_OFFSET;
+	}
+
+	region_runtime->index_chunks = chunks;
+	region_runtime->index_chunks_count = chunks_count;
+	return 0;
+}
+
+/* Adds all valid entries, which are not yet indexed, to the index. Must be called under index_lock.
+ * Cost is proportional to the number of entries appended since the previous call. */
+static int region_runtime_index_extend_no_lock(struct pmemstream *stream,
+					       struct pmemstream_region_runtime *region_runtime)
+{
+	if (!region_runtime->index_chunks) {
+		int ret = region_runtime_index_create_no_lock(region_runtime);
+		if (ret) {
+			return ret;
+		}
+	}
 
 	struct pmemstream_entry_iterator iterator;
 
-	/* Do not attempt recovery inside iterator to avoid deadlocks on region_lock. */
-	int ret = entry_iterator_initialize(&iterator, stream, region, false);
+	/* Indexing is read-only, do not attempt recovery (it might be called from within recovery). */
+	int ret = entry_iterator_initialize(&iterator, stream, region_runtime->region, false);
 	if (ret) {
 		return ret;
 	}
 
-	iterator.offset = region_first_entry_offset(region);
+	uint64_t first_entry_offset = region_first_entry_offset(region_runtime->region);
+	iterator.offset = region_runtime->index_end_offset;
 	while (pmemstream_entry_iterator_is_valid(&iterator) == 0) {
+		size_t chunk = (iterator.offset - first_entry_offset) / REGION_INDEX_CHUNK_SIZE;
+		assert(chunk < region_runtime->index_chunks_count);
+		if (region_runtime->index_chunks[chunk] == PMEMSTREAM_INVALID_OFFSET) {
+			region_runtime->index_chunks[chunk] = iterator.offset;
+		}
+		region_runtime->index_last_entry_offset = iterator.offset;
+
+		uint64_t offset = iterator.offset;
 		pmemstream_entry_iterator_next(&iterator);
+		if (iterator.offset == offset) {
+			/* Iterator cannot be advanced - this should not happen unless the stream was corrupted. */
+			break;
+		}
+	}
+
+	region_runtime->index_end_offset = iterator.offset;
+	return 0;
+}
+
+/* Returns region's tail stored on clean shutdown or PMEMSTREAM_INVALID_OFFSET if it cannot be used. Tail must be
+ * inside the region's last 'segment'. */
+static uint64_t region_tail_hint(struct pmemstream *stream, struct pmemstream_region region,
+				 struct pmemstream_region segment)
+{
+	if (!stream->use_tail_hints) {
+		return PMEMSTREAM_INVALID_OFFSET;
+	}
+
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(&stream->data, region.offset);
+	uint64_t tail_offset = span_region->tail_offset_hint;
+	if (tail_offset < region_first_entry_offset(segment) ||
+	    tail_offset > region_data_end_offset(&stream->data, segment) ||
+	    span_region->tail_timestamp_hint > stream->header->persisted_timestamp) {
+		return PMEMSTREAM_INVALID_OFFSET;
+	}
+
+	return tail_offset;
+}
+
+static int region_runtime_iterate_and_initialize_for_write_no_lock(struct pmemstream *stream,
+								   struct pmemstream_region region,
+								   struct pmemstream_region_runtime *region_runtime)
+{
+	/* invariant, region_initialization should always happen under a lock. */
+	assert(pthread_mutex_trylock(&region_runtime->region_lock) != 0);
+
+	assert(region_runtime->region.offset == region.offset);
+
+	/* Only the last segment of a chained region might have been appended to. */
+	struct pmemstream_region segment = region_last_segment(&stream->data, region);
+
+	/* With the hint no entries are iterated, so the sparse index is not seeded - it is built on first use. */
+	uint64_t tail_offset = region_tail_hint(stream, region, segment);
+	if (tail_offset != PMEMSTREAM_INVALID_OFFSET) {
+		region_runtime_initialize_for_write_no_lock(region_runtime, segment, tail_offset);
+		return 0;
+	}
+
+	if (region_has_markers(&stream->data, region) || region_is_chained(&stream->data, region) ||
+	    region_is_ring(&stream->data, region)) {
+		/* Reverse iteration uses markers as well (and it is not supported for chained and ring regions), only
+		 * entries after the last valid marker of the last segment (or after the ring's head) are iterated. */
+		struct pmemstream_entry_iterator iterator;
+
+		/* Do not attempt recovery inside iterator to avoid deadlocks on region_lock. */
+		int ret = entry_iterator_initialize(&iterator, stream, region, false);
+		if (ret) {
+			return ret;
+		}
+
+		iterator.segment = segment;
+		iterator.offset = region_recovery_start_offset(stream, segment);
+		while (pmemstream_entry_iterator_is_valid(&iterator) == 0) {
+			pmemstream_entry_iterator_next(&iterator);
+		}
+		tail_offset = iterator.offset;
+	} else {
+		/* Looking for the tail requires iterating over all entries anyway, so index them on the way -
+		 * reverse iteration can then start from the tail without scanning the region again. Entries which
+		 * were already indexed (e.g. by a read-only iterator) are skipped. */
+		pthread_mutex_lock(&region_runtime->index_lock);
+		int ret = region_runtime_index_extend_no_lock(stream, region_runtime);
+		tail_offset = region_runtime->index_end_offset;
+		pthread_mutex_unlock(&region_runtime->index_lock);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	region_runtime_initialize_for_write_no_lock(region_runtime, segment, tail_offset);
+
+	return 0;
+}
+
+/* Empties the index, so that it is rebuilt from the region's beginning. Must be called under index_lock. */
+static void region_runtime_index_reset_no_lock(struct pmemstream_region_runtime *region_runtime)
+{
+	for (size_t i = 0; i < region_runtime->index_chunks_count; i++) {
+		region_runtime->index_chunks[i] = PMEMSTREAM_INVALID_OFFSET;
+	}
+	region_runtime->index_end_offset = region_first_entry_offset(region_runtime->region);
+	region_runtime->index_last_entry_offset = PMEMSTREAM_INVALID_OFFSET;
+}
+
+int region_runtime_clear(struct pmemstream_region_runtime *region_runtime, struct pmemstream_region *segment)
+{
+	struct pmemstream_runtime *data = region_runtime->data;
+	struct pmemstream_region region = region_runtime->region;
+	uint64_t first_entry_offset = region_first_entry_offset(region);
+
+	pthread_mutex_lock(&region_runtime->region_lock);
+	if (region_runtime_has_pending_entries(region_runtime)) {
+		pthread_mutex_unlock(&region_runtime->region_lock);
+		return -1;
 	}
 
-	struct pmemstream_entry entry = pmemstream_entry_iterator_get(&iterator);
+	/* Segments are unlinked first - otherwise, iterators would follow the chain to their old entries. */
+	*segment = region_next_segment(data, region);
+	if (segment->offset != PMEMSTREAM_INVALID_OFFSET) {
+		struct span_region *span_region = (struct span_region *)span_offset_to_span_ptr(data, region.offset);
+		uint64_t chain = SPAN_REGION_CHAIN_NO_NEXT | (span_region->chain & SPAN_REGION_CHAIN_FLAGS_MASK);
+		atomic_store_release(&span_region->chain, chain);
+		data->persist(&span_region->chain, sizeof(span_region->chain));
+	}
+
+	/* Entries are discarded the same way as the ones found after the tail at recovery - region's data (and
+	 * markers) ends right at its beginning. */
+	region_runtime_initialize_for_write_no_lock(region_runtime, region, first_entry_offset);
+
+	/* Head is moved only once the first entry is cleared - data before the old head might be a stale one. */
+	if (region_is_ring(data, region)) {
+		struct span_region_ring *ring = region_ring(data, region);
+		atomic_store_release(&ring->head_offset, first_entry_offset);
+		data->persist(&ring->head_offset, sizeof(ring->head_offset));
+		atomic_store_release(&region_runtime->head_offset, first_entry_offset);
+	}
+
+	pthread_mutex_lock(&region_runtime->index_lock);
+	region_runtime_index_reset_no_lock(region_runtime);
+	pthread_mutex_unlock(&region_runtime->index_lock);
 
-	region_runtime_initialize_for_write_no_lock(region_runtime, entry.offset);
+	pthread_mutex_unlock(&region_runtime->region_lock);
 
 	return 0;
 }
@@ -291,14 +986,13 @@ int region_runtime_iterate_and_initialize_for_write_locked(struct pmemstream *st
 bool check_entry_consistency(const struct pmemstream_entry_iterator *iterator)
 {
 	const struct span_region *span_region =
-		(const struct span_region *)span_offset_to_span_ptr(&iterator->stream->data, iterator->region.offset);
-	uint64_t region_end_offset = iterator->region.offset + span_get_total_size(&span_region->span_base);
+		(const struct span_region *)span_offset_to_span_ptr(&iterator->stream->data, iterator->segment.offset);
+	uint64_t region_end_offset = region_data_end_offset(&iterator->stream->data, iterator->segment);
 
 	if (iterator->offset >= region_end_offset) {
 		return false;
 	}
 
-	/* XXX: max timestamp should be passed to iterator */
 	uint64_t committed_timestamp = pmemstream_committed_timestamp(iterator->stream);
 	uint64_t max_valid_timestamp;
 
@@ -308,6 +1002,8 @@ bool check_entry_consistency(const struct pmemstream_entry_iterator *iterator)
 
 	if (committed_timestamp < max_valid_timestamp)
 		max_valid_timestamp = committed_timestamp;
+	if (iterator->max_timestamp < max_valid_timestamp)
+		max_valid_timestamp = iterator->max_timestamp;
 
 	const struct span_entry *span_entry_ptr =
 		(const struct span_entry *)span_offset_to_span_ptr(&iterator->stream->data, iterator->offset);
@@ -329,11 +1025,215 @@ bool check_entry_consistency(const struct pmemstream_entry_iterator *iterator)
 	return false;
 }
 
+bool region_follow_chain(struct pmemstream_entry_iterator *iterator)
+{
+	const struct pmemstream_runtime *data = &iterator->stream->data;
+	while (true) {
+		struct pmemstream_region next = region_next_segment(data, iterator->segment);
+		if (next.offset == PMEMSTREAM_INVALID_OFFSET) {
+			return false;
+		}
+
+		/* Entries of the current segment which are not committed yet would be skipped. */
+		const struct span_region *span_region =
+			(const struct span_region *)span_offset_to_span_ptr(data, iterator->segment.offset);
+		uint64_t max_valid_timestamp;
+		atomic_load_relaxed(&span_region->max_valid_timestamp, &max_valid_timestamp);
+		if (pmemstream_committed_timestamp(iterator->stream) < max_valid_timestamp) {
+			return false;
+		}
+
+		iterator->segment = next;
+		iterator->offset = region_first_entry_offset(next);
+		iterator->prefetch_offset = 0;
+		if (check_entry_consistency(iterator)) {
+			return true;
+		}
+	}
+}
+
+bool region_follow_wrap(struct pmemstream_entry_iterator *iterator)
+{
+	const struct pmemstream_runtime *data = &iterator->stream->data;
+	if (!region_is_ring(data, iterator->region) ||
+	    iterator->offset + sizeof(struct span_empty) > region_data_end_offset(data, iterator->region)) {
+		return false;
+	}
+
+	const struct span_base *span_base = span_offset_to_span_ptr(data, iterator->offset);
+	struct span_base span;
+	atomic_load_acquire(&span_base->size_and_type, &span.size_and_type);
+	if (span_get_type(&span) != SPAN_EMPTY || span_get_size(&span) == 0) {
+		return false;
+	}
+
+	iterator->offset = region_first_entry_offset(iterator->region);
+	iterator->prefetch_offset = 0;
+	return check_entry_consistency(iterator);
+}
+
 bool check_entry_and_maybe_recover_region(struct pmemstream_entry_iterator *iterator)
 {
-	bool valid_entry = check_entry_consistency(iterator);
+	bool valid_entry =
+		check_entry_consistency(iterator) || region_follow_chain(iterator) || region_follow_wrap(iterator);
 	if (!valid_entry && iterator->perform_recovery) {
-		region_runtime_initialize_for_write_locked(iterator->region_runtime, iterator->offset);
+		region_runtime_initialize_for_write_locked(iterator->region_runtime, iterator->segment,
+							   iterator->offset);
 	}
 	return valid_entry;
 }
+
+/* Finds the last valid entry in a region with block markers - only entries after the last valid marker are
+ * scanned. */
+static int region_markers_find_last_entry(struct pmemstream *stream, struct pmemstream_region region,
+					  uint64_t *last_offset)
+{
+	struct pmemstream_entry_iterator iterator;
+	int ret = entry_iterator_initialize(&iterator, stream, region, false);
+	if (ret) {
+		return ret;
+	}
+
+	*last_offset = PMEMSTREAM_INVALID_OFFSET;
+	iterator.offset = region_recovery_start_offset(stream, region);
+	while (pmemstream_entry_iterator_is_valid(&iterator) == 0) {
+		*last_offset = iterator.offset;
+		pmemstream_entry_iterator_next(&iterator);
+		if (iterator.offset == *last_offset) {
+			/* Iterator cannot be advanced - this should not happen unless the stream was corrupted. */
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/* Finds the entry which directly precedes 'offset' in a region with block markers. The closest entry boundary
+ * before 'offset' is taken from markers of the block containing 'offset - 1' (or of the previous blocks, if no
+ * suitable boundary is there), so only entries from a single block are scanned. */
+static uint64_t region_markers_find_entry_before(const struct pmemstream_runtime *data,
+						 struct pmemstream_region region, uint64_t offset)
+{
+	const struct span_region *span_region =
+		(const struct span_region *)span_offset_to_span_ptr(data, region.offset);
+	const struct span_region_block_marker *markers = region_markers(data, region);
+	uint64_t first_entry_offset = region_first_entry_offset(region);
+
+	/* Block 0 has no marker - it always starts with the first entry. */
+	uint64_t entry_offset = first_entry_offset;
+	for (size_t block = (offset - 1 - first_entry_offset) / span_region->marker_block_size; block > 0; block--) {
+		/* All entries before 'offset' are valid, so is the marker if it points to an entry. */
+		if (!region_marker_is_valid(data, region, block, UINT64_MAX)) {
+			continue;
+		}
+
+		uint64_t marker_entry_offset;
+		atomic_load_relaxed(&markers[block].entry_offset, &marker_entry_offset);
+		uint64_t boundary =
+			marker_entry_offset + span_get_total_size(span_offset_to_span_ptr(data, marker_entry_offset));
+		if (boundary == offset) {
+			return marker_entry_offset;
+		} else if (boundary < offset) {
+			entry_offset = boundary;
+			break;
+		}
+	}
+
+	while (true) {
+		uint64_t next_offset = entry_offset + span_get_total_size(span_offset_to_span_ptr(data, entry_offset));
+		if (next_offset >= offset) {
+			break;
+		}
+		entry_offset = next_offset;
+	}
+
+	return entry_offset;
+}
+
+int region_runtime_find_last_entry(struct pmemstream *stream, struct pmemstream_region_runtime *region_runtime,
+				   uint64_t *last_offset)
+{
+	/* Index and markers cover a single segment of contiguous entries - chained and ring regions cannot be iterated
+	 * in reverse. */
+	if (region_is_chained(&stream->data, region_runtime->region) ||
+	    region_is_ring(&stream->data, region_runtime->region)) {
+		return -1;
+	}
+
+	if (region_has_markers(&stream->data, region_runtime->region)) {
+		return region_markers_find_last_entry(stream, region_runtime->region, last_offset);
+	}
+
+	pthread_mutex_lock(&region_runtime->index_lock);
+	int ret = region_runtime_index_extend_no_lock(stream, region_runtime);
+	if (ret == 0) {
+		*last_offset = region_runtime->index_last_entry_offset;
+	}
+	pthread_mutex_unlock(&region_runtime->index_lock);
+
+	return ret;
+}
+
+int region_runtime_find_entry_before(struct pmemstream *stream, struct pmemstream_region_runtime *region_runtime,
+				     uint64_t offset, uint64_t *prev_offset)
+{
+	if (region_is_chained(&stream->data, region_runtime->region) ||
+	    region_is_ring(&stream->data, region_runtime->region)) {
+		return -1;
+	}
+
+	uint64_t first_entry_offset = region_first_entry_offset(region_runtime->region);
+	if (offset <= first_entry_offset) {
+		*prev_offset = PMEMSTREAM_INVALID_OFFSET;
+		return 0;
+	}
+
+	if (region_has_markers(&stream->data, region_runtime->region)) {
+		*prev_offset = region_markers_find_entry_before(&stream->data, region_runtime->region, offset);
+		return 0;
+	}
+
+	pthread_mutex_lock(&region_runtime->index_lock);
+	if (offset > region_runtime->index_end_offset || !region_runtime->index_chunks) {
+		int ret = region_runtime_index_extend_no_lock(stream, region_runtime);
+		if (ret || offset > region_runtime->index_end_offset) {
+			pthread_mutex_unlock(&region_runtime->index_lock);
+			return -1;
+		}
+	}
+
+	/* Find the closest indexed entry which starts before 'offset' - the entry preceding 'offset'
+	 * starts either in the same chunk as 'offset - 1' or in one of the previous chunks. */
+	uint64_t entry_offset = PMEMSTREAM_INVALID_OFFSET;
+	size_t chunk = (offset - 1 - first_entry_offset) / REGION_INDEX_CHUNK_SIZE;
+	while (true) {
+		uint64_t chunk_offset = region_runtime->index_chunks[chunk];
+		if (chunk_offset != PMEMSTREAM_INVALID_OFFSET && chunk_offset < offset) {
+			entry_offset = chunk_offset;
+			break;
+		}
+		if (chunk == 0) {
+			break;
+		}
+		--chunk;
+	}
+	pthread_mutex_unlock(&region_runtime->index_lock);
+
+	if (entry_offset == PMEMSTREAM_INVALID_OFFSET) {
+		/* 'offset' does not point right after any of the indexed entries. */
+		return -1;
+	}
+
+	/* All entries in range [entry_offset, offset) are already indexed (valid), scan them forward. */
+	while (true) {
+		uint64_t next_offset =
+			entry_offset + span_get_total_size(span_offset_to_span_ptr(&stream->data, entry_offset));
+		if (next_offset >= offset) {
+			break;
+		}
+		entry_offset = next_offset;
+	}
+
+	*prev_offset = entry_offset;
+	return 0;
+}
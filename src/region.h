@@ -40,8 +40,83 @@ uint64_t region_runtime_get_append_offset_relaxed(const struct pmemstream_region
 /* Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
 uint64_t region_runtime_get_append_offset_acquire(const struct pmemstream_region_runtime *region_runtime);
 
+/* Reserves space for a single entry. Returns -1 if the region is being compacted.
+ * Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
+int region_runtime_increase_append_offset(struct pmemstream_region_runtime *region_runtime, uint64_t diff);
+
+/* Must be called once for each entry reserved by region_runtime_increase_append_offset, when it is published. */
+void region_runtime_entry_published(struct pmemstream_region_runtime *region_runtime);
+
+/* Returns true if there are entries which are reserved, but not yet published. */
+bool region_runtime_has_pending_entries(const struct pmemstream_region_runtime *region_runtime);
+
+/* Blocks reserving entries in the region, so that its entries do not change while they are copied by compaction.
+ * Returns -1 if there are entries which are reserved, but not yet published (or the region is already being
+ * compacted). Runtime is expected to be removed once the compaction is committed. */
+int region_runtime_compaction_begin(struct pmemstream_region_runtime *region_runtime);
+
+/* Allows reserving entries in the region again, after a failed compaction. */
+void region_runtime_compaction_abort(struct pmemstream_region_runtime *region_runtime);
+
+/* Returns segment to which entries are appended (see span_region.chain).
+ * Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
+struct pmemstream_region region_runtime_get_segment(const struct pmemstream_region_runtime *region_runtime);
+
+/* Seals the current (full) segment of a chained region and starts appending to a freshly allocated 'segment'.
+ * 'max_timestamp' must not be lower than timestamp of any entry in the current segment - all reserved entries have
+ * to be published first. Must not be called concurrently with reserving entries in the region. */
+void region_runtime_append_segment(struct pmemstream_region_runtime *region_runtime, struct pmemstream_region segment,
+				   uint64_t max_timestamp);
+
+/* Returns true if region grows by allocating new segments (true for all of its segments). */
+bool region_is_chained(const struct pmemstream_runtime *data, struct pmemstream_region region);
+
+/* Returns true if region is a segment of a chained region other than the first one. */
+bool region_is_continuation(const struct pmemstream_runtime *data, struct pmemstream_region region);
+
+/* Returns segment linked after 'region' (offset is PMEMSTREAM_INVALID_OFFSET if there is none). */
+struct pmemstream_region region_next_segment(const struct pmemstream_runtime *data, struct pmemstream_region region);
+
+/* Returns true if region is a ring region (see span_region_ring). */
+bool region_is_ring(const struct pmemstream_runtime *data, struct pmemstream_region region);
+
+/* Switches freshly allocated region, hidden with SPAN_REGION_CHAIN_CONTINUATION, to the ring layout and makes it
+ * visible. Returns -1 if the region is too small. */
+int region_ring_initialize(const struct pmemstream_runtime *data, struct pmemstream_region region);
+
+/* Returns offset from which entries of the region start - the head of a ring region, the first entry offset
+ * otherwise. */
+uint64_t region_head_offset(const struct pmemstream_runtime *data, struct pmemstream_region region);
+
 /* Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
-void region_runtime_increase_append_offset(struct pmemstream_region_runtime *region_runtime, uint64_t diff);
+uint64_t region_runtime_get_head_offset_acquire(const struct pmemstream_region_runtime *region_runtime);
+
+/* Persistently advances head of a ring region to 'entry_offset', which must point to a committed entry stored
+ * in the region (not trimmed yet). Returns -1 otherwise. Must not be called concurrently for the same region.
+ * Precondition: region_runtime_iterate_and_initialize_for_write_locked must have been called. */
+int region_runtime_trim(struct pmemstream *stream, struct pmemstream_region_runtime *region_runtime,
+			uint64_t entry_offset);
+
+/* Stores wrap marker at the append offset of a ring region and moves the append offset to the region's beginning.
+ * Space at the beginning must already be trimmed and all reserved entries have to be published. Must not be called
+ * concurrently with reserving entries in the region. */
+void region_runtime_wrap(struct pmemstream_region_runtime *region_runtime);
+
+/* Discards all entries of the region and makes it ready for appends from its beginning. Memory is not cleared, but
+ * persistently marked as the region's end. Segments of a chained region are unlinked - the first one of them is
+ * returned in 'segment' (offset is PMEMSTREAM_INVALID_OFFSET if there is none) and must be freed by the caller.
+ * Returns -1 if there are entries which are reserved, but not yet published. Must not be called concurrently with
+ * reserving entries in the region. */
+int region_runtime_clear(struct pmemstream_region_runtime *region_runtime, struct pmemstream_region *segment);
+
+/* Stores tail hints (see span_region) of all regions which are ready for write and have no pending entries.
+ * Hints are only flushed, caller is responsible for calling drain. */
+void region_runtimes_map_store_tail_hints(struct region_runtimes_map *map, uint64_t timestamp);
+
+/* Checks whether region was already added to the persistent set of active regions (see pmemstream_active_regions). */
+bool region_runtime_is_active_acquire(const struct pmemstream_region_runtime *region_runtime);
+
+void region_runtime_set_active_release(struct pmemstream_region_runtime *region_runtime);
 
 /*
  * Performs region recovery. This function iterates over entire region to find last entry and set append/committed
@@ -51,9 +126,42 @@ int region_runtime_iterate_and_initialize_for_write_locked(struct pmemstream *st
 
 bool check_entry_consistency(const struct pmemstream_entry_iterator *iterator);
 
+/* Moves iterator, which does not point to a valid entry, to the next segment(s) of a chained region - but only if
+ * all entries of the current segment are committed. Returns true if the iterator points to a valid entry afterwards. */
+bool region_follow_chain(struct pmemstream_entry_iterator *iterator);
+
+/* Moves iterator, which points to the wrap marker of a ring region, to the region's beginning. Returns true if
+ * the iterator points to a valid entry afterwards. */
+bool region_follow_wrap(struct pmemstream_entry_iterator *iterator);
+
 bool check_entry_and_maybe_recover_region(struct pmemstream_entry_iterator *iterator);
 
 uint64_t region_first_entry_offset(struct pmemstream_region region);
+
+/* Returns offset right after the space available for entries (block markers, if any, are stored after it). */
+uint64_t region_data_end_offset(const struct pmemstream_runtime *data, struct pmemstream_region region);
+
+/* Checks if region with 'size' bytes of data can be divided into blocks of 'block_size' bytes, each with a block
+ * marker (see span_region_block_marker). Returns -1 if markers do not fit in the region. */
+int region_markers_validate(size_t size, size_t block_size);
+
+/* Sets markers of all blocks in which the entry ends at the first entry boundary. Markers are only flushed,
+ * caller must persist the entry afterwards. */
+void region_markers_update(const struct pmemstream_runtime *data, struct pmemstream_region region,
+			   uint64_t entry_offset, size_t entry_total_size, uint64_t timestamp);
+
+/* Sets 'last_offset' to offset of the last valid entry in the region (or PMEMSTREAM_INVALID_OFFSET if the region
+ * is empty). Uses the region's sparse index (seeded during region recovery), so only entries appended since the
+ * previous lookup are scanned. For regions with block markers, only entries after the last valid marker are. */
+int region_runtime_find_last_entry(struct pmemstream *stream, struct pmemstream_region_runtime *region_runtime,
+				   uint64_t *last_offset);
+
+/* Sets 'prev_offset' to offset of the valid entry which directly precedes 'offset' (or PMEMSTREAM_INVALID_OFFSET
+ * if 'offset' points to the first entry). 'offset' must point to a valid entry or right after the last one.
+ * Only entries from a single index chunk (or a single block, for regions with block markers) are scanned. */
+int region_runtime_find_entry_before(struct pmemstream *stream, struct pmemstream_region_runtime *region_runtime,
+				     uint64_t offset, uint64_t *prev_offset);
+
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
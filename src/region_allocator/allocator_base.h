@@ -11,8 +11,36 @@
 extern "C" {
 #endif
 
+/* Free regions are kept in segregated lists - list 'i' holds regions with total size in range [2^i, 2^(i+1)). */
+#define ALLOCATOR_SIZE_CLASSES 64
+
+/* Operations modifying multiple regions, which are redone on recovery (see region_allocator.c). */
+enum allocator_operation {
+	ALLOCATOR_OPERATION_NONE = 0,
+	ALLOCATOR_OPERATION_SPLIT,
+	ALLOCATOR_OPERATION_MERGE,
+	ALLOCATOR_OPERATION_TRIM,
+	ALLOCATOR_OPERATION_ALLOCATE_MANY,
+	ALLOCATOR_OPERATION_FREE_MANY
+};
+
+/* Description of the operation in progress. Fields are persisted before 'operation' is set. */
+struct allocator_redo_log {
+	uint64_t operation;
+
+	/* Region being split, merged (the first one) or trimmed, and its total size before the operation.
+	 * Allocate many: free region which is divided into allocated regions. Free many: the first freed region. */
+	uint64_t offset;
+	uint64_t total_size;
+
+	/* Split: the remainder (0 size if there is none). Merge: the second region. Allocate many: total size of each
+	 * allocated region in 'other_total_size'. Free many: the last freed region in 'other_offset'. */
+	uint64_t other_offset;
+	uint64_t other_total_size;
+};
+
 struct allocator_header {
-	struct singly_linked_list free_list;
+	struct singly_linked_list free_lists[ALLOCATOR_SIZE_CLASSES];
 	struct singly_linked_list allocated_list;
 
 	/* Memory after this offset is not yet tracked by any list. */
@@ -23,6 +51,8 @@ struct allocator_header {
 	/* If != SLIST_INVALID_OFFSET it means there was a crash and it contains an offset of element which was being
 	 * freed. */
 	uint64_t recovery_free_offset;
+
+	struct allocator_redo_log redo_log;
 };
 
 struct allocator_entry_metadata {
@@ -36,16 +66,27 @@ static inline void allocator_initialize(const struct pmemstream_runtime *runtime
 	header->free_offset = 0;
 	header->size = size;
 	header->recovery_free_offset = SLIST_INVALID_OFFSET;
+	header->redo_log.operation = ALLOCATOR_OPERATION_NONE;
 
 	runtime->flush(&header->free_offset, sizeof(header->free_offset));
 	runtime->flush(&header->size, sizeof(header->size));
 	runtime->flush(&header->recovery_free_offset, sizeof(header->recovery_free_offset));
+	runtime->flush(&header->redo_log.operation, sizeof(header->redo_log.operation));
 	runtime->drain();
 
-	SLIST_INIT(runtime, &header->free_list);
+	for (size_t i = 0; i < ALLOCATOR_SIZE_CLASSES; i++) {
+		SLIST_INIT(runtime, &header->free_lists[i]);
+	}
 	SLIST_INIT(runtime, &header->allocated_list);
 }
 
+/* Returns index of the free list for region of 'total_size'. */
+static inline size_t allocator_size_class(uint64_t total_size)
+{
+	assert(total_size > 0);
+	return (size_t)(63 - __builtin_clzll(total_size));
+}
+
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
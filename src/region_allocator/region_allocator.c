@@ -4,12 +4,510 @@
 #include "region_allocator.h"
 #include "libpmemstream_internal.h"
 
-static void perform_free_list_extension(const struct pmemstream_runtime *runtime, struct allocator_header *header)
+/* Returns free list to which region of 'total_size' belongs. */
+static struct singly_linked_list *size_free_list(struct allocator_header *header, uint64_t total_size)
+{
+	return &header->free_lists[allocator_size_class(total_size)];
+}
+
+static uint64_t region_total_size(const struct pmemstream_runtime *runtime, uint64_t offset)
+{
+	return span_get_total_size(span_offset_to_span_ptr(runtime, offset));
+}
+
+/* Returns free list to which region at 'offset' belongs (based on its size). */
+static struct singly_linked_list *region_free_list(const struct pmemstream_runtime *runtime,
+						   struct allocator_header *header, uint64_t offset)
+{
+	return size_free_list(header, region_total_size(runtime, offset));
+}
+
+/* Adds region to the bucket of its size in the size index. Returns 0 on success, -1 on ENOMEM. */
+static int free_sizes_insert(struct allocator_runtime *allocator, uint64_t offset, uint64_t total_size)
+{
+	critnib *bucket = critnib_get(allocator->free_sizes, total_size);
+	if (!bucket) {
+		bucket = critnib_new();
+		if (!bucket) {
+			return -1;
+		}
+		if (critnib_insert(allocator->free_sizes, total_size, bucket, 0)) {
+			critnib_delete(bucket);
+			return -1;
+		}
+	}
+
+	if (critnib_insert(bucket, offset, (void *)total_size, 1)) {
+		return -1;
+	}
+	return 0;
+}
+
+static void free_sizes_remove(struct allocator_runtime *allocator, uint64_t offset, uint64_t total_size)
+{
+	critnib *bucket = critnib_get(allocator->free_sizes, total_size);
+	if (!bucket) {
+		return;
+	}
+
+	critnib_remove(bucket, offset);
+
+	uintptr_t key;
+	void *value;
+	if (!critnib_find(bucket, 0, FIND_GE, &key, &value)) {
+		critnib_remove(allocator->free_sizes, total_size);
+		critnib_delete(bucket);
+	}
+}
+
+static int free_sizes_delete_bucket(uintptr_t key, void *value, void *privdata)
+{
+	(void)key;
+	(void)privdata;
+	critnib_delete((critnib *)value);
+	return 0;
+}
+
+/* Returns the smallest free region with at least 'total_size' bytes (the one with the lowest offset if there are
+ * many of them) or SLIST_INVALID_OFFSET. */
+static uint64_t free_sizes_find(struct allocator_runtime *allocator, uint64_t total_size)
+{
+	uintptr_t size;
+	void *bucket;
+	if (!critnib_find(allocator->free_sizes, total_size, FIND_GE, &size, &bucket)) {
+		return SLIST_INVALID_OFFSET;
+	}
+
+	uintptr_t offset;
+	void *value;
+	if (!critnib_find((critnib *)bucket, 0, FIND_GE, &offset, &value)) {
+		return SLIST_INVALID_OFFSET;
+	}
+	return offset;
+}
+
+static void free_regions_remove(struct allocator_runtime *allocator, uint64_t offset)
+{
+	void *total_size = critnib_remove(allocator->free_regions, offset);
+	if (total_size) {
+		free_sizes_remove(allocator, offset, (uint64_t)total_size);
+	}
+}
+
+/* Inserts (or updates size of) free region. Region is added to the size index only if it is also known to
+ * free_regions, so that it can always be removed from both maps at once. */
+static void free_regions_insert(struct allocator_runtime *allocator, uint64_t offset, uint64_t total_size)
+{
+	free_regions_remove(allocator, offset);
+
+	/* Failure only means that the region will not be merged with its neighbours (nor reused before reopen). */
+	if (critnib_insert(allocator->free_regions, offset, (void *)total_size, 0)) {
+		return;
+	}
+	if (free_sizes_insert(allocator, offset, total_size)) {
+		free_sizes_remove(allocator, offset, total_size);
+	}
+}
+
+static void free_prev_set(struct allocator_runtime *allocator, uint64_t offset, uint64_t prev)
+{
+	/* On failure the stale entry is removed - predecessor will be found by walking the list. */
+	if (critnib_insert(allocator->free_prev, offset, (void *)prev, 1)) {
+		critnib_remove(allocator->free_prev, offset);
+	}
+}
+
+/* Returns predecessor of the region on its free list, if it is known and still valid. */
+static bool free_prev_get(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			  struct singly_linked_list *free_list, uint64_t offset, uint64_t *prev)
+{
+	uintptr_t key;
+	void *value;
+	if (!critnib_find(allocator->free_prev, offset, FIND_EQ, &key, &value)) {
+		return false;
+	}
+
+	*prev = (uint64_t)value;
+	if (*prev == SLIST_INVALID_OFFSET) {
+		return free_list->head == offset;
+	}
+	return SLIST_NEXT(struct span_region, runtime, *prev, allocator_entry_metadata.next_free) == offset;
+}
+
+static void allocated_prev_set(struct allocator_runtime *allocator, uint64_t offset, uint64_t prev)
+{
+	/* On failure the stale entry is removed - predecessor will be found by walking the list. */
+	if (critnib_insert(allocator->allocated_prev, offset, (void *)prev, 1)) {
+		critnib_remove(allocator->allocated_prev, offset);
+	}
+}
+
+/* Returns predecessor of the region on the allocated list, if it is known and still valid. */
+static bool allocated_prev_get(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			       struct allocator_header *header, uint64_t offset, uint64_t *prev)
+{
+	uintptr_t key;
+	void *value;
+	if (!critnib_find(allocator->allocated_prev, offset, FIND_EQ, &key, &value)) {
+		return false;
+	}
+
+	*prev = (uint64_t)value;
+	if (*prev == SLIST_INVALID_OFFSET) {
+		return header->allocated_list.head == offset;
+	}
+	return SLIST_NEXT(struct span_region, runtime, *prev, allocator_entry_metadata.next_allocated) == offset;
+}
+
+/* Removes region from the allocated list. Predecessor is taken from the DRAM map, the list is walked only if the map
+ * does not reflect the list (e.g. region has already been removed before a crash). */
+static void allocated_list_remove(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				  struct allocator_header *header, uint64_t offset)
+{
+	uint64_t next = SLIST_NEXT(struct span_region, runtime, offset, allocator_entry_metadata.next_allocated);
+	uint64_t prev;
+	bool prev_valid = allocated_prev_get(allocator, runtime, header, offset, &prev);
+
+	critnib_remove(allocator->allocated_prev, offset);
+	if (prev_valid) {
+		SLIST_REMOVE_AFTER(struct span_region, runtime, &header->allocated_list, prev, offset,
+				   allocator_entry_metadata.next_allocated);
+	} else {
+		SLIST_REMOVE(struct span_region, runtime, &header->allocated_list, offset,
+			     allocator_entry_metadata.next_allocated);
+	}
+
+	if (next == SLIST_INVALID_OFFSET) {
+		return;
+	}
+	if (prev_valid) {
+		allocated_prev_set(allocator, next, prev);
+	} else {
+		/* Predecessor is unknown - next removal of 'next' will walk the list. */
+		critnib_remove(allocator->allocated_prev, next);
+	}
+}
+
+static bool free_list_contains(const struct pmemstream_runtime *runtime, struct singly_linked_list *free_list,
+			       uint64_t offset)
+{
+	uint64_t it;
+	SLIST_FOREACH(struct span_region, runtime, free_list, it, allocator_entry_metadata.next_free)
+	{
+		if (it == offset) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* On recovery, region might have already been inserted before the crash. */
+static void free_list_insert(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			     struct singly_linked_list *free_list, uint64_t offset, bool recovery)
+{
+	if (recovery && free_list_contains(runtime, free_list, offset)) {
+		return;
+	}
+
+	uint64_t next = free_list->head;
+	SLIST_INSERT_HEAD(struct span_region, runtime, free_list, offset, allocator_entry_metadata.next_free);
+
+	free_prev_set(allocator, offset, SLIST_INVALID_OFFSET);
+	if (next != SLIST_INVALID_OFFSET) {
+		free_prev_set(allocator, next, offset);
+	}
+}
+
+/* Removes region from its free list. Predecessor is taken from the DRAM map, the list is walked only if the map does
+ * not reflect the list. Does nothing if the region is not on the list (it might have been removed before the crash). */
+static void free_list_remove(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			     struct singly_linked_list *free_list, uint64_t offset)
+{
+	uint64_t next = SLIST_NEXT(struct span_region, runtime, offset, allocator_entry_metadata.next_free);
+	uint64_t prev;
+	bool prev_valid = free_prev_get(allocator, runtime, free_list, offset, &prev);
+
+	critnib_remove(allocator->free_prev, offset);
+	if (prev_valid) {
+		SLIST_REMOVE_AFTER(struct span_region, runtime, free_list, prev, offset,
+				   allocator_entry_metadata.next_free);
+	} else {
+		SLIST_REMOVE(struct span_region, runtime, free_list, offset, allocator_entry_metadata.next_free);
+	}
+
+	if (next == SLIST_INVALID_OFFSET) {
+		return;
+	}
+	if (prev_valid) {
+		free_prev_set(allocator, next, prev);
+	} else {
+		/* Predecessor is unknown - next removal of 'next' will walk the list. */
+		critnib_remove(allocator->free_prev, next);
+	}
+}
+
+static void region_set_total_size(const struct pmemstream_runtime *runtime, uint64_t offset, uint64_t total_size)
+{
+	struct span_base *span = (struct span_base *)span_offset_to_span_ptr(runtime, offset);
+	span_base_atomic_store(span, span_base_create(total_size - sizeof(struct span_region), SPAN_REGION));
+	runtime->persist(span, sizeof(*span));
+}
+
+static void redo_log_begin(const struct pmemstream_runtime *runtime, struct allocator_header *header,
+			   enum allocator_operation operation, uint64_t offset, uint64_t total_size,
+			   uint64_t other_offset, uint64_t other_total_size)
+{
+	struct allocator_redo_log *log = &header->redo_log;
+	assert(log->operation == ALLOCATOR_OPERATION_NONE);
+
+	log->offset = offset;
+	log->total_size = total_size;
+	log->other_offset = other_offset;
+	log->other_total_size = other_total_size;
+	runtime->persist(&log->offset, 4 * sizeof(uint64_t));
+
+	log->operation = operation;
+	runtime->persist(&log->operation, sizeof(log->operation));
+}
+
+static void redo_log_end(const struct pmemstream_runtime *runtime, struct allocator_header *header)
+{
+	header->redo_log.operation = ALLOCATOR_OPERATION_NONE;
+	runtime->persist(&header->redo_log.operation, sizeof(header->redo_log.operation));
+}
+
+/*
+ * Operations on free regions described by the redo log. Each step of such operation can be safely repeated, so after
+ * a crash the whole operation is simply performed again (with 'recovery' set). Sizes (and so free lists) of regions
+ * are always taken from the log, as regions' headers might have already been modified.
+ */
+
+/* Splits free region (of the log's total_size) into a region of (total_size - other_total_size) bytes and the
+ * remainder at other_offset. Both end up on free lists, the first one at the head of its list. */
+static void redo_free_region_split(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				   struct allocator_header *header, bool recovery)
+{
+	const struct allocator_redo_log *log = &header->redo_log;
+	uint64_t total_size = log->total_size - log->other_total_size;
+
+	free_list_remove(allocator, runtime, size_free_list(header, log->total_size), log->offset);
+	if (log->other_total_size) {
+		region_set_total_size(runtime, log->other_offset, log->other_total_size);
+		region_set_total_size(runtime, log->offset, total_size);
+		free_list_insert(allocator, runtime, size_free_list(header, log->other_total_size), log->other_offset,
+				 recovery);
+	}
+	free_list_insert(allocator, runtime, size_free_list(header, total_size), log->offset, recovery);
+}
+
+/* Merges two physically adjacent free regions into the first one. */
+static void redo_free_regions_merge(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				    struct allocator_header *header, bool recovery)
+{
+	const struct allocator_redo_log *log = &header->redo_log;
+	uint64_t total_size = log->total_size + log->other_total_size;
+
+	free_list_remove(allocator, runtime, size_free_list(header, log->total_size), log->offset);
+	free_list_remove(allocator, runtime, size_free_list(header, log->other_total_size), log->other_offset);
+	region_set_total_size(runtime, log->offset, total_size);
+	free_list_insert(allocator, runtime, size_free_list(header, total_size), log->offset, recovery);
+}
+
+/* Gives free region which ends at free_offset back to the untracked memory. */
+static void redo_free_region_trim(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				  struct allocator_header *header)
+{
+	const struct allocator_redo_log *log = &header->redo_log;
+
+	free_list_remove(allocator, runtime, size_free_list(header, log->total_size), log->offset);
+	header->free_offset = log->offset;
+	runtime->persist(&header->free_offset, sizeof(header->free_offset));
+}
+
+static void perform_free_region_split(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				      struct allocator_header *header, uint64_t offset, uint64_t total_size,
+				      uint64_t new_total_size)
+{
+	uint64_t remainder_offset = offset + new_total_size;
+	uint64_t remainder_total_size = total_size - new_total_size;
+
+	redo_log_begin(runtime, header, ALLOCATOR_OPERATION_SPLIT, offset, total_size, remainder_offset,
+		       remainder_total_size);
+	redo_free_region_split(allocator, runtime, header, false);
+	redo_log_end(runtime, header);
+
+	free_regions_insert(allocator, offset, new_total_size);
+	if (remainder_total_size) {
+		free_regions_insert(allocator, remainder_offset, remainder_total_size);
+	}
+}
+
+static void perform_free_regions_merge(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				       struct allocator_header *header, uint64_t offset, uint64_t total_size,
+				       uint64_t next_offset, uint64_t next_total_size)
+{
+	assert(offset + total_size == next_offset);
+
+	redo_log_begin(runtime, header, ALLOCATOR_OPERATION_MERGE, offset, total_size, next_offset, next_total_size);
+	redo_free_regions_merge(allocator, runtime, header, false);
+	redo_log_end(runtime, header);
+
+	free_regions_remove(allocator, next_offset);
+	free_regions_insert(allocator, offset, total_size + next_total_size);
+}
+
+static void perform_free_region_trim(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				     struct allocator_header *header, uint64_t offset, uint64_t total_size)
+{
+	assert(offset + total_size == header->free_offset);
+
+	redo_log_begin(runtime, header, ALLOCATOR_OPERATION_TRIM, offset, total_size, SLIST_INVALID_OFFSET, 0);
+	redo_free_region_trim(allocator, runtime, header);
+	redo_log_end(runtime, header);
+
+	free_regions_remove(allocator, offset);
+}
+
+static bool allocated_list_contains(const struct pmemstream_runtime *runtime, struct allocator_header *header,
+				    uint64_t offset)
+{
+	uint64_t it;
+	SLIST_FOREACH(struct span_region, runtime, &header->allocated_list, it, allocator_entry_metadata.next_allocated)
+	{
+		if (it == offset) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Allocates regions of other_total_size bytes, laid out in free region of the log's total_size by
+ * regions_initialize: removes the free region from its free list, sets size of the first region (until now, its header
+ * was the header of the free region) and inserts all regions at the tail of the allocated list at once. */
+static void redo_regions_allocate(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				  struct allocator_header *header, bool recovery)
+{
+	const struct allocator_redo_log *log = &header->redo_log;
+	uint64_t count = log->total_size / log->other_total_size;
+	uint64_t last = log->offset + (count - 1) * log->other_total_size;
+	assert(count > 0);
+
+	free_list_remove(allocator, runtime, size_free_list(header, log->total_size), log->offset);
+	region_set_total_size(runtime, log->offset, count == 1 ? log->total_size : log->other_total_size);
+
+	/* After a crash, the regions might have already been inserted (tail is fixed by SLIST_RUNTIME_INIT). */
+	if (recovery && allocated_list_contains(runtime, header, log->offset)) {
+		return;
+	}
+
+	uint64_t prev = header->allocated_list.tail;
+	SLIST_INSERT_TAIL_CHAIN(struct span_region, runtime, &header->allocated_list, log->offset, last,
+				allocator_entry_metadata.next_allocated);
+	for (uint64_t offset = log->offset; offset <= last; offset += log->other_total_size) {
+		allocated_prev_set(allocator, offset, prev);
+		prev = offset;
+	}
+}
+
+/* Removes regions chained through next_free (from the log's offset to other_offset) from the allocated list and
+ * inserts the whole chain at the head of the free list for the log's total_size. */
+static void redo_regions_free(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			      struct allocator_header *header)
+{
+	const struct allocator_redo_log *log = &header->redo_log;
+	struct singly_linked_list *free_list = size_free_list(header, log->total_size);
+
+	uint64_t offset = log->offset;
+	while (true) {
+		uint64_t next = SLIST_NEXT(struct span_region, runtime, offset, allocator_entry_metadata.next_free);
+		allocated_list_remove(allocator, runtime, header, offset);
+		if (offset == log->other_offset) {
+			break;
+		}
+		offset = next;
+	}
+
+	/* Chain is inserted in one step, so the first region at the head means it is already done. */
+	if (free_list->head != log->offset) {
+		uint64_t next = free_list->head;
+		SLIST_INSERT_HEAD_CHAIN(struct span_region, runtime, free_list, log->offset, log->other_offset,
+					allocator_entry_metadata.next_free);
+		free_prev_set(allocator, log->offset, SLIST_INVALID_OFFSET);
+		if (next != SLIST_INVALID_OFFSET) {
+			free_prev_set(allocator, next, log->other_offset);
+		}
+	}
+
+	uint64_t prev = log->offset;
+	for (offset = SLIST_NEXT(struct span_region, runtime, log->offset, allocator_entry_metadata.next_free);
+	     prev != log->other_offset;
+	     offset = SLIST_NEXT(struct span_region, runtime, offset, allocator_entry_metadata.next_free)) {
+		free_prev_set(allocator, offset, prev);
+		prev = offset;
+	}
+}
+
+static void perform_regions_allocate(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				     struct allocator_header *header, uint64_t offset, uint64_t free_total_size,
+				     uint64_t total_size)
+{
+	redo_log_begin(runtime, header, ALLOCATOR_OPERATION_ALLOCATE_MANY, offset, free_total_size,
+		       SLIST_INVALID_OFFSET, total_size);
+	redo_regions_allocate(allocator, runtime, header, false);
+	redo_log_end(runtime, header);
+}
+
+/* All 'offsets' must belong to the same free list and be already chained (see regions_chain). */
+static void perform_regions_free(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				 struct allocator_header *header, const uint64_t *offsets, size_t count)
+{
+	uint64_t total_size = region_total_size(runtime, offsets[0]);
+
+	redo_log_begin(runtime, header, ALLOCATOR_OPERATION_FREE_MANY, offsets[0], total_size, offsets[count - 1], 0);
+	redo_regions_free(allocator, runtime, header);
+	redo_log_end(runtime, header);
+
+	for (size_t i = 0; i < count; i++) {
+		free_regions_insert(allocator, offsets[i], region_total_size(runtime, offsets[i]));
+	}
+}
+
+static void recover_redo_log(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			     struct allocator_header *header)
+{
+	switch (header->redo_log.operation) {
+		case ALLOCATOR_OPERATION_NONE:
+			return;
+		case ALLOCATOR_OPERATION_SPLIT:
+			redo_free_region_split(allocator, runtime, header, true);
+			break;
+		case ALLOCATOR_OPERATION_MERGE:
+			redo_free_regions_merge(allocator, runtime, header, true);
+			break;
+		case ALLOCATOR_OPERATION_TRIM:
+			redo_free_region_trim(allocator, runtime, header);
+			break;
+		case ALLOCATOR_OPERATION_ALLOCATE_MANY:
+			redo_regions_allocate(allocator, runtime, header, true);
+			break;
+		case ALLOCATOR_OPERATION_FREE_MANY:
+			redo_regions_free(allocator, runtime, header);
+			break;
+		default:
+			assert(false);
+			break;
+	}
+
+	redo_log_end(runtime, header);
+}
+
+static void perform_free_list_extension(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+					struct allocator_header *header)
 {
 	struct span_region *span = (struct span_region *)span_offset_to_span_ptr(runtime, header->free_offset);
+	struct singly_linked_list *free_list = region_free_list(runtime, header, header->free_offset);
 
-	SLIST_INSERT_HEAD(struct span_region, runtime, &header->free_list, header->free_offset,
-			  allocator_entry_metadata.next_free);
+	free_list_insert(allocator, runtime, free_list, header->free_offset, false);
 
 	header->free_offset += span_get_total_size(&span->span_base);
 	runtime->persist(&header->free_offset, sizeof(header->free_offset));
@@ -17,77 +515,132 @@ static void perform_free_list_extension(const struct pmemstream_runtime *runtime
 
 static void recover_free_list_extension(const struct pmemstream_runtime *runtime, struct allocator_header *header)
 {
-	if (header->free_list.head != SLIST_INVALID_OFFSET && header->free_list.head > header->free_offset) {
-		struct span_region *span =
-			(struct span_region *)span_offset_to_span_ptr(runtime, header->free_list.head);
+	/* The new region is inserted at the head of one of the free lists before free_offset is increased. */
+	for (size_t i = 0; i < ALLOCATOR_SIZE_CLASSES; i++) {
+		struct singly_linked_list *free_list = &header->free_lists[i];
+		if (free_list->head != SLIST_INVALID_OFFSET && free_list->head >= header->free_offset) {
+			struct span_region *span =
+				(struct span_region *)span_offset_to_span_ptr(runtime, free_list->head);
 
-		header->free_offset += span_get_total_size(&span->span_base);
-		runtime->persist(&header->free_offset, sizeof(header->free_offset));
+			header->free_offset = free_list->head + span_get_total_size(&span->span_base);
+			runtime->persist(&header->free_offset, sizeof(header->free_offset));
+			return;
+		}
 	}
 }
 
-static void perform_free_list_head_to_allocated_list_tail_move(const struct pmemstream_runtime *runtime,
-							       struct allocator_header *header)
+/* Sets whole layout of the region (including cleared block markers and the initial value of span_region.chain)
+ * before it becomes visible on the allocated list. Region is still on its free list (so it is not leaked on a crash),
+ * but it is already removed from the DRAM maps, so no other thread can allocate, merge nor trim it - this is done
+ * without holding the lock. Changes are only flushed - caller has to drain. */
+static void region_initialize(const struct pmemstream_runtime *runtime, uint64_t offset, uint64_t marker_block_size,
+			      uint64_t chain)
 {
-	uint64_t region_free = header->free_list.head;
+	struct span_region *span = (struct span_region *)span_offset_to_span_ptr(runtime, offset);
+	assert(span_get_type(&span->span_base) == SPAN_REGION);
 
-	struct span_base *span = (struct span_base *)span_offset_to_span_ptr(runtime, region_free);
-	assert(span_get_type(span) == SPAN_REGION);
+	span->max_valid_timestamp = UINT64_MAX;
+	span->marker_block_size = marker_block_size;
+	span->tail_offset_hint = UINT64_MAX;
+	span->tail_timestamp_hint = 0;
+	span->chain = chain;
+	size_t markers_size = span_region_markers_size(span);
+	if (markers_size) {
+		runtime->memset((uint8_t *)span + span_get_total_size(&span->span_base) - markers_size, 0, markers_size,
+				PMEM2_F_MEM_NONTEMPORAL | PMEM2_F_MEM_NODRAIN);
+	}
+	runtime->flush(&span->max_valid_timestamp, 5 * sizeof(uint64_t));
+	runtime->memset(span->data, 0, sizeof(struct span_entry), PMEM2_F_MEM_NONTEMPORAL | PMEM2_F_MEM_NODRAIN);
+}
 
-	((struct span_region *)span)->max_valid_timestamp = UINT64_MAX;
-	runtime->persist(&((struct span_region *)span)->max_valid_timestamp, sizeof(uint64_t));
-	runtime->memset(((struct span_region *)span)->data, 0, sizeof(struct span_entry), PMEM2_F_MEM_NONTEMPORAL);
+/* Lays out regions of 'total_size' bytes (the last one gets whatever is left) in the reserved free region at 'offset'
+ * and chains them through next_allocated. Like region_initialize, it is done without holding the lock. Header of the
+ * first region is still the header of the free region (which is on its free list), so its size is left intact - it
+ * is set by redo_regions_allocate. */
+static void regions_initialize(const struct pmemstream_runtime *runtime, uint64_t offset, uint64_t free_total_size,
+			       uint64_t total_size)
+{
+	uint64_t last = offset + (free_total_size / total_size - 1) * total_size;
+	for (uint64_t it = offset; it <= last; it += total_size) {
+		struct span_region *span_region = (struct span_region *)span_offset_to_span_ptr(runtime, it);
+		if (it != offset) {
+			uint64_t it_total_size = it == last ? offset + free_total_size - last : total_size;
+			span_base_atomic_store(&span_region->span_base,
+					       span_base_create(it_total_size - sizeof(*span_region), SPAN_REGION));
+		}
+		uint64_t next = it == last ? SLIST_INVALID_OFFSET : it + total_size;
+		span_region->allocator_entry_metadata.next_allocated = next;
+		runtime->flush(span_region, offsetof(struct span_region, allocator_entry_metadata.next_free));
+		region_initialize(runtime, it, 0, SPAN_REGION_CHAIN_NO_NEXT);
+	}
+	runtime->drain();
+}
 
-	SLIST_INSERT_TAIL(struct span_region, runtime, &header->allocated_list, region_free,
+static void perform_free_list_to_allocated_list_tail_move(struct allocator_runtime *allocator,
+							  const struct pmemstream_runtime *runtime,
+							  struct allocator_header *header, uint64_t offset)
+{
+	uint64_t prev = header->allocated_list.tail;
+	SLIST_INSERT_TAIL(struct span_region, runtime, &header->allocated_list, offset,
 			  allocator_entry_metadata.next_allocated);
-	SLIST_REMOVE_HEAD(struct span_region, runtime, &header->free_list, allocator_entry_metadata.next_free);
+	free_list_remove(allocator, runtime, region_free_list(runtime, header, offset), offset);
+
+	allocated_prev_set(allocator, offset, prev);
 }
 
-static void recover_free_list_head_to_allocated_list_tail_move(const struct pmemstream_runtime *runtime,
-							       struct allocator_header *header)
+static void recover_free_list_to_allocated_list_tail_move(const struct pmemstream_runtime *runtime,
+							  struct allocator_header *header)
 {
-	if (header->free_list.head != SLIST_INVALID_OFFSET && header->free_list.head == header->allocated_list.tail) {
-		/* Crash after insert - continue with removal */
-		SLIST_REMOVE_HEAD(struct span_region, runtime, &header->free_list, allocator_entry_metadata.next_free);
+	uint64_t tail = header->allocated_list.tail;
+	if (tail == SLIST_INVALID_OFFSET) {
+		return;
+	}
+
+	/* Crash after insert - continue with removal (region might be anywhere on its free list). */
+	struct singly_linked_list *free_list = region_free_list(runtime, header, tail);
+	if (free_list_contains(runtime, free_list, tail)) {
+		SLIST_REMOVE(struct span_region, runtime, free_list, tail, allocator_entry_metadata.next_free);
 	}
 }
 
-static void perform_allocated_list_to_free_list_move(const struct pmemstream_runtime *runtime,
+static void perform_allocated_list_to_free_list_move(struct allocator_runtime *allocator,
+						     const struct pmemstream_runtime *runtime,
 						     struct allocator_header *header, uint64_t offset)
 {
 	/* Store offset so we can redo the free on recovery */
 	header->recovery_free_offset = offset;
 	runtime->persist(&header->recovery_free_offset, sizeof(header->recovery_free_offset));
 
-	SLIST_INSERT_HEAD(struct span_region, runtime, &header->free_list, offset, allocator_entry_metadata.next_free);
-	SLIST_REMOVE(struct span_region, runtime, &header->allocated_list, offset,
-		     allocator_entry_metadata.next_allocated);
+	struct singly_linked_list *free_list = region_free_list(runtime, header, offset);
+	free_list_insert(allocator, runtime, free_list, offset, false);
+	allocated_list_remove(allocator, runtime, header, offset);
 
 	header->recovery_free_offset = SLIST_INVALID_OFFSET;
 	runtime->persist(&header->recovery_free_offset, sizeof(header->recovery_free_offset));
 }
 
-static void recover_allocated_list_to_free_list_move(const struct pmemstream_runtime *runtime,
+static void recover_allocated_list_to_free_list_move(struct allocator_runtime *allocator,
+						     const struct pmemstream_runtime *runtime,
 						     struct allocator_header *header)
 {
 	if (header->recovery_free_offset == SLIST_INVALID_OFFSET)
 		return;
 
-	if (header->free_list.head != header->recovery_free_offset) {
+	if (region_free_list(runtime, header, header->recovery_free_offset)->head != header->recovery_free_offset) {
 		/* Crash just after setting header->recovery_free_offset */
-		perform_allocated_list_to_free_list_move(runtime, header, header->recovery_free_offset);
+		perform_allocated_list_to_free_list_move(allocator, runtime, header, header->recovery_free_offset);
 	} else {
 		/* Crash after or before SLIST_REMOVE */
 
-		SLIST_REMOVE(struct span_region, runtime, &header->allocated_list, header->recovery_free_offset,
-			     allocator_entry_metadata.next_allocated);
+		allocated_list_remove(allocator, runtime, header, header->recovery_free_offset);
 
 		header->recovery_free_offset = SLIST_INVALID_OFFSET;
 		runtime->persist(&header->recovery_free_offset, sizeof(header->recovery_free_offset));
 	}
 }
 
-static int extend_free_list(const struct pmemstream_runtime *runtime, struct allocator_header *header, uint64_t size)
+static int extend_free_list(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			    struct allocator_header *header, uint64_t size)
 {
 	struct span_region span_region = {.span_base = span_base_create(size, SPAN_REGION),
 					  .allocator_entry_metadata = {.next_allocated = SLIST_INVALID_OFFSET,
@@ -101,44 +654,272 @@ static int extend_free_list(const struct pmemstream_runtime *runtime, struct all
 	*free_span = span_region;
 	runtime->persist(free_span, sizeof(*free_span));
 
-	perform_free_list_extension(runtime, header);
+	perform_free_list_extension(allocator, runtime, header);
 
 	return 0;
 }
 
-void allocator_runtime_initialize(const struct pmemstream_runtime *runtime, struct allocator_header *header)
+int allocator_runtime_initialize(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				 struct allocator_header *header)
 {
 	SLIST_RUNTIME_INIT(struct span_region, runtime, &header->allocated_list,
 			   allocator_entry_metadata.next_allocated);
-	SLIST_RUNTIME_INIT(struct span_region, runtime, &header->free_list, allocator_entry_metadata.next_free);
+	for (size_t i = 0; i < ALLOCATOR_SIZE_CLASSES; i++) {
+		SLIST_RUNTIME_INIT(struct span_region, runtime, &header->free_lists[i],
+				   allocator_entry_metadata.next_free);
+	}
+
+	allocator->free_regions = critnib_new();
+	if (!allocator->free_regions) {
+		goto err_free_regions;
+	}
+	allocator->free_sizes = critnib_new();
+	if (!allocator->free_sizes) {
+		goto err_free_sizes;
+	}
+	allocator->free_prev = critnib_new();
+	if (!allocator->free_prev) {
+		goto err_free_prev;
+	}
+	allocator->allocated_prev = critnib_new();
+	if (!allocator->allocated_prev) {
+		goto err_allocated_prev;
+	}
+	if (pthread_mutex_init(&allocator->lock, NULL)) {
+		goto err_lock;
+	}
+
+	/* Predecessors are known before recovery, so that an interrupted free can use them. */
+	uint64_t offset;
+	uint64_t prev = SLIST_INVALID_OFFSET;
+	SLIST_FOREACH(struct span_region, runtime, &header->allocated_list, offset,
+		      allocator_entry_metadata.next_allocated)
+	{
+		allocated_prev_set(allocator, offset, prev);
+		prev = offset;
+	}
 
 	recover_free_list_extension(runtime, header);
-	recover_free_list_head_to_allocated_list_tail_move(runtime, header);
-	recover_allocated_list_to_free_list_move(runtime, header);
+	recover_free_list_to_allocated_list_tail_move(runtime, header);
+	recover_allocated_list_to_free_list_move(allocator, runtime, header);
+	recover_redo_log(allocator, runtime, header);
+
+	for (size_t i = 0; i < ALLOCATOR_SIZE_CLASSES; i++) {
+		prev = SLIST_INVALID_OFFSET;
+		SLIST_FOREACH(struct span_region, runtime, &header->free_lists[i], offset,
+			      allocator_entry_metadata.next_free)
+		{
+			free_regions_insert(allocator, offset, region_total_size(runtime, offset));
+			free_prev_set(allocator, offset, prev);
+			prev = offset;
+		}
+	}
+
+	return 0;
+
+err_lock:
+	critnib_delete(allocator->allocated_prev);
+err_allocated_prev:
+	critnib_delete(allocator->free_prev);
+err_free_prev:
+	critnib_delete(allocator->free_sizes);
+err_free_sizes:
+	critnib_delete(allocator->free_regions);
+err_free_regions:
+	return -1;
 }
 
-uint64_t allocator_region_allocate(const struct pmemstream_runtime *runtime, struct allocator_header *header,
-				   size_t size)
+void allocator_runtime_destroy(struct allocator_runtime *allocator)
 {
-	uint64_t free_region = header->free_list.head;
+	critnib_iter(allocator->free_sizes, 0, UINTPTR_MAX, free_sizes_delete_bucket, NULL);
+	critnib_delete(allocator->free_sizes);
+	critnib_delete(allocator->free_regions);
+	critnib_delete(allocator->free_prev);
+	critnib_delete(allocator->allocated_prev);
+	pthread_mutex_destroy(&allocator->lock);
+}
 
+/* Finds a free region with at least 'size' bytes of data (or creates one, by extending tracked memory) and splits off
+ * the remainder. The region stays on its free list, but it is removed from the DRAM maps, so that no other thread
+ * allocates, merges nor trims it. Returns SLIST_INVALID_OFFSET if there is no space left. Must be called with the
+ * allocator's lock held. */
+static uint64_t reserve_free_region(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				    struct allocator_header *header, size_t size)
+{
+	struct span_base span_base = span_base_create(size, SPAN_REGION);
+	uint64_t total_size = span_get_total_size(&span_base);
+
+	uint64_t free_region = free_sizes_find(allocator, total_size);
 	if (free_region == SLIST_INVALID_OFFSET) {
-		int ret = extend_free_list(runtime, header, size);
+		int ret = extend_free_list(allocator, runtime, header, size);
 		if (ret != 0) {
-			return PMEMSTREAM_INVALID_OFFSET; // XXX: ENOMEM
+			return SLIST_INVALID_OFFSET;
+		}
+		free_region = size_free_list(header, total_size)->head;
+	} else {
+		/* Remainder is split only if it can hold a non-empty region. */
+		uint64_t free_total_size = region_total_size(runtime, free_region);
+		if (free_total_size - total_size > sizeof(struct span_region)) {
+			perform_free_region_split(allocator, runtime, header, free_region, free_total_size, total_size);
 		}
-		free_region = header->free_list.head;
+		free_regions_remove(allocator, free_region);
 	}
 
 	assert(span_get_type(span_offset_to_span_ptr(runtime, free_region)) == SPAN_REGION);
-	assert(span_get_size(span_offset_to_span_ptr(runtime, free_region)) == size);
+	assert(span_get_size(span_offset_to_span_ptr(runtime, free_region)) >= size);
+
+	return free_region;
+}
+
+uint64_t allocator_region_allocate(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				   struct allocator_header *header, size_t size, uint64_t marker_block_size,
+				   uint64_t chain)
+{
+	pthread_mutex_lock(&allocator->lock);
+	uint64_t free_region = reserve_free_region(allocator, runtime, header, size);
+	pthread_mutex_unlock(&allocator->lock);
+
+	if (free_region == SLIST_INVALID_OFFSET) {
+		return PMEMSTREAM_INVALID_OFFSET; // XXX: ENOMEM
+	}
+
+	region_initialize(runtime, free_region, marker_block_size, chain);
+	runtime->drain();
+
+	pthread_mutex_lock(&allocator->lock);
+	perform_free_list_to_allocated_list_tail_move(allocator, runtime, header, free_region);
+	pthread_mutex_unlock(&allocator->lock);
+
+	return free_region;
+}
+
+uint64_t allocator_regions_allocate(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				    struct allocator_header *header, size_t size, size_t count)
+{
+	struct span_base span_base = span_base_create(size, SPAN_REGION);
+	uint64_t total_size = span_get_total_size(&span_base);
+	assert(count > 0);
+
+	if (count > header->size / total_size) {
+		return PMEMSTREAM_INVALID_OFFSET;
+	}
+
+	/* All regions are carved out of a single free region. */
+	pthread_mutex_lock(&allocator->lock);
+	uint64_t free_region =
+		reserve_free_region(allocator, runtime, header, count * total_size - sizeof(struct span_region));
+	pthread_mutex_unlock(&allocator->lock);
+
+	if (free_region == SLIST_INVALID_OFFSET) {
+		return PMEMSTREAM_INVALID_OFFSET;
+	}
+
+	uint64_t free_total_size = region_total_size(runtime, free_region);
+	regions_initialize(runtime, free_region, free_total_size, total_size);
 
-	perform_free_list_head_to_allocated_list_tail_move(runtime, header);
+	pthread_mutex_lock(&allocator->lock);
+	perform_regions_allocate(allocator, runtime, header, free_region, free_total_size, total_size);
+	pthread_mutex_unlock(&allocator->lock);
 
 	return free_region;
 }
 
-void allocator_region_free(const struct pmemstream_runtime *runtime, struct allocator_header *header, uint64_t offset)
+/* Merges free region with its physically adjacent free neighbours. If it ends up at the end of tracked memory, it is
+ * given back to the untracked memory (free_offset is decreased). */
+static void coalesce_free_region(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				 struct allocator_header *header, uint64_t offset)
 {
-	perform_allocated_list_to_free_list_move(runtime, header, offset);
+	uint64_t total_size = region_total_size(runtime, offset);
+
+	uint64_t next_offset = offset + total_size;
+	void *next_total_size = next_offset < header->free_offset ? critnib_get(allocator->free_regions, next_offset)
+								  : NULL;
+	if (next_total_size) {
+		perform_free_regions_merge(allocator, runtime, header, offset, total_size, next_offset,
+					   (uint64_t)next_total_size);
+		total_size += (uint64_t)next_total_size;
+	}
+
+	uintptr_t prev_offset;
+	void *prev_total_size;
+	if (critnib_find(allocator->free_regions, offset, FIND_L, &prev_offset, &prev_total_size) &&
+	    prev_offset + (uint64_t)prev_total_size == offset) {
+		perform_free_regions_merge(allocator, runtime, header, prev_offset, (uint64_t)prev_total_size, offset,
+					   total_size);
+		offset = prev_offset;
+		total_size += (uint64_t)prev_total_size;
+	}
+
+	if (offset + total_size == header->free_offset) {
+		perform_free_region_trim(allocator, runtime, header, offset, total_size);
+	}
+}
+
+void allocator_region_free(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			   struct allocator_header *header, uint64_t offset)
+{
+	pthread_mutex_lock(&allocator->lock);
+
+	perform_allocated_list_to_free_list_move(allocator, runtime, header, offset);
+	free_regions_insert(allocator, offset, region_total_size(runtime, offset));
+
+	coalesce_free_region(allocator, runtime, header, offset);
+
+	pthread_mutex_unlock(&allocator->lock);
+}
+
+static size_t region_size_class(const struct pmemstream_runtime *runtime, uint64_t offset)
+{
+	return allocator_size_class(region_total_size(runtime, offset));
+}
+
+/* Moves regions which belong to the same free list as offsets[begin] right after it and chains them through next_free
+ * (which is not used by allocated regions). Returns end of the group. Changes are only flushed - caller has to drain.
+ */
+static size_t regions_chain(const struct pmemstream_runtime *runtime, uint64_t *offsets, size_t begin, size_t count)
+{
+	size_t size_class = region_size_class(runtime, offsets[begin]);
+	size_t end = begin + 1;
+	for (size_t i = end; i < count; i++) {
+		if (region_size_class(runtime, offsets[i]) == size_class) {
+			uint64_t tmp = offsets[end];
+			offsets[end++] = offsets[i];
+			offsets[i] = tmp;
+		}
+	}
+
+	for (size_t i = begin; i + 1 < end; i++) {
+		store_with_flush(runtime, &SLIST_NEXT(struct span_region, runtime, offsets[i],
+						      allocator_entry_metadata.next_free),
+				 offsets[i + 1]);
+	}
+	return end;
+}
+
+void allocator_regions_free(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			    struct allocator_header *header, uint64_t *offsets, size_t count)
+{
+	/* Regions are grouped by their free list (offsets are reordered in place) before the lock is taken. */
+	for (size_t begin = 0; begin < count;) {
+		begin = regions_chain(runtime, offsets, begin, count);
+	}
+	runtime->drain();
+
+	pthread_mutex_lock(&allocator->lock);
+
+	for (size_t begin = 0, end; begin < count; begin = end) {
+		size_t size_class = region_size_class(runtime, offsets[begin]);
+		for (end = begin + 1; end < count && region_size_class(runtime, offsets[end]) == size_class; end++) {
+		}
+		perform_regions_free(allocator, runtime, header, offsets + begin, end - begin);
+	}
+
+	/* Region might have already been merged into its freed neighbour. */
+	for (size_t i = 0; i < count; i++) {
+		if (critnib_get(allocator->free_regions, offsets[i])) {
+			coalesce_free_region(allocator, runtime, header, offsets[i]);
+		}
+	}
+
+	pthread_mutex_unlock(&allocator->lock);
 }
@@ -5,16 +5,64 @@
 #define LIBPMEMSTREAM_REGION_ALLOCATOR_H
 
 #include "allocator_base.h"
+#include "critnib/critnib.h"
+
+#include <pthread.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* Should be called on each application restart. */
-void allocator_runtime_initialize(const struct pmemstream_runtime *runtime, struct allocator_header *header);
-uint64_t allocator_region_allocate(const struct pmemstream_runtime *runtime, struct allocator_header *header,
-				   size_t size);
-void allocator_region_free(const struct pmemstream_runtime *runtime, struct allocator_header *header, uint64_t offset);
+/* DRAM state of the region allocator. */
+struct allocator_runtime {
+	/* Serializes modifications of persistent lists (and the maps below). Held only for O(1) list updates (walks
+	 * happen only if a DRAM map is incomplete) - initialization of allocated region's layout and all callers' work
+	 * (e.g. region runtimes' management) is done outside of it. */
+	pthread_mutex_t lock;
+
+	/* All free regions (offset -> total size), used for finding physically adjacent free regions. It is only an
+	 * optimization - if inserting fails (ENOMEM) the region will not be merged with its neighbours. */
+	critnib *free_regions;
+
+	/* The same free regions indexed by their total size (total size -> critnib of offsets), so that the smallest
+	 * fitting free region is found without walking the free lists. */
+	critnib *free_sizes;
+
+	/* Predecessors of free regions on their free lists (offset -> offset of previous region or SLIST_INVALID_OFFSET
+	 * for head), so that a region is removed from the middle of a list without walking it. Entries are verified
+	 * before use - if an entry is missing or stale, the list is walked. */
+	critnib *free_prev;
+
+	/* Predecessors of allocated regions on the allocated list (offset -> offset of previous region or
+	 * SLIST_INVALID_OFFSET for head), so that freeing a region does not walk the list. Entries are verified
+	 * before use - if an entry is missing or stale, the list is walked. */
+	critnib *allocated_prev;
+};
+
+/* Should be called on each application restart. Returns 0 on success, error code otherwise. */
+int allocator_runtime_initialize(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				 struct allocator_header *header);
+void allocator_runtime_destroy(struct allocator_runtime *allocator);
+
+/* Allocation and free functions are thread-safe. 'marker_block_size' is stored in
+ * span_region.marker_block_size of the allocated region (see span_region_block_marker) - markers are cleared before
+ * the region becomes visible. 'chain' is stored in span_region.chain. */
+uint64_t allocator_region_allocate(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				   struct allocator_header *header, size_t size, uint64_t marker_block_size,
+				   uint64_t chain);
+void allocator_region_free(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			   struct allocator_header *header, uint64_t offset);
+
+/* Allocates 'count' adjacent regions (without block markers) with 'size' bytes of data each (the last one might be
+ * slightly bigger) and returns offset of the first one. Regions are carved out of a single free region, with metadata
+ * of all of them persisted at once. Returns PMEMSTREAM_INVALID_OFFSET if there is no such free region - regions might
+ * still be allocated one by one. */
+uint64_t allocator_regions_allocate(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+				    struct allocator_header *header, size_t size, size_t count);
+
+/* Frees 'count' regions at once. Order of 'offsets' is not preserved. */
+void allocator_regions_free(struct allocator_runtime *allocator, const struct pmemstream_runtime *runtime,
+			    struct allocator_header *header, uint64_t *offsets, size_t count);
 
 #ifdef __cplusplus
 } /* end extern "C" */
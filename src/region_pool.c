@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+/* Pool of pre-initialized regions, refilled by a background worker. */
+
+#include "libpmemstream_internal.h"
+#include "region_allocator/region_allocator.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+struct pmemstream_region_pool {
+	struct pmemstream *stream;
+	pthread_t worker;
+
+	/* Protects all fields below. */
+	pthread_mutex_t lock;
+
+	/* Signalled when a region is taken from the pool (or an attempt is made) and when the worker has to stop. */
+	pthread_cond_t cond;
+
+	/* Size of data of each pooled region (as passed to the allocator). */
+	size_t size;
+
+	/* Offsets of ready regions, used as a stack. */
+	uint64_t *offsets;
+	size_t count;
+	size_t capacity;
+
+	/* Set if the allocator had no free space - allocation is retried after the next pop. */
+	bool allocator_full;
+
+	bool stop;
+};
+
+static void *region_pool_worker(void *arg)
+{
+	struct pmemstream_region_pool *pool = (struct pmemstream_region_pool *)arg;
+	struct pmemstream *stream = pool->stream;
+
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->stop) {
+		if (pool->count == pool->capacity || pool->allocator_full) {
+			pthread_cond_wait(&pool->cond, &pool->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&pool->lock);
+
+		/* Region is hidden (as a continuation) until it is taken from the pool - if the application crashes
+		 * before, it is freed at next open, as any orphaned segment. */
+		uint64_t offset = allocator_region_allocate(&stream->region_allocator, &stream->data,
+							    &stream->header->region_allocator_header, pool->size, 0,
+							    SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_CONTINUATION);
+		if (offset != PMEMSTREAM_INVALID_OFFSET) {
+			const struct span_base *span_region = span_offset_to_span_ptr(&stream->data, offset);
+			pmemstream_prefault_range((void *)span_region, span_get_total_size(span_region));
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		if (offset == PMEMSTREAM_INVALID_OFFSET) {
+			pool->allocator_full = true;
+		} else {
+			pool->offsets[pool->count++] = offset;
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+struct pmemstream_region_pool *pmemstream_region_pool_new(struct pmemstream *stream, size_t size, size_t capacity)
+{
+	assert(size > 0 && capacity > 0);
+
+	struct pmemstream_region_pool *pool = malloc(sizeof(*pool));
+	if (!pool) {
+		return NULL;
+	}
+
+	pool->stream = stream;
+	pool->size = size;
+	pool->count = 0;
+	pool->capacity = capacity;
+	pool->allocator_full = false;
+	pool->stop = false;
+
+	pool->offsets = malloc(capacity * sizeof(*pool->offsets));
+	if (!pool->offsets) {
+		goto err_offsets;
+	}
+
+	if (pthread_mutex_init(&pool->lock, NULL)) {
+		goto err_lock;
+	}
+
+	if (pthread_cond_init(&pool->cond, NULL)) {
+		goto err_cond;
+	}
+
+	if (pthread_create(&pool->worker, NULL, region_pool_worker, pool)) {
+		goto err_worker;
+	}
+
+	return pool;
+
+err_worker:
+	pthread_cond_destroy(&pool->cond);
+err_cond:
+	pthread_mutex_destroy(&pool->lock);
+err_lock:
+	free(pool->offsets);
+err_offsets:
+	free(pool);
+	return NULL;
+}
+
+void pmemstream_region_pool_delete(struct pmemstream_region_pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	pthread_join(pool->worker, NULL);
+
+	/* Regions left in the pool would be freed at next open anyway, but a cleanly closed stream should not
+	 * depend on it. */
+	struct pmemstream *stream = pool->stream;
+	if (pool->count > 0) {
+		allocator_regions_free(&stream->region_allocator, &stream->data,
+				       &stream->header->region_allocator_header, pool->offsets, pool->count);
+	}
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->offsets);
+	free(pool);
+}
+
+uint64_t pmemstream_region_pool_pop(struct pmemstream_region_pool *pool, size_t size)
+{
+	if (size != pool->size) {
+		return PMEMSTREAM_INVALID_OFFSET;
+	}
+
+	uint64_t offset = PMEMSTREAM_INVALID_OFFSET;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->count > 0) {
+		offset = pool->offsets[--pool->count];
+	}
+	pool->allocator_full = false;
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	return offset;
+}
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+/* Parallel scan - reading entries from multiple regions using a pool of worker threads. */
+
+#include "common/parallel.h"
+#include "common/util.h"
+#include "iterator.h"
+#include "libpmemstream_internal.h"
+
+#include <stdlib.h>
+
+/* Number of entries passed to the callback at once. */
+#define SCAN_BATCH_SIZE 64
+
+/* Number of bytes prefetched ahead by each worker. */
+#define SCAN_PREFETCH_DISTANCE 2048
+
+/* State shared by all workers. */
+struct scan_parallel_data {
+	struct pmemstream *stream;
+	const struct pmemstream_region *regions;
+
+	/* All workers iterate over the same snapshot - entries with timestamps greater than this are skipped. */
+	uint64_t max_timestamp;
+
+	pmemstream_scan_callback callback;
+	void *ctx;
+
+	/* Set to non-zero by the first worker which failed, so that other workers stop in the middle of a region. */
+	int error;
+};
+
+static int scan_region(struct scan_parallel_data *data, size_t worker_id, struct pmemstream_region region)
+{
+	struct pmemstream_entry_iterator iterator;
+	/* Scan is read-only, region recovery (if needed) is left for the writer. */
+	int ret = entry_iterator_initialize(&iterator, data->stream, region, false);
+	if (ret) {
+		return ret;
+	}
+	iterator.max_timestamp = data->max_timestamp;
+	pmemstream_entry_iterator_set_prefetch(&iterator, SCAN_PREFETCH_DISTANCE);
+
+	struct pmemstream_entry entries[SCAN_BATCH_SIZE];
+	size_t entries_count = 0;
+
+	for (pmemstream_entry_iterator_seek_first(&iterator); pmemstream_entry_iterator_is_valid(&iterator) == 0;
+	     pmemstream_entry_iterator_next(&iterator)) {
+		entries[entries_count++] = pmemstream_entry_iterator_get(&iterator);
+		if (entries_count < SCAN_BATCH_SIZE) {
+			continue;
+		}
+
+		ret = data->callback(data->stream, worker_id, region, entries, entries_count, data->ctx);
+		if (ret) {
+			return -1;
+		}
+		entries_count = 0;
+
+		int error;
+		atomic_load_relaxed(&data->error, &error);
+		if (error) {
+			return 0;
+		}
+	}
+
+	if (entries_count) {
+		ret = data->callback(data->stream, worker_id, region, entries, entries_count, data->ctx);
+		if (ret) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int scan_parallel_worker(size_t worker_id, size_t region_idx, void *arg)
+{
+	struct scan_parallel_data *data = (struct scan_parallel_data *)arg;
+	if (scan_region(data, worker_id, data->regions[region_idx])) {
+		atomic_store_relaxed(&data->error, 1);
+		return -1;
+	}
+
+	return 0;
+}
+
+int pmemstream_scan_parallel(struct pmemstream *stream, const struct pmemstream_region *regions,
+			     size_t regions_count, size_t nthreads, pmemstream_scan_callback callback, void *ctx)
+{
+	if (!stream || !callback || nthreads == 0) {
+		return -1;
+	}
+
+	if (!regions && regions_count) {
+		return -1;
+	}
+
+	struct pmemstream_region *all_regions = NULL;
+	if (!regions) {
+		all_regions = pmemstream_get_allocated_regions(stream, &regions_count);
+		if (!all_regions) {
+			return -1;
+		}
+		regions = all_regions;
+	}
+
+	struct scan_parallel_data data = {.stream = stream,
+					  .regions = regions,
+					  .max_timestamp = pmemstream_committed_timestamp(stream),
+					  .callback = callback,
+					  .ctx = ctx,
+					  .error = 0};
+
+	int ret = parallel_for(nthreads, regions_count, scan_parallel_worker, &data);
+
+	free(all_regions);
+	return ret;
+}
@@ -92,7 +92,8 @@ static inline void store_with_flush(const struct pmemstream_runtime *runtime, ui
 		(runtime)->drain();                                                                                    \
 	} while (0)
 
-/* Recovers the list after restart - ensures that all invariants are true. */
+/* Recovers the list after restart - ensures that all invariants are true. Tail is moved to the last element, which
+ * might be more than one element further after an interrupted SLIST_INSERT_TAIL_CHAIN. */
 #define SLIST_RUNTIME_INIT(type, runtime, list, field)                                                                 \
 	do {                                                                                                           \
 		if (((list)->head == SLIST_INVALID_OFFSET || (list)->tail == SLIST_INVALID_OFFSET) &&                  \
@@ -100,7 +101,11 @@ static inline void store_with_flush(const struct pmemstream_runtime *runtime, ui
 			SLIST_INIT(runtime, list);                                                                     \
 		} else if ((list)->head != SLIST_INVALID_OFFSET &&                                                     \
 			   SLIST_NEXT(type, runtime, (list)->tail, field) != SLIST_INVALID_OFFSET) {                   \
-			store_with_flush(runtime, &(list)->tail, SLIST_NEXT(type, runtime, (list)->tail, field));      \
+			uint64_t last = (list)->tail;                                                                  \
+			while (SLIST_NEXT(type, runtime, last, field) != SLIST_INVALID_OFFSET) {                       \
+				last = SLIST_NEXT(type, runtime, last, field);                                         \
+			}                                                                                              \
+			store_with_flush(runtime, &(list)->tail, last);                                                \
 		}                                                                                                      \
 		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
 	} while (0)
@@ -145,6 +150,44 @@ static inline void store_with_flush(const struct pmemstream_runtime *runtime, ui
 		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
 	} while (0)
 
+/* Inserts a chain of elements, from 'first' to 'last' (already linked through 'field'), at the head of the list.
+ * Next of 'last' is overwritten. Invariants after crash are the same as for SLIST_INSERT_HEAD.
+ */
+#define SLIST_INSERT_HEAD_CHAIN(type, runtime, list, first, last, field)                                               \
+	do {                                                                                                           \
+		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
+		if ((list)->head == SLIST_INVALID_OFFSET) {                                                            \
+			store_with_flush(runtime, &(list)->tail, last);                                                \
+		}                                                                                                      \
+		store_with_flush(runtime, &SLIST_NEXT(type, runtime, last, field), (list)->head);                      \
+		(runtime)->drain();                                                                                    \
+		store_with_flush(runtime, &(list)->head, first);                                                       \
+		(runtime)->drain();                                                                                    \
+		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
+	} while (0)
+
+/* Inserts a chain of elements, from 'first' to 'last' (already linked through 'field', with next of 'last' set to
+ * SLIST_INVALID_OFFSET and persisted), at the tail of the list.
+ *
+ * Invariants after crash for non-empty list:
+ * If tail was modified to point to 'last': list is consistent. If tail was not modified: tail->next might point to
+ * 'first' (tail will be moved to 'last' on runtime init).
+ */
+#define SLIST_INSERT_TAIL_CHAIN(type, runtime, list, first, last, field)                                               \
+	do {                                                                                                           \
+		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
+		assert(SLIST_NEXT(type, runtime, last, field) == SLIST_INVALID_OFFSET);                                \
+		if ((list)->head == SLIST_INVALID_OFFSET) {                                                            \
+			SLIST_INSERT_HEAD_CHAIN(type, runtime, list, first, last, field);                              \
+		} else {                                                                                               \
+			store_with_flush(runtime, &SLIST_NEXT(type, runtime, (list)->tail, field), first);             \
+			(runtime)->drain();                                                                            \
+			store_with_flush(runtime, &(list)->tail, last);                                                \
+			(runtime)->drain();                                                                            \
+		}                                                                                                      \
+		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
+	} while (0)
+
 #define SLIST_FOREACH(type, runtime, list, it, field)                                                                  \
 	for ((it) = (list)->head; (it) != SLIST_INVALID_OFFSET; (it) = SLIST_NEXT(type, runtime, it, field))
 
@@ -166,11 +209,36 @@ static inline void store_with_flush(const struct pmemstream_runtime *runtime, ui
 		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
 	} while (0)
 
-/* Invariants after crash for removing non-head 'node':
- * If node->next was modified: list is consistent (tail had been updated if necessary)
- * If node->next was not modified: tail might point to element previous to last (it will be recovered on runtime init,
+/* Removes 'offset' which directly follows 'prev' on the list (or is its head, if 'prev' is SLIST_INVALID_OFFSET).
+ * It does not walk the list - caller must know the predecessor.
+ *
+ * Invariants after crash for removing non-head 'node':
+ * If prev->next was modified: list is consistent (tail had been updated if necessary)
+ * If prev->next was not modified: tail might point to element previous to last (it will be recovered on runtime init,
  * remove will be rolled back).
  */
+#define SLIST_REMOVE_AFTER(type, runtime, list, prev, offset, field)                                                   \
+	do {                                                                                                           \
+		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
+		if ((prev) == SLIST_INVALID_OFFSET) {                                                                  \
+			assert((list)->head == (offset));                                                              \
+			SLIST_REMOVE_HEAD(type, runtime, list, field);                                                 \
+		} else {                                                                                               \
+			assert(SLIST_NEXT(type, runtime, prev, field) == (offset));                                    \
+			if (SLIST_NEXT(type, runtime, offset, field) == SLIST_INVALID_OFFSET) {                        \
+				store_with_flush(runtime, &(list)->tail, prev);                                        \
+				(runtime)->drain();                                                                    \
+			}                                                                                              \
+			store_with_flush(runtime, &SLIST_NEXT(type, runtime, prev, field),                             \
+					 SLIST_NEXT(type, runtime, offset, field));                                    \
+			(runtime)->drain();                                                                            \
+		}                                                                                                      \
+		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
+	} while (0)
+
+/* Walks the list to find predecessor of 'offset' and removes it. Does nothing if 'offset' is not on the list.
+ * Invariants after crash are the same as for SLIST_REMOVE_AFTER.
+ */
 #define SLIST_REMOVE(type, runtime, list, offset, field)                                                               \
 	do {                                                                                                           \
 		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
@@ -187,13 +255,7 @@ static inline void store_with_flush(const struct pmemstream_runtime *runtime, ui
 			}                                                                                              \
 			if (next == SLIST_INVALID_OFFSET)                                                              \
 				break;                                                                                 \
-			if (SLIST_NEXT(type, runtime, offset, field) == SLIST_INVALID_OFFSET) {                        \
-				store_with_flush(runtime, &(list)->tail, curelm);                                      \
-				(runtime)->drain();                                                                    \
-			}                                                                                              \
-			store_with_flush(runtime, &SLIST_NEXT(type, runtime, curelm, field),                           \
-					 SLIST_NEXT(type, runtime, offset, field));                                    \
-			(runtime)->drain();                                                                            \
+			SLIST_REMOVE_AFTER(type, runtime, list, curelm, offset, field);                                \
 		}                                                                                                      \
 		assert(SLIST_INVARIANTS(type, runtime, list, field));                                                  \
 	} while (0)
@@ -45,6 +45,23 @@ enum span_type span_get_type(const struct span_base *span)
 	return span->size_and_type & SPAN_TYPE_MASK;
 }
 
+size_t span_region_markers_count(const struct span_region *span_region)
+{
+	uint64_t block_size = span_region->marker_block_size;
+	if (block_size == 0) {
+		return 0;
+	}
+
+	size_t region_data_size = span_get_total_size(&span_region->span_base) - offsetof(struct span_region, data);
+	return ALIGN_UP(region_data_size, block_size) / block_size;
+}
+
+size_t span_region_markers_size(const struct span_region *span_region)
+{
+	return ALIGN_UP(span_region_markers_count(span_region) * sizeof(struct span_region_block_marker),
+			CACHELINE_SIZE);
+}
+
 /* Following atomic store/load functions follow acquire/release semantics. */
 void span_base_atomic_store(struct span_base *dst, struct span_base base)
 {
@@ -42,6 +42,16 @@ struct span_region {
 	alignas(CACHELINE_SIZE) struct span_base span_base;
 	struct allocator_entry_metadata allocator_entry_metadata;
 	uint64_t max_valid_timestamp; /* used for region recovery */
+	uint64_t marker_block_size;   /* 0 if region has no block markers (see span_region_block_marker) */
+
+	/* Region's tail (append offset) and persisted timestamp, stored on clean shutdown. Tail is invalid
+	 * (PMEMSTREAM_INVALID_OFFSET) if the region might have been appended to since then. */
+	uint64_t tail_offset_hint;
+	uint64_t tail_timestamp_hint;
+
+	/* Offset of the next segment of a chained region (SPAN_REGION_CHAIN_NO_NEXT if there is none) ORed with
+	 * SPAN_REGION_CHAIN_* flags. */
+	uint64_t chain;
 
 	alignas(CACHELINE_SIZE) uint64_t data[];
 };
@@ -49,6 +59,41 @@ struct span_region {
 static_assert(sizeof(struct span_region) == CACHELINE_SIZE,
 	      "size of struct span_region must be equal to CACHELINE_SIZE");
 
+/*
+ * Chained region consists of a list of segments (regions of the same size). Only the first segment is visible as
+ * a region - once the last segment is full, a new one is allocated and linked to it. Offsets of segments are
+ * cacheline aligned, flags are stored in the lowest bits of span_region.chain.
+ *
+ * The same link is used by compaction: region which is being filled with entries of a compacted region is hidden
+ * (as a continuation) until the compacted region is linked to it - from that moment, the compacted region is
+ * replaced by the new one (and freed, at next open if needed).
+ */
+#define SPAN_REGION_CHAIN_GROWABLE 1ULL	    /* segment of a chained region */
+#define SPAN_REGION_CHAIN_CONTINUATION 2ULL /* segment other than the first one (or not committed compaction) */
+#define SPAN_REGION_CHAIN_RING 4ULL	    /* ring region (see span_region_ring), never growable */
+#define SPAN_REGION_CHAIN_COMPACTED 8ULL    /* region replaced by the linked one, never growable */
+#define SPAN_REGION_CHAIN_FLAGS_MASK (CACHELINE_SIZE - 1)
+#define SPAN_REGION_CHAIN_NO_NEXT (~SPAN_REGION_CHAIN_FLAGS_MASK)
+
+/*
+ * Region's data might be divided into blocks of span_region.marker_block_size bytes. In such case, an array of
+ * markers (one per block) is stored at the end of the region. Marker of a block points to the entry which ends at
+ * the first entry boundary inside that block. It allows finding the region's tail without iterating over all entries.
+ */
+struct span_region_block_marker {
+	uint64_t entry_offset;
+	uint64_t timestamp; /* PMEMSTREAM_INVALID_TIMESTAMP if marker is not set */
+};
+
+/*
+ * Ring region keeps its head (offset of the first entry) at the very end of the region. Appends which do not fit
+ * before the end of region's data wrap around to its beginning - the end of data is marked by an empty span with
+ * non-zero size. Space before the head is reused once the head is advanced.
+ */
+struct span_region_ring {
+	alignas(CACHELINE_SIZE) uint64_t head_offset;
+};
+
 struct span_timestamped_base {
 	struct span_base span_base;
 	uint64_t timestamp;
@@ -75,6 +120,12 @@ size_t span_get_total_size(const struct span_base *span);
 
 enum span_type span_get_type(const struct span_base *span);
 
+/* Returns number of block markers in the region (0 if region has no markers). */
+size_t span_region_markers_count(const struct span_region *span_region);
+
+/* Returns size of the space at the end of the region occupied by block markers. */
+size_t span_region_markers_size(const struct span_region *span_region);
+
 void span_base_atomic_store(struct span_base *dst, struct span_base base);
 
 void span_timestamped_base_atomic_store(struct span_timestamped_base *dst, struct span_timestamped_base entry);
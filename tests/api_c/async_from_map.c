@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "unittest.h"
+
+#include <libminiasync.h>
+
+/**
+ * async_from_map - unit test for pmemstream_async_from_map
+ */
+
+#define ENTRIES_COUNT 10
+
+/* Polls the future until completion, returns number of polls. */
+static size_t open_and_wait(struct pmemstream_async_from_map_fut *future)
+{
+	size_t polls = 1;
+	while (future_poll(FUTURE_AS_RUNNABLE(future), NULL) != FUTURE_STATE_COMPLETE) {
+		++polls;
+	}
+	return polls;
+}
+
+void test_async_from_map(char *path)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	/* Stream is not available until the future completes. */
+	struct pmemstream *stream = NULL;
+	struct pmemstream_async_from_map_fut future = pmemstream_async_from_map(&stream, TEST_DEFAULT_BLOCK_SIZE, map);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_RUNNING);
+	UT_ASSERTeq(stream, NULL);
+	UT_ASSERT(open_and_wait(&future) > 1);
+	UT_ASSERTeq(future.output.error_code, 0);
+	UT_ASSERTne(stream, NULL);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_append(stream, region, NULL, &i, sizeof(i), NULL), 0);
+	}
+	pmemstream_delete(&stream);
+
+	/* Reopen existing stream - entries are available and appends continue after them. */
+	future = pmemstream_async_from_map(&stream, TEST_DEFAULT_BLOCK_SIZE, map);
+	open_and_wait(&future);
+	UT_ASSERTeq(future.output.error_code, 0);
+	UT_ASSERTne(stream, NULL);
+
+	uint64_t value = ENTRIES_COUNT;
+	UT_ASSERTeq(pmemstream_append(stream, region, NULL, &value, sizeof(value), NULL), 0);
+
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, stream, region), 0);
+	uint64_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, entry), count);
+		++count;
+	}
+	UT_ASSERTeq(count, ENTRIES_COUNT + 1);
+	pmemstream_entry_iterator_delete(&eiter);
+
+	pmemstream_delete(&stream);
+	pmem2_map_delete(&map);
+}
+
+void test_async_from_map_invalid_args(char *path)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream *stream = NULL;
+	struct pmemstream_async_from_map_fut future = pmemstream_async_from_map(NULL, TEST_DEFAULT_BLOCK_SIZE, map);
+	open_and_wait(&future);
+	UT_ASSERTne(future.output.error_code, 0);
+
+	future = pmemstream_async_from_map(&stream, TEST_DEFAULT_BLOCK_SIZE, NULL);
+	open_and_wait(&future);
+	UT_ASSERTne(future.output.error_code, 0);
+	UT_ASSERTeq(stream, NULL);
+
+	/* wrong block size */
+	future = pmemstream_async_from_map(&stream, 0, map);
+	open_and_wait(&future);
+	UT_ASSERTne(future.output.error_code, 0);
+	UT_ASSERTeq(stream, NULL);
+
+	pmem2_map_delete(&map);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+	char *path = argv[1];
+
+	test_async_from_map(path);
+	test_async_from_map_invalid_args(path);
+
+	return 0;
+}
@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "common/util.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#include <libminiasync.h>
+#include <string.h>
+
+/**
+ * async_region_read - unit test for pmemstream_async_region_read
+ */
+
+#define ENTRIES_COUNT 100
+
+static void append_entries(pmemstream_test_env *env, struct pmemstream_region region)
+{
+	uint8_t buffer[256];
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		size_t size = sizeof(uint64_t) + (i % 4) * 64;
+		memset(buffer, (int)i, sizeof(buffer));
+		memcpy(buffer, &i, sizeof(i));
+		int ret = pmemstream_append(env->stream, region, NULL, buffer, size, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+}
+
+static struct pmemstream_async_region_read_output read_and_wait(pmemstream_test_env *env, struct vdm *vdm,
+								 struct pmemstream_region region,
+								 struct pmemstream_entry from_entry, void *dst,
+								 size_t size)
+{
+	struct pmemstream_async_region_read_fut future =
+		pmemstream_async_region_read(env->stream, vdm, region, from_entry, dst, size);
+	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+		;
+	return future.output;
+}
+
+/* Verifies that 'size' bytes in 'buffer' hold entries of the region, starting from 'from_entry'.
+ * Returns number of verified entries. */
+static size_t verify_copied_entries(pmemstream_test_env *env, struct pmemstream_region region,
+				    struct pmemstream_entry from_entry, const uint8_t *buffer, size_t size)
+{
+	struct pmemstream_entry_iterator *eiter;
+	int ret = pmemstream_entry_iterator_new(&eiter, env->stream, region);
+	UT_ASSERTeq(ret, 0);
+
+	size_t count = 0;
+	size_t offset = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		if (entry.offset < from_entry.offset) {
+			continue;
+		}
+		if (entry.offset - from_entry.offset >= size) {
+			break;
+		}
+
+		/* Copied entries keep their relative offsets. */
+		UT_ASSERTeq(offset, entry.offset - from_entry.offset);
+
+		struct pmemstream_copied_entry copied;
+		ret = pmemstream_copied_entry_next(buffer, size, &offset, &copied);
+		UT_ASSERTeq(ret, 0);
+
+		size_t entry_size = pmemstream_entry_size(env->stream, entry);
+		UT_ASSERTeq(copied.size, entry_size);
+		UT_ASSERTeq(copied.timestamp, pmemstream_entry_timestamp(env->stream, entry));
+		UT_ASSERTeq(memcmp(copied.data, pmemstream_entry_data(env->stream, entry), entry_size), 0);
+		++count;
+	}
+
+	/* All copied bytes belong to the visited entries. */
+	UT_ASSERTeq(offset, size);
+	struct pmemstream_copied_entry copied;
+	UT_ASSERTeq(pmemstream_copied_entry_next(buffer, size, &offset, &copied), -1);
+
+	pmemstream_entry_iterator_delete(&eiter);
+	return count;
+}
+
+void whole_region_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+	append_entries(&env, region);
+
+	struct data_mover_threads *dmt = data_mover_threads_default();
+	UT_ASSERTne(dmt, NULL);
+	struct vdm *thread_mover = data_mover_threads_get_vdm(dmt);
+
+	size_t buffer_size = TEST_DEFAULT_REGION_SIZE;
+	uint8_t *buffer = malloc(buffer_size);
+	UT_ASSERTne(buffer, NULL);
+
+	struct pmemstream_entry from_entry = {.offset = UINT64_MAX};
+	struct pmemstream_async_region_read_output output =
+		read_and_wait(&env, thread_mover, region, from_entry, buffer, buffer_size);
+	UT_ASSERTeq(output.error_code, 0);
+	UT_ASSERT(output.size > 0);
+
+	struct pmemstream_entry_iterator *eiter;
+	ret = pmemstream_entry_iterator_new(&eiter, env.stream, region);
+	UT_ASSERTeq(ret, 0);
+	pmemstream_entry_iterator_seek_first(eiter);
+	struct pmemstream_entry first_entry = pmemstream_entry_iterator_get(eiter);
+	pmemstream_entry_iterator_delete(&eiter);
+
+	UT_ASSERTeq(verify_copied_entries(&env, region, first_entry, buffer, output.size), ENTRIES_COUNT);
+	UT_ASSERTeq(output.next_entry.offset, first_entry.offset + output.size);
+
+	/* Nothing more to read. */
+	output = read_and_wait(&env, thread_mover, region, output.next_entry, buffer, buffer_size);
+	UT_ASSERTeq(output.error_code, 0);
+	UT_ASSERTeq(output.size, 0);
+
+	/* New entries can be read from the place where the previous read ended. */
+	struct pmemstream_entry next_entry = output.next_entry;
+	append_entries(&env, region);
+	output = read_and_wait(&env, thread_mover, region, next_entry, buffer, buffer_size);
+	UT_ASSERTeq(output.error_code, 0);
+	UT_ASSERTeq(verify_copied_entries(&env, region, next_entry, buffer, output.size), ENTRIES_COUNT);
+
+	free(buffer);
+	data_mover_threads_delete(dmt);
+	pmemstream_test_teardown(env);
+}
+
+void chunked_read_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+	append_entries(&env, region);
+
+	struct data_mover_sync *dms = data_mover_sync_new();
+	UT_ASSERTne(dms, NULL);
+	struct vdm *sync_mover = data_mover_sync_get_vdm(dms);
+
+	/* Buffer fits few entries at once - read has to be continued multiple times. */
+	uint8_t buffer[1024];
+	struct pmemstream_entry from_entry = {.offset = UINT64_MAX};
+	size_t count = 0;
+	size_t reads = 0;
+	while (true) {
+		struct pmemstream_async_region_read_output output =
+			read_and_wait(&env, sync_mover, region, from_entry, buffer, sizeof(buffer));
+		UT_ASSERTeq(output.error_code, 0);
+		UT_ASSERT(output.size <= sizeof(buffer));
+		if (output.size == 0) {
+			break;
+		}
+
+		if (from_entry.offset == UINT64_MAX) {
+			from_entry.offset = output.next_entry.offset - output.size;
+		}
+		count += verify_copied_entries(&env, region, from_entry, buffer, output.size);
+		from_entry = output.next_entry;
+		++reads;
+	}
+
+	UT_ASSERTeq(count, ENTRIES_COUNT);
+	UT_ASSERT(reads > 1);
+
+	/* Buffer too small for any entry (each one holds at least 8 bytes of data and some metadata). */
+	from_entry.offset = UINT64_MAX;
+	struct pmemstream_async_region_read_output output =
+		read_and_wait(&env, sync_mover, region, from_entry, buffer, sizeof(uint64_t));
+	UT_ASSERTeq(output.error_code, 0);
+	UT_ASSERTeq(output.size, 0);
+
+	data_mover_sync_delete(dms);
+	pmemstream_test_teardown(env);
+}
+
+void invalid_input_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+	append_entries(&env, region);
+
+	struct pmemstream_region other_region;
+	ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &other_region);
+	UT_ASSERTeq(ret, 0);
+
+	struct data_mover_sync *dms = data_mover_sync_new();
+	UT_ASSERTne(dms, NULL);
+	struct vdm *sync_mover = data_mover_sync_get_vdm(dms);
+
+	uint8_t buffer[1024];
+	struct pmemstream_entry from_entry = {.offset = UINT64_MAX};
+
+	struct pmemstream_async_region_read_fut future =
+		pmemstream_async_region_read(NULL, sync_mover, region, from_entry, buffer, sizeof(buffer));
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTne(future.output.error_code, 0);
+
+	future = pmemstream_async_region_read(env.stream, NULL, region, from_entry, buffer, sizeof(buffer));
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTne(future.output.error_code, 0);
+
+	future = pmemstream_async_region_read(env.stream, sync_mover, region, from_entry, NULL, sizeof(buffer));
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTne(future.output.error_code, 0);
+
+	struct pmemstream_region invalid_region = {.offset = ALIGN_DOWN(UINT64_MAX, sizeof(uint64_t))};
+	future = pmemstream_async_region_read(env.stream, sync_mover, invalid_region, from_entry, buffer,
+					      sizeof(buffer));
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTne(future.output.error_code, 0);
+
+	/* Entry from a different region. */
+	future = pmemstream_async_region_read(env.stream, sync_mover, region, from_entry, buffer, sizeof(buffer));
+	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+		;
+	UT_ASSERTeq(future.output.error_code, 0);
+	future = pmemstream_async_region_read(env.stream, sync_mover, other_region, future.output.next_entry, buffer,
+					      sizeof(buffer));
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTne(future.output.error_code, 0);
+
+	data_mover_sync_delete(dms);
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	whole_region_test(path);
+	chunked_read_test(path);
+	invalid_input_test(path);
+
+	return 0;
+}
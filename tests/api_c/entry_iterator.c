@@ -7,10 +7,14 @@
 #include "stream_helpers.h"
 #include "unittest.h"
 
+#include <string.h>
+
 /**
  * entry_iterator - unit test for pmemstream_entry_iterator_new,
  *					pmemstream_entry_iterator_seek_first, pmemstream_entry_iterator_is_valid,
- *					pmemstream_entry_iterator_next, pmemstream_entry_iterator_delete
+ *					pmemstream_entry_iterator_next, pmemstream_entry_iterator_delete,
+ *					pmemstream_entry_iterator_set_prefetch, pmemstream_entry_iterator_seek_last,
+ *					pmemstream_entry_iterator_prev, pmemstream_entry_iterator_set_filter
  */
 
 struct entry_data {
@@ -92,6 +96,242 @@ void test_get_last_entry(char *path)
 	free(entries);
 }
 
+void prefetch_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	/* Mix small and big entries, so that some headers are outside of the prefetch distance. */
+	const uint64_t entries_count = 64;
+	uint8_t buffer[1024] = {0};
+	for (uint64_t i = 0; i < entries_count; i++) {
+		size_t size = (i % 2) ? sizeof(buffer) : sizeof(uint64_t);
+		memcpy(buffer, &i, sizeof(i));
+		ret = pmemstream_append(env.stream, region, NULL, buffer, size, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	const size_t distances[] = {0, 1, CACHELINE_SIZE, 4096, TEST_DEFAULT_STREAM_SIZE};
+	for (size_t d = 0; d < sizeof(distances) / sizeof(distances[0]); d++) {
+		struct pmemstream_entry_iterator *eiter;
+		ret = pmemstream_entry_iterator_new(&eiter, env.stream, region);
+		UT_ASSERTeq(ret, 0);
+
+		ret = pmemstream_entry_iterator_set_prefetch(eiter, distances[d]);
+		UT_ASSERTeq(ret, 0);
+
+		uint64_t count = 0;
+		for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+		     pmemstream_entry_iterator_next(eiter)) {
+			struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+			UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, entry), count);
+			++count;
+		}
+		UT_ASSERTeq(count, entries_count);
+
+		pmemstream_entry_iterator_delete(&eiter);
+	}
+
+	ret = pmemstream_entry_iterator_set_prefetch(NULL, 4096);
+	UT_ASSERTeq(ret, -1);
+
+	pmemstream_test_teardown(env);
+}
+
+static void append_reverse_test_entries(pmemstream_test_env *env, struct pmemstream_region region, uint64_t begin,
+					uint64_t end)
+{
+	/* Mix small and big entries, so that some parts of the region do not contain any entry header. */
+	static uint8_t buffer[3 * 4096];
+	for (uint64_t i = begin; i < end; i++) {
+		size_t size = (i % 4 == 3) ? sizeof(buffer) : sizeof(uint64_t);
+		memcpy(buffer, &i, sizeof(i));
+		int ret = pmemstream_append(env->stream, region, NULL, buffer, size, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+}
+
+void reverse_iteration_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	struct pmemstream_entry_iterator *eiter;
+	ret = pmemstream_entry_iterator_new(&eiter, env.stream, region);
+	UT_ASSERTeq(ret, 0);
+
+	/* Empty region. */
+	pmemstream_entry_iterator_seek_last(eiter);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(eiter), 0);
+	pmemstream_entry_iterator_prev(eiter);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(eiter), 0);
+
+	const uint64_t entries_count = 64;
+	append_reverse_test_entries(&env, region, 0, entries_count);
+
+	uint64_t expected = entries_count;
+	for (pmemstream_entry_iterator_seek_last(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_prev(eiter)) {
+		--expected;
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, entry), expected);
+	}
+	UT_ASSERTeq(expected, 0);
+
+	/* Read only a few most recent entries after appending more of them. */
+	append_reverse_test_entries(&env, region, entries_count, 2 * entries_count);
+	pmemstream_entry_iterator_seek_last(eiter);
+	for (uint64_t i = 0; i < 5; i++) {
+		UT_ASSERTeq(pmemstream_entry_iterator_is_valid(eiter), 0);
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, entry), 2 * entries_count - 1 - i);
+		pmemstream_entry_iterator_prev(eiter);
+	}
+
+	/* Changing direction. */
+	pmemstream_entry_iterator_next(eiter);
+	struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+	UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, entry), 2 * entries_count - 5);
+
+	/* Moving back from the position past the last entry. */
+	pmemstream_entry_iterator_seek_last(eiter);
+	pmemstream_entry_iterator_next(eiter);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(eiter), 0);
+	pmemstream_entry_iterator_prev(eiter);
+	UT_ASSERTeq(pmemstream_entry_iterator_is_valid(eiter), 0);
+	entry = pmemstream_entry_iterator_get(eiter);
+	UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, entry), 2 * entries_count - 1);
+
+	/* Moving back from the first entry. */
+	pmemstream_entry_iterator_seek_first(eiter);
+	pmemstream_entry_iterator_prev(eiter);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(eiter), 0);
+
+	pmemstream_entry_iterator_seek_last(NULL);
+	pmemstream_entry_iterator_prev(NULL);
+
+	pmemstream_entry_iterator_delete(&eiter);
+	pmemstream_test_teardown(env);
+}
+
+/* Payload used by filter_test: tag is compared by the prefix filter. */
+struct tagged_entry {
+	uint32_t tag;
+	uint32_t padding;
+	uint64_t value;
+};
+
+void filter_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	/* Entries with tags 0, 1, 2, 0, 1, 2... and every 5th entry is a short one (only 1 byte). */
+	const uint64_t entries_count = 90;
+	for (uint64_t i = 0; i < entries_count; i++) {
+		struct tagged_entry e = {.tag = (uint32_t)(i % 3), .padding = 0, .value = i};
+		size_t size = (i % 5 == 4) ? 1 : sizeof(e);
+		ret = pmemstream_append(env.stream, region, NULL, &e, size, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	struct pmemstream_entry_iterator *eiter;
+	ret = pmemstream_entry_iterator_new(&eiter, env.stream, region);
+	UT_ASSERTeq(ret, 0);
+
+	/* Match by tag == 2 (short entries cannot match). */
+	struct pmemstream_entry_filter filter;
+	memset(&filter, 0, sizeof(filter));
+	filter.max_size = SIZE_MAX;
+	filter.max_timestamp = UINT64_MAX;
+	uint32_t tag = 2;
+	memcpy(filter.prefix, &tag, sizeof(tag));
+	memset(filter.prefix_mask, 0xFF, sizeof(tag));
+	ret = pmemstream_entry_iterator_set_filter(eiter, &filter);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		const struct tagged_entry *e = pmemstream_entry_data(env.stream, pmemstream_entry_iterator_get(eiter));
+		UT_ASSERTeq(e->tag, 2);
+		UT_ASSERTne(e->value % 5, 4);
+		++count;
+	}
+	UT_ASSERTeq(count, 24);
+
+	/* Match by size only (short entries). */
+	memset(&filter, 0, sizeof(filter));
+	filter.max_size = 1;
+	filter.max_timestamp = UINT64_MAX;
+	ret = pmemstream_entry_iterator_set_filter(eiter, &filter);
+	UT_ASSERTeq(ret, 0);
+
+	count = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		UT_ASSERTeq(pmemstream_entry_size(env.stream, pmemstream_entry_iterator_get(eiter)), 1);
+		++count;
+	}
+	UT_ASSERTeq(count, entries_count / 5);
+
+	/* Match by timestamp range - take timestamps of 10th and 19th entry. */
+	pmemstream_entry_iterator_set_filter(eiter, NULL);
+	pmemstream_entry_iterator_seek_first(eiter);
+	for (uint64_t i = 0; i < 10; i++)
+		pmemstream_entry_iterator_next(eiter);
+	uint64_t min_timestamp = pmemstream_entry_timestamp(env.stream, pmemstream_entry_iterator_get(eiter));
+	for (uint64_t i = 0; i < 9; i++)
+		pmemstream_entry_iterator_next(eiter);
+	uint64_t max_timestamp = pmemstream_entry_timestamp(env.stream, pmemstream_entry_iterator_get(eiter));
+
+	memset(&filter, 0, sizeof(filter));
+	filter.max_size = SIZE_MAX;
+	filter.min_timestamp = min_timestamp;
+	filter.max_timestamp = max_timestamp;
+	ret = pmemstream_entry_iterator_set_filter(eiter, &filter);
+	UT_ASSERTeq(ret, 0);
+
+	count = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		++count;
+	}
+	UT_ASSERTeq(count, 10);
+
+	/* No entry matches. */
+	filter.min_size = sizeof(struct tagged_entry) + 1;
+	ret = pmemstream_entry_iterator_set_filter(eiter, &filter);
+	UT_ASSERTeq(ret, 0);
+	pmemstream_entry_iterator_seek_first(eiter);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(eiter), 0);
+
+	/* Removing the filter. */
+	ret = pmemstream_entry_iterator_set_filter(eiter, NULL);
+	UT_ASSERTeq(ret, 0);
+	count = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		++count;
+	}
+	UT_ASSERTeq(count, entries_count);
+
+	ret = pmemstream_entry_iterator_set_filter(NULL, &filter);
+	UT_ASSERTeq(ret, -1);
+
+	pmemstream_entry_iterator_delete(&eiter);
+	pmemstream_test_teardown(env);
+}
+
 void null_iterator_test(char *path)
 {
 	pmemstream_test_env env = pmemstream_test_make_default(path);
@@ -239,6 +479,9 @@ int main(int argc, char *argv[])
 
 	valid_input_test(path);
 	test_get_last_entry(path);
+	prefetch_test(path);
+	reverse_iteration_test(path);
+	filter_test(path);
 	null_iterator_test(path);
 	invalid_region_test(path);
 	invalid_iterator_test(path);
@@ -0,0 +1,337 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "span.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#include <libminiasync.h>
+#include <pthread.h>
+#include <string.h>
+
+/**
+ * entry_iterator_async_next - unit test for pmemstream_entry_iterator_async_next,
+ *				pmemstream_entry_iterator_set_filter
+ */
+
+#define ENTRIES_COUNT 100
+
+/* Waker which can be waited on by the consumer. */
+struct test_waker {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	size_t wakeups;
+};
+
+static void test_waker_wake(void *data)
+{
+	struct test_waker *waker = (struct test_waker *)data;
+	pthread_mutex_lock(&waker->lock);
+	waker->wakeups++;
+	pthread_cond_signal(&waker->cond);
+	pthread_mutex_unlock(&waker->lock);
+}
+
+static void test_waker_init(struct test_waker *waker)
+{
+	pthread_mutex_init(&waker->lock, NULL);
+	pthread_cond_init(&waker->cond, NULL);
+	waker->wakeups = 0;
+}
+
+static void test_waker_destroy(struct test_waker *waker)
+{
+	pthread_cond_destroy(&waker->cond);
+	pthread_mutex_destroy(&waker->lock);
+}
+
+static struct future_notifier test_waker_notifier(struct test_waker *waker)
+{
+	struct future_notifier notifier;
+	notifier.waker = (struct future_waker){.data = waker, .wake = test_waker_wake};
+	notifier.notifier_used = FUTURE_NOTIFIER_NONE;
+	return notifier;
+}
+
+/* Polls 'future' until completion, sleeping on 'waker' whenever the future asks for it. */
+static void wait_with_waker(struct pmemstream_async_next_fut *future, struct test_waker *waker)
+{
+	while (true) {
+		pthread_mutex_lock(&waker->lock);
+		size_t wakeups = waker->wakeups;
+		pthread_mutex_unlock(&waker->lock);
+
+		struct future_notifier notifier = test_waker_notifier(waker);
+		if (future_poll(FUTURE_AS_RUNNABLE(future), &notifier) == FUTURE_STATE_COMPLETE)
+			return;
+
+		if (notifier.notifier_used != FUTURE_NOTIFIER_WAKER)
+			continue;
+
+		pthread_mutex_lock(&waker->lock);
+		while (waker->wakeups == wakeups)
+			pthread_cond_wait(&waker->cond, &waker->lock);
+		pthread_mutex_unlock(&waker->lock);
+	}
+}
+
+void existing_entries_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		ret = pmemstream_append(env.stream, region, NULL, &i, sizeof(i), NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	struct pmemstream_entry_iterator *eiter;
+	ret = pmemstream_entry_iterator_new(&eiter, env.stream, region);
+	UT_ASSERTeq(ret, 0);
+
+	/* Not positioned iterator - future moves it to the first entry. */
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		struct pmemstream_async_next_fut future = pmemstream_entry_iterator_async_next(eiter);
+		UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+		UT_ASSERTeq(future.output.error_code, 0);
+
+		const uint64_t *data = pmemstream_entry_data(env.stream, future.output.entry);
+		UT_ASSERTeq(*data, i);
+		UT_ASSERTeq(pmemstream_entry_iterator_get(eiter).offset, future.output.entry.offset);
+	}
+
+	/* No more entries - future has to wait. */
+	struct pmemstream_async_next_fut future = pmemstream_entry_iterator_async_next(eiter);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_RUNNING);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_RUNNING);
+
+	uint64_t value = ENTRIES_COUNT;
+	ret = pmemstream_append(env.stream, region, NULL, &value, sizeof(value), NULL);
+	UT_ASSERTeq(ret, 0);
+
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTeq(future.output.error_code, 0);
+	UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, future.output.entry), value);
+
+	pmemstream_entry_iterator_delete(&eiter);
+	pmemstream_test_teardown(env);
+}
+
+void empty_region_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	struct pmemstream_entry_iterator *eiter;
+	ret = pmemstream_entry_iterator_new(&eiter, env.stream, region);
+	UT_ASSERTeq(ret, 0);
+
+	pmemstream_entry_iterator_seek_first(eiter);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(eiter), 0);
+
+	struct test_waker waker;
+	test_waker_init(&waker);
+
+	struct pmemstream_async_next_fut future = pmemstream_entry_iterator_async_next(eiter);
+	struct future_notifier notifier = test_waker_notifier(&waker);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), &notifier), FUTURE_STATE_RUNNING);
+	UT_ASSERTeq(notifier.notifier_used, FUTURE_NOTIFIER_WAKER);
+
+	/* Registering the same waker again does not result in additional wakeups. */
+	notifier = test_waker_notifier(&waker);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), &notifier), FUTURE_STATE_RUNNING);
+	UT_ASSERTeq(notifier.notifier_used, FUTURE_NOTIFIER_WAKER);
+	UT_ASSERTeq(waker.wakeups, 0);
+
+	uint64_t value = 1;
+	ret = pmemstream_append(env.stream, region, NULL, &value, sizeof(value), NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(waker.wakeups, 1);
+
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTeq(future.output.error_code, 0);
+	UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, future.output.entry), value);
+
+	/* Waker is called only once. */
+	ret = pmemstream_append(env.stream, region, NULL, &value, sizeof(value), NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(waker.wakeups, 1);
+
+	test_waker_destroy(&waker);
+	pmemstream_entry_iterator_delete(&eiter);
+	pmemstream_test_teardown(env);
+}
+
+struct producer_args {
+	struct pmemstream *stream;
+	struct pmemstream_region region;
+};
+
+static void *producer(void *arg)
+{
+	struct producer_args *args = (struct producer_args *)arg;
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		int ret = pmemstream_append(args->stream, args->region, NULL, &i, sizeof(i), NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+	return NULL;
+}
+
+void concurrent_producer_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	/* Make region ready for write before starting the producer. */
+	struct pmemstream_region_runtime *region_runtime;
+	ret = pmemstream_region_runtime_initialize(env.stream, region, &region_runtime);
+	UT_ASSERTeq(ret, 0);
+
+	struct pmemstream_entry_iterator *eiter;
+	ret = pmemstream_entry_iterator_new(&eiter, env.stream, region);
+	UT_ASSERTeq(ret, 0);
+
+	struct test_waker waker;
+	test_waker_init(&waker);
+
+	struct producer_args args = {.stream = env.stream, .region = region};
+	pthread_t thread;
+	ret = pthread_create(&thread, NULL, producer, &args);
+	UT_ASSERTeq(ret, 0);
+
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		struct pmemstream_async_next_fut future = pmemstream_entry_iterator_async_next(eiter);
+		wait_with_waker(&future, &waker);
+		UT_ASSERTeq(future.output.error_code, 0);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, future.output.entry), i);
+	}
+
+	pthread_join(thread, NULL);
+
+	test_waker_destroy(&waker);
+	pmemstream_entry_iterator_delete(&eiter);
+	pmemstream_test_teardown(env);
+}
+
+void full_region_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_BLOCK_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	/* Fill the region completely - the remaining space (if any) is too small even for an empty entry. */
+	uint64_t value = 0;
+	size_t entries = 0;
+	while (pmemstream_append(env.stream, region, NULL, &value, sizeof(value), NULL) == 0)
+		entries++;
+	while (pmemstream_append(env.stream, region, NULL, &value, 0, NULL) == 0)
+		entries++;
+
+	struct pmemstream_entry_iterator *eiter;
+	ret = pmemstream_entry_iterator_new(&eiter, env.stream, region);
+	UT_ASSERTeq(ret, 0);
+
+	pmemstream_entry_iterator_seek_first(eiter);
+	for (size_t i = 1; i < entries; i++)
+		pmemstream_entry_iterator_next(eiter);
+	UT_ASSERTeq(pmemstream_entry_iterator_is_valid(eiter), 0);
+
+	struct pmemstream_async_next_fut future = pmemstream_entry_iterator_async_next(eiter);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTne(future.output.error_code, 0);
+
+	pmemstream_entry_iterator_delete(&eiter);
+	pmemstream_test_teardown(env);
+}
+
+void filtered_entries_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	struct pmemstream_entry_iterator *eiter;
+	ret = pmemstream_entry_iterator_new(&eiter, env.stream, region);
+	UT_ASSERTeq(ret, 0);
+
+	/* Only even values match the filter. */
+	struct pmemstream_entry_filter filter;
+	memset(&filter, 0, sizeof(filter));
+	filter.max_size = SIZE_MAX;
+	filter.max_timestamp = UINT64_MAX;
+	filter.prefix_mask[0] = 1;
+	ret = pmemstream_entry_iterator_set_filter(eiter, &filter);
+	UT_ASSERTeq(ret, 0);
+
+	struct test_waker waker;
+	test_waker_init(&waker);
+
+	struct pmemstream_async_next_fut future = pmemstream_entry_iterator_async_next(eiter);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_RUNNING);
+
+	for (uint64_t i = 0; i < ENTRIES_COUNT; i++) {
+		ret = pmemstream_append(env.stream, region, NULL, &i, sizeof(i), NULL);
+		UT_ASSERTeq(ret, 0);
+
+		/* Entry which does not match the filter is skipped and the future keeps waiting. */
+		struct future_notifier notifier = test_waker_notifier(&waker);
+		enum future_state state = future_poll(FUTURE_AS_RUNNABLE(&future), &notifier);
+		if (i % 2) {
+			UT_ASSERTeq(state, FUTURE_STATE_RUNNING);
+			UT_ASSERTeq(notifier.notifier_used, FUTURE_NOTIFIER_WAKER);
+			continue;
+		}
+
+		UT_ASSERTeq(state, FUTURE_STATE_COMPLETE);
+		UT_ASSERTeq(future.output.error_code, 0);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(env.stream, future.output.entry), i);
+
+		future = pmemstream_entry_iterator_async_next(eiter);
+		UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_RUNNING);
+	}
+
+	test_waker_destroy(&waker);
+	pmemstream_entry_iterator_delete(&eiter);
+	pmemstream_test_teardown(env);
+}
+
+void null_iterator_test(void)
+{
+	struct pmemstream_async_next_fut future = pmemstream_entry_iterator_async_next(NULL);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTne(future.output.error_code, 0);
+	UT_ASSERTeq(future.output.entry.offset, PMEMSTREAM_INVALID_OFFSET);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	existing_entries_test(path);
+	empty_region_test(path);
+	concurrent_producer_test(path);
+	full_region_test(path);
+	filtered_entries_test(path);
+	null_iterator_test();
+
+	return 0;
+}
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "common/util.h"
+#include "span.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#include <string.h>
+
+/**
+ * entry_read - unit test for pmemstream_entry_read and pmemstream_entry_read_batch
+ */
+
+#define ENTRIES_COUNT 8
+
+/* Sizes of appended entries - both smaller and bigger than non-temporal read threshold. */
+static const size_t entry_sizes[ENTRIES_COUNT] = {0, 1, 63, 4095, 4096, 4097, 10000, 65536};
+
+static void fill_buffer(uint8_t *buffer, size_t size, uint64_t seed)
+{
+	for (size_t i = 0; i < size; i++) {
+		buffer[i] = (uint8_t)(seed * 31 + i);
+	}
+}
+
+static void append_entries(pmemstream_test_env *env, struct pmemstream_region region,
+			   struct pmemstream_entry *entries)
+{
+	uint8_t *buffer = malloc(entry_sizes[ENTRIES_COUNT - 1]);
+	UT_ASSERTne(buffer, NULL);
+
+	for (size_t i = 0; i < ENTRIES_COUNT; i++) {
+		fill_buffer(buffer, entry_sizes[i], i);
+		int ret = pmemstream_append(env->stream, region, NULL, buffer, entry_sizes[i], &entries[i]);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	free(buffer);
+}
+
+void read_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	struct pmemstream_entry entries[ENTRIES_COUNT];
+	append_entries(&env, region, entries);
+
+	size_t max_size = entry_sizes[ENTRIES_COUNT - 1];
+	uint8_t *expected = malloc(max_size);
+	uint8_t *buffer = malloc(max_size + 1);
+	UT_ASSERTne(expected, NULL);
+	UT_ASSERTne(buffer, NULL);
+
+	for (size_t i = 0; i < ENTRIES_COUNT; i++) {
+		fill_buffer(expected, entry_sizes[i], i);
+
+		/* Whole entry (buffer is bigger than the entry). */
+		memset(buffer, 0xFF, max_size + 1);
+		size_t entry_size = 0;
+		ret = pmemstream_entry_read(env.stream, entries[i], buffer, max_size + 1, &entry_size);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(entry_size, entry_sizes[i]);
+		UT_ASSERTeq(memcmp(buffer, expected, entry_sizes[i]), 0);
+		UT_ASSERTeq(buffer[entry_sizes[i]], 0xFF);
+
+		/* Only a part of the entry - reported entry size tells that the read was partial. */
+		size_t size = entry_sizes[i] / 2;
+		memset(buffer, 0xFF, max_size + 1);
+		entry_size = 0;
+		ret = pmemstream_entry_read(env.stream, entries[i], buffer, size, &entry_size);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(entry_size, entry_sizes[i]);
+		UT_ASSERTeq(memcmp(buffer, expected, size), 0);
+		UT_ASSERTeq(buffer[size], 0xFF);
+	}
+
+	free(buffer);
+	free(expected);
+	pmemstream_test_teardown(env);
+}
+
+void read_batch_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	struct pmemstream_entry entries[ENTRIES_COUNT];
+	append_entries(&env, region, entries);
+
+	/* Read entries in reverse order, to make sure batch does not depend on entries' placement. */
+	struct pmemstream_entry_read_request requests[ENTRIES_COUNT];
+	for (size_t i = 0; i < ENTRIES_COUNT; i++) {
+		size_t idx = ENTRIES_COUNT - 1 - i;
+		requests[i].entry = entries[idx];
+		/* Every other entry is read only partially. */
+		requests[i].size = i % 2 ? entry_sizes[idx] / 2 : entry_sizes[idx];
+		requests[i].entry_size = 0;
+		requests[i].dst = entry_sizes[idx] ? malloc(entry_sizes[idx]) : NULL;
+	}
+
+	ret = pmemstream_entry_read_batch(env.stream, requests, ENTRIES_COUNT);
+	UT_ASSERTeq(ret, 0);
+
+	uint8_t *expected = malloc(entry_sizes[ENTRIES_COUNT - 1]);
+	UT_ASSERTne(expected, NULL);
+	for (size_t i = 0; i < ENTRIES_COUNT; i++) {
+		size_t idx = ENTRIES_COUNT - 1 - i;
+		fill_buffer(expected, entry_sizes[idx], idx);
+		UT_ASSERTeq(requests[i].entry_size, entry_sizes[idx]);
+		if (requests[i].size) {
+			UT_ASSERTeq(memcmp(requests[i].dst, expected, requests[i].size), 0);
+		}
+	}
+	free(expected);
+
+	/* Empty batch. */
+	ret = pmemstream_entry_read_batch(env.stream, requests, 0);
+	UT_ASSERTeq(ret, 0);
+
+	/* One invalid request fails the whole batch. */
+	requests[ENTRIES_COUNT - 1].entry.offset = ALIGN_DOWN(UINT64_MAX, sizeof(span_bytes));
+	ret = pmemstream_entry_read_batch(env.stream, requests, ENTRIES_COUNT);
+	UT_ASSERTeq(ret, -1);
+
+	for (size_t i = 0; i < ENTRIES_COUNT; i++) {
+		free(requests[i].dst);
+	}
+
+	pmemstream_test_teardown(env);
+}
+
+void invalid_input_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t value = 1;
+	struct pmemstream_entry entry;
+	ret = pmemstream_append(env.stream, region, NULL, &value, sizeof(value), &entry);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t buffer;
+	ret = pmemstream_entry_read(NULL, entry, &buffer, sizeof(buffer), NULL);
+	UT_ASSERTeq(ret, -1);
+
+	ret = pmemstream_entry_read(env.stream, entry, NULL, sizeof(buffer), NULL);
+	UT_ASSERTeq(ret, -1);
+
+	/* Entry size is optional. */
+	ret = pmemstream_entry_read(env.stream, entry, &buffer, sizeof(buffer), NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(buffer, value);
+
+	struct pmemstream_entry invalid_entry = {.offset = ALIGN_DOWN(UINT64_MAX, sizeof(span_bytes))};
+	ret = pmemstream_entry_read(env.stream, invalid_entry, &buffer, sizeof(buffer), NULL);
+	UT_ASSERTeq(ret, -1);
+
+	ret = pmemstream_entry_read_batch(env.stream, NULL, 1);
+	UT_ASSERTeq(ret, -1);
+
+	struct pmemstream_entry_read_request request = {.entry = entry, .dst = &buffer, .size = sizeof(buffer)};
+	ret = pmemstream_entry_read_batch(NULL, &request, 1);
+	UT_ASSERTeq(ret, -1);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	read_test(path);
+	read_batch_test(path);
+	invalid_input_test(path);
+
+	return 0;
+}
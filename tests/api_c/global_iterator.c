@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "libpmemstream.h"
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+/**
+ * global_iterator - unit test for pmemstream_global_iterator_new, pmemstream_global_iterator_seek_first,
+ *			pmemstream_global_iterator_seek_timestamp, pmemstream_global_iterator_is_valid,
+ *			pmemstream_global_iterator_next, pmemstream_global_iterator_get,
+ *			pmemstream_global_iterator_get_batch, pmemstream_global_iterator_delete
+ */
+
+#define REGIONS_COUNT 3
+#define ENTRIES_PER_REGION 10
+
+/* Appends entries to all regions in round-robin manner - entry's data is its expected global position. */
+static void append_round_robin(pmemstream_test_env *env, struct pmemstream_region *regions)
+{
+	for (uint64_t i = 0; i < REGIONS_COUNT * ENTRIES_PER_REGION; i++) {
+		int ret = pmemstream_append(env->stream, regions[i % REGIONS_COUNT], NULL, &i, sizeof(i), NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+}
+
+static void allocate_regions(pmemstream_test_env *env, struct pmemstream_region *regions)
+{
+	for (size_t i = 0; i < REGIONS_COUNT; i++) {
+		int ret = pmemstream_region_allocate(env->stream, TEST_DEFAULT_REGION_MULTI_SIZE, &regions[i]);
+		UT_ASSERTeq(ret, 0);
+	}
+}
+
+void valid_input_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	allocate_regions(&env, regions);
+	append_round_robin(&env, regions);
+
+	struct pmemstream_global_iterator *giter;
+	int ret = pmemstream_global_iterator_new(&giter, env.stream, regions, REGIONS_COUNT);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTne(giter, NULL);
+
+	uint64_t expected = 0;
+	uint64_t prev_timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	for (pmemstream_global_iterator_seek_first(giter); pmemstream_global_iterator_is_valid(giter) == 0;
+	     pmemstream_global_iterator_next(giter)) {
+		struct pmemstream_entry entry = pmemstream_global_iterator_get(giter);
+		const uint64_t *data = pmemstream_entry_data(env.stream, entry);
+		UT_ASSERTeq(*data, expected);
+
+		uint64_t timestamp = pmemstream_entry_timestamp(env.stream, entry);
+		UT_ASSERT(timestamp > prev_timestamp);
+		prev_timestamp = timestamp;
+		++expected;
+	}
+	UT_ASSERTeq(expected, REGIONS_COUNT * ENTRIES_PER_REGION);
+
+	struct pmemstream_entry entry = pmemstream_global_iterator_get(giter);
+	UT_ASSERTeq(entry.offset, PMEMSTREAM_INVALID_OFFSET);
+
+	pmemstream_global_iterator_delete(&giter);
+	UT_ASSERTeq(giter, NULL);
+
+	pmemstream_test_teardown(env);
+}
+
+void all_regions_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	allocate_regions(&env, regions);
+	append_round_robin(&env, regions);
+
+	struct pmemstream_global_iterator *giter;
+	int ret = pmemstream_global_iterator_new(&giter, env.stream, NULL, 0);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t count = 0;
+	for (pmemstream_global_iterator_seek_first(giter); pmemstream_global_iterator_is_valid(giter) == 0;
+	     pmemstream_global_iterator_next(giter)) {
+		const uint64_t *data = pmemstream_entry_data(env.stream, pmemstream_global_iterator_get(giter));
+		UT_ASSERTeq(*data, count);
+		++count;
+	}
+	UT_ASSERTeq(count, REGIONS_COUNT * ENTRIES_PER_REGION);
+
+	pmemstream_global_iterator_delete(&giter);
+	pmemstream_test_teardown(env);
+}
+
+void seek_timestamp_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	allocate_regions(&env, regions);
+	append_round_robin(&env, regions);
+
+	struct pmemstream_global_iterator *giter;
+	int ret = pmemstream_global_iterator_new(&giter, env.stream, regions, REGIONS_COUNT);
+	UT_ASSERTeq(ret, 0);
+
+	/* Entry with data 'i' has timestamp 'i + 1'. */
+	const uint64_t start_from = ENTRIES_PER_REGION + 1;
+	pmemstream_global_iterator_seek_timestamp(giter, PMEMSTREAM_FIRST_TIMESTAMP + start_from);
+	UT_ASSERTeq(pmemstream_global_iterator_is_valid(giter), 0);
+
+	const uint64_t *data = pmemstream_entry_data(env.stream, pmemstream_global_iterator_get(giter));
+	UT_ASSERTeq(*data, start_from);
+
+	/* Timestamp after the last entry. */
+	pmemstream_global_iterator_seek_timestamp(giter, pmemstream_committed_timestamp(env.stream) + 1);
+	UT_ASSERTeq(pmemstream_global_iterator_is_valid(giter), -1);
+
+	pmemstream_global_iterator_delete(&giter);
+	pmemstream_test_teardown(env);
+}
+
+void batch_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	allocate_regions(&env, regions);
+	append_round_robin(&env, regions);
+
+	struct pmemstream_global_iterator *giter;
+	int ret = pmemstream_global_iterator_new(&giter, env.stream, regions, REGIONS_COUNT);
+	UT_ASSERTeq(ret, 0);
+
+	struct pmemstream_entry entries[7];
+	const size_t batch_size = sizeof(entries) / sizeof(entries[0]);
+	uint64_t expected = 0;
+
+	pmemstream_global_iterator_seek_first(giter);
+	size_t count;
+	while ((count = pmemstream_global_iterator_get_batch(giter, entries, batch_size)) > 0) {
+		for (size_t i = 0; i < count; i++) {
+			const uint64_t *data = pmemstream_entry_data(env.stream, entries[i]);
+			UT_ASSERTeq(*data, expected);
+			++expected;
+		}
+	}
+	UT_ASSERTeq(expected, REGIONS_COUNT * ENTRIES_PER_REGION);
+	UT_ASSERTeq(pmemstream_global_iterator_is_valid(giter), -1);
+
+	pmemstream_global_iterator_delete(&giter);
+	pmemstream_test_teardown(env);
+}
+
+void empty_regions_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	allocate_regions(&env, regions);
+
+	struct pmemstream_global_iterator *giter;
+	int ret = pmemstream_global_iterator_new(&giter, env.stream, regions, REGIONS_COUNT);
+	UT_ASSERTeq(ret, 0);
+
+	pmemstream_global_iterator_seek_first(giter);
+	UT_ASSERTeq(pmemstream_global_iterator_is_valid(giter), -1);
+
+	pmemstream_global_iterator_delete(&giter);
+	pmemstream_test_teardown(env);
+}
+
+void null_iterator_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	int ret = pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemstream_global_iterator_new(NULL, env.stream, &region, 1);
+	UT_ASSERTeq(ret, -1);
+
+	struct pmemstream_global_iterator *giter = NULL;
+	ret = pmemstream_global_iterator_new(&giter, NULL, &region, 1);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(giter, NULL);
+
+	ret = pmemstream_global_iterator_new(&giter, env.stream, NULL, 1);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(giter, NULL);
+
+	/* It's void, so just check for crash. */
+	pmemstream_global_iterator_seek_first(NULL);
+	pmemstream_global_iterator_seek_timestamp(NULL, PMEMSTREAM_FIRST_TIMESTAMP);
+	pmemstream_global_iterator_next(NULL);
+
+	ret = pmemstream_global_iterator_is_valid(NULL);
+	UT_ASSERTeq(ret, -1);
+
+	struct pmemstream_entry entry = pmemstream_global_iterator_get(NULL);
+	UT_ASSERTeq(entry.offset, PMEMSTREAM_INVALID_OFFSET);
+
+	UT_ASSERTeq(pmemstream_global_iterator_get_batch(NULL, &entry, 1), 0);
+
+	pmemstream_global_iterator_delete(NULL);
+	pmemstream_global_iterator_delete(&giter);
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	valid_input_test(path);
+	all_regions_test(path);
+	seek_timestamp_test(path);
+	batch_test(path);
+	empty_regions_test(path);
+	null_iterator_test(path);
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+/**
+ * region_chained - unit test for pmemstream_region_allocate_chained
+ */
+
+/* Each segment fits only a few entries, so that the region grows many times. */
+#define CHAINED_SEGMENT_SIZE TEST_DEFAULT_BLOCK_SIZE
+#define CHAINED_ENTRY_SIZE 200
+#define CHAINED_ENTRIES_COUNT 500
+
+static size_t count_segments(struct pmemstream *stream, struct pmemstream_region region)
+{
+	size_t count = 0;
+	for (; region.offset != PMEMSTREAM_INVALID_OFFSET; region = region_next_segment(&stream->data, region)) {
+		++count;
+	}
+	return count;
+}
+
+void grow_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_chained(env.stream, CHAINED_SEGMENT_SIZE, &region), 0);
+
+	pmemstream_test_append_entries(env.stream, region, 0, CHAINED_ENTRIES_COUNT, CHAINED_ENTRY_SIZE);
+	pmemstream_test_verify_entries(env.stream, region, 0, CHAINED_ENTRIES_COUNT);
+
+	/* Segments are not visible as separate regions. */
+	size_t segments = count_segments(env.stream, region);
+	UT_ASSERT(segments > 1);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), 1);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), segments);
+
+	/* Appends continue in the last segment after reopen. */
+	pmemstream_test_reopen(&env, path);
+	pmemstream_test_verify_entries(env.stream, region, 0, CHAINED_ENTRIES_COUNT);
+	pmemstream_test_append_entries(env.stream, region, CHAINED_ENTRIES_COUNT, 2 * CHAINED_ENTRIES_COUNT,
+				       CHAINED_ENTRY_SIZE);
+	pmemstream_test_verify_entries(env.stream, region, 0, 2 * CHAINED_ENTRIES_COUNT);
+	UT_ASSERT(count_segments(env.stream, region) > segments);
+
+	/* Entry which does not fit in a single segment cannot be appended. */
+	uint8_t *buffer = calloc(1, 2 * CHAINED_SEGMENT_SIZE);
+	UT_ASSERTne(buffer, NULL);
+	UT_ASSERTeq(pmemstream_append(env.stream, region, NULL, buffer, 2 * CHAINED_SEGMENT_SIZE, NULL), -1);
+	free(buffer);
+
+	/* Segments cannot be used on their own. */
+	struct pmemstream_region segment = region_next_segment(&env.stream->data, region);
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, env.stream, segment), -1);
+	UT_ASSERTeq(pmemstream_region_free(env.stream, segment), -1);
+
+	/* All segments are freed together with the region - whole space can be allocated again. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, region), 0);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 0);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+void regular_region_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	/* Regions which are not chained do not grow. */
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, CHAINED_SEGMENT_SIZE, &region), 0);
+	uint8_t buffer[CHAINED_ENTRY_SIZE] = {0};
+	while (pmemstream_append(env.stream, region, NULL, buffer, sizeof(buffer), NULL) == 0)
+		;
+	UT_ASSERTeq(count_segments(env.stream, region), 1);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 1);
+
+	pmemstream_test_teardown(env);
+}
+
+void free_many_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[2];
+	UT_ASSERTeq(pmemstream_region_allocate_chained(env.stream, CHAINED_SEGMENT_SIZE, &regions[0]), 0);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, CHAINED_SEGMENT_SIZE, &regions[1]), 0);
+	pmemstream_test_append_entries(env.stream, regions[0], 0, CHAINED_ENTRIES_COUNT, CHAINED_ENTRY_SIZE);
+
+	UT_ASSERTeq(pmemstream_region_free_many(env.stream, regions, 2), 0);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+void orphaned_segments_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_chained(env.stream, CHAINED_SEGMENT_SIZE, &region), 0);
+	pmemstream_test_append_entries(env.stream, region, 0, CHAINED_ENTRIES_COUNT, CHAINED_ENTRY_SIZE);
+	size_t segments = count_segments(env.stream, region);
+
+	/* Simulate a crash while growing the region - segment was allocated, but not linked. */
+	uint64_t offset = allocator_region_allocate(
+		&env.stream->region_allocator, &env.stream->data, &env.stream->header->region_allocator_header,
+		CHAINED_SEGMENT_SIZE - sizeof(struct span_region), 0,
+		SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_GROWABLE | SPAN_REGION_CHAIN_CONTINUATION);
+	UT_ASSERTne(offset, PMEMSTREAM_INVALID_OFFSET);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), segments + 1);
+
+	pmemstream_test_reopen(&env, path);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), segments);
+	pmemstream_test_verify_entries(env.stream, region, 0, CHAINED_ENTRIES_COUNT);
+
+	/* Simulate a crash while freeing the region - first segment was freed, the rest was not. */
+	struct pmemstream_region segment = region_next_segment(&env.stream->data, region);
+	allocator_region_free(&env.stream->region_allocator, &env.stream->data,
+			      &env.stream->header->region_allocator_header, region.offset);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), segments - 1);
+	UT_ASSERTeq(count_segments(env.stream, segment), segments - 1);
+
+	pmemstream_test_reopen(&env, path);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 0);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+	char *path = argv[1];
+
+	grow_test(path);
+	regular_region_test(path);
+	free_many_test(path);
+	orphaned_segments_test(path);
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+/**
+ * region_clear - unit test for pmemstream_region_clear
+ */
+
+#define CLEAR_ENTRY_SIZE 200
+#define CLEAR_ENTRIES_COUNT 100
+#define CLEAR_CYCLES 1000
+
+/* Reserves an entry which is never published, so that the region's tail is not stored at close and has to be found
+ * by iterating over the region after reopen. */
+static void reserve_entry(struct pmemstream *stream, struct pmemstream_region region)
+{
+	struct pmemstream_entry reserved_entry;
+	void *reserved_data;
+	UT_ASSERTeq(pmemstream_reserve(stream, region, NULL, CLEAR_ENTRY_SIZE, &reserved_entry, &reserved_data), 0);
+}
+
+void clear_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	size_t initial_usable_size = pmemstream_region_usable_size(env.stream, region);
+
+	/* Region is reused many times, without allocating new regions. */
+	for (uint64_t i = 0; i < CLEAR_CYCLES; i++) {
+		uint64_t count = i % CLEAR_ENTRIES_COUNT + 1;
+		pmemstream_test_append_entries(env.stream, region, i, i + count, CLEAR_ENTRY_SIZE);
+		pmemstream_test_verify_entries(env.stream, region, i, i + count);
+
+		UT_ASSERTeq(pmemstream_region_clear(env.stream, region), 0);
+		pmemstream_test_verify_entries(env.stream, region, 0, 0);
+		UT_ASSERTeq(pmemstream_region_usable_size(env.stream, region), initial_usable_size);
+		UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 1);
+	}
+
+	/* Shorter sequence is appended after the longer one - old entries must not be visible after reopen. */
+	pmemstream_test_append_entries(env.stream, region, 0, CLEAR_ENTRIES_COUNT, CLEAR_ENTRY_SIZE);
+	UT_ASSERTeq(pmemstream_region_clear(env.stream, region), 0);
+	pmemstream_test_append_entries(env.stream, region, 0, 1, CLEAR_ENTRY_SIZE);
+	reserve_entry(env.stream, region);
+	pmemstream_test_reopen(&env, path);
+	pmemstream_test_verify_entries(env.stream, region, 0, 1);
+
+	/* Region cleared before any append in the current session. */
+	UT_ASSERTeq(pmemstream_region_clear(env.stream, region), 0);
+	pmemstream_test_reopen(&env, path);
+	pmemstream_test_verify_entries(env.stream, region, 0, 0);
+	pmemstream_test_append_entries(env.stream, region, 0, 1, CLEAR_ENTRY_SIZE);
+	pmemstream_test_verify_entries(env.stream, region, 0, 1);
+
+	pmemstream_test_teardown(env);
+}
+
+void markers_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	/* Markers set by discarded entries must not be used to find the tail. */
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_markers(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	pmemstream_test_append_entries(env.stream, region, 0, CLEAR_ENTRIES_COUNT, CLEAR_ENTRY_SIZE);
+	UT_ASSERTeq(pmemstream_region_clear(env.stream, region), 0);
+	pmemstream_test_append_entries(env.stream, region, 0, 1, CLEAR_ENTRY_SIZE);
+
+	reserve_entry(env.stream, region);
+	pmemstream_test_reopen(&env, path);
+	pmemstream_test_verify_entries(env.stream, region, 0, 1);
+
+	pmemstream_test_teardown(env);
+}
+
+void chained_and_ring_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region chained_region;
+	UT_ASSERTeq(pmemstream_region_allocate_chained(env.stream, TEST_DEFAULT_BLOCK_SIZE, &chained_region), 0);
+	pmemstream_test_append_entries(env.stream, chained_region, 0, CLEAR_ENTRIES_COUNT, CLEAR_ENTRY_SIZE);
+	UT_ASSERT(pmemstream_test_count_allocated(env.stream) > 1);
+
+	/* All segments but the first one are freed. */
+	UT_ASSERTeq(pmemstream_region_clear(env.stream, chained_region), 0);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 1);
+	pmemstream_test_verify_entries(env.stream, chained_region, 0, 0);
+	pmemstream_test_append_entries(env.stream, chained_region, 0, CLEAR_ENTRIES_COUNT, CLEAR_ENTRY_SIZE);
+	pmemstream_test_verify_entries(env.stream, chained_region, 0, CLEAR_ENTRIES_COUNT);
+
+	struct pmemstream_region ring_region;
+	UT_ASSERTeq(pmemstream_region_allocate_ring(env.stream, TEST_DEFAULT_BLOCK_SIZE, &ring_region), 0);
+	pmemstream_test_append_entries(env.stream, ring_region, 0, 10, CLEAR_ENTRY_SIZE);
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, env.stream, ring_region), 0);
+	pmemstream_entry_iterator_seek_first(eiter);
+	pmemstream_entry_iterator_next(eiter);
+	UT_ASSERTeq(pmemstream_region_trim(env.stream, ring_region, pmemstream_entry_iterator_get(eiter)), 0);
+	pmemstream_entry_iterator_delete(&eiter);
+
+	/* Head is moved to the region's beginning. */
+	UT_ASSERTeq(pmemstream_region_clear(env.stream, ring_region), 0);
+	pmemstream_test_append_entries(env.stream, ring_region, 0, 5, CLEAR_ENTRY_SIZE);
+	reserve_entry(env.stream, ring_region);
+	pmemstream_test_reopen(&env, path);
+	pmemstream_test_verify_entries(env.stream, ring_region, 0, 5);
+	pmemstream_test_verify_entries(env.stream, chained_region, 0, CLEAR_ENTRIES_COUNT);
+
+	pmemstream_test_teardown(env);
+}
+
+void invalid_input_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	UT_ASSERTeq(pmemstream_region_clear(NULL, region), -1);
+
+	struct pmemstream_region invalid_region = {.offset = PMEMSTREAM_INVALID_OFFSET};
+	UT_ASSERTeq(pmemstream_region_clear(env.stream, invalid_region), -1);
+
+	/* Region with a reserved (not yet published) entry cannot be cleared. */
+	struct pmemstream_entry reserved_entry;
+	void *reserved_data;
+	UT_ASSERTeq(pmemstream_reserve(env.stream, region, NULL, CLEAR_ENTRY_SIZE, &reserved_entry, &reserved_data), 0);
+	UT_ASSERTeq(pmemstream_region_clear(env.stream, region), -1);
+	UT_ASSERTeq(pmemstream_publish(env.stream, region, NULL, reserved_entry, CLEAR_ENTRY_SIZE), 0);
+	UT_ASSERTeq(pmemstream_region_clear(env.stream, region), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+	char *path = argv[1];
+
+	clear_test(path);
+	markers_test(path);
+	chained_and_ring_test(path);
+	invalid_input_test(path);
+
+	return 0;
+}
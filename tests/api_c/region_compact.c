@@ -0,0 +1,278 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+/**
+ * region_compact - unit test for pmemstream_region_compact
+ */
+
+#define COMPACT_ENTRY_SIZE 200
+#define COMPACT_ENTRIES_COUNT 100
+
+/* Keeps entries with values divisible by '*ctx'. */
+static int keep_divisible(struct pmemstream *stream, struct pmemstream_entry entry, void *ctx)
+{
+	uint64_t divisor = *(const uint64_t *)ctx;
+	return *(const uint64_t *)pmemstream_entry_data(stream, entry) % divisor == 0;
+}
+
+static int keep_none(struct pmemstream *stream, struct pmemstream_entry entry, void *ctx)
+{
+	(void)stream;
+	(void)entry;
+	(void)ctx;
+	return 0;
+}
+
+/* Verifies that region contains entries with values from range [begin, end) divisible by 'divisor'. */
+static void verify_entries(struct pmemstream *stream, struct pmemstream_region region, uint64_t begin, uint64_t end,
+			   uint64_t divisor)
+{
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, stream, region), 0);
+
+	uint64_t value = begin;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), COMPACT_ENTRY_SIZE);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, entry), value);
+		value += divisor;
+	}
+	UT_ASSERT(value >= end);
+	UT_ASSERT(value < end + divisor);
+
+	pmemstream_entry_iterator_delete(&eiter);
+}
+
+/* Reserves an entry which is never published, so that the region's tail is not stored at close and has to be found
+ * by iterating over the region after reopen. */
+static void reserve_entry(struct pmemstream *stream, struct pmemstream_region region)
+{
+	struct pmemstream_entry reserved_entry;
+	void *reserved_data;
+	UT_ASSERTeq(pmemstream_reserve(stream, region, NULL, COMPACT_ENTRY_SIZE, &reserved_entry, &reserved_data), 0);
+}
+
+void compact_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	size_t region_size = pmemstream_region_size(env.stream, region);
+	pmemstream_test_append_entries(env.stream, region, 0, COMPACT_ENTRIES_COUNT, COMPACT_ENTRY_SIZE);
+	size_t usable_size = pmemstream_region_usable_size(env.stream, region);
+
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, env.stream, region), 0);
+	pmemstream_entry_iterator_seek_first(eiter);
+	uint64_t first_timestamp = pmemstream_entry_timestamp(env.stream, pmemstream_entry_iterator_get(eiter));
+	pmemstream_entry_iterator_delete(&eiter);
+
+	/* Runs of consecutive kept entries are interleaved with discarded ones. */
+	uint64_t divisor = 3;
+	struct pmemstream_region compacted;
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, region, &compacted, keep_divisible, &divisor), 0);
+	verify_entries(env.stream, compacted, 0, COMPACT_ENTRIES_COUNT, divisor);
+	UT_ASSERTeq(pmemstream_region_size(env.stream, compacted), region_size);
+	UT_ASSERT(pmemstream_region_usable_size(env.stream, compacted) > usable_size);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 1);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), 1);
+
+	/* Timestamps are preserved. */
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, env.stream, compacted), 0);
+	pmemstream_entry_iterator_seek_first(eiter);
+	UT_ASSERTeq(pmemstream_entry_timestamp(env.stream, pmemstream_entry_iterator_get(eiter)), first_timestamp);
+	pmemstream_entry_iterator_delete(&eiter);
+
+	/* New region can be appended to, also after reopen. */
+	pmemstream_test_append_entries(env.stream, compacted, COMPACT_ENTRIES_COUNT + 2, COMPACT_ENTRIES_COUNT + 3,
+				       COMPACT_ENTRY_SIZE);
+	verify_entries(env.stream, compacted, 0, COMPACT_ENTRIES_COUNT + 3, divisor);
+	reserve_entry(env.stream, compacted);
+	pmemstream_test_reopen(&env, path);
+	verify_entries(env.stream, compacted, 0, COMPACT_ENTRIES_COUNT + 3, divisor);
+
+	/* Region can be compacted to an empty one - stale entries must not be visible after reopen. */
+	struct pmemstream_region empty;
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, compacted, &empty, keep_none, NULL), 0);
+	verify_entries(env.stream, empty, 0, 0, 1);
+	reserve_entry(env.stream, empty);
+	pmemstream_test_reopen(&env, path);
+	verify_entries(env.stream, empty, 0, 0, 1);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 1);
+
+	pmemstream_test_teardown(env);
+}
+
+void markers_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_markers(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	pmemstream_test_append_entries(env.stream, region, 0, COMPACT_ENTRIES_COUNT, COMPACT_ENTRY_SIZE);
+
+	uint64_t divisor = 2;
+	struct pmemstream_region compacted;
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, region, &compacted, keep_divisible, &divisor), 0);
+
+	/* Tail of the new region is found using its markers. */
+	reserve_entry(env.stream, compacted);
+	pmemstream_test_reopen(&env, path);
+	verify_entries(env.stream, compacted, 0, COMPACT_ENTRIES_COUNT, divisor);
+	pmemstream_test_append_entries(env.stream, compacted, COMPACT_ENTRIES_COUNT, COMPACT_ENTRIES_COUNT + 1,
+				       COMPACT_ENTRY_SIZE);
+	verify_entries(env.stream, compacted, 0, COMPACT_ENTRIES_COUNT + 1, divisor);
+
+	pmemstream_test_teardown(env);
+}
+
+void interrupted_compaction_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	pmemstream_test_append_entries(env.stream, region, 0, COMPACT_ENTRIES_COUNT, COMPACT_ENTRY_SIZE);
+	struct span_region *span_region =
+		(struct span_region *)span_offset_to_span_ptr(&env.stream->data, region.offset);
+	size_t size = span_get_size(&span_region->span_base);
+
+	/* Simulate a crash before the compaction is committed - new region was allocated, but not linked. */
+	uint64_t offset = allocator_region_allocate(&env.stream->region_allocator, &env.stream->data,
+						    &env.stream->header->region_allocator_header, size, 0,
+						    SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_CONTINUATION);
+	UT_ASSERTne(offset, PMEMSTREAM_INVALID_OFFSET);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 2);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), 1);
+
+	pmemstream_test_reopen(&env, path);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 1);
+	verify_entries(env.stream, region, 0, COMPACT_ENTRIES_COUNT, 1);
+
+	/* Simulate a crash after the compaction is committed - old region is linked to the new one, but not freed. */
+	offset = allocator_region_allocate(&env.stream->region_allocator, &env.stream->data,
+					   &env.stream->header->region_allocator_header, size, 0,
+					   SPAN_REGION_CHAIN_NO_NEXT | SPAN_REGION_CHAIN_CONTINUATION);
+	UT_ASSERTne(offset, PMEMSTREAM_INVALID_OFFSET);
+	span_region = (struct span_region *)span_offset_to_span_ptr(&env.stream->data, region.offset);
+	span_region->chain = offset | SPAN_REGION_CHAIN_COMPACTED;
+	env.stream->data.persist(&span_region->chain, sizeof(span_region->chain));
+
+	pmemstream_test_reopen(&env, path);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 1);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), 1);
+
+	struct pmemstream_region_iterator *riter;
+	UT_ASSERTeq(pmemstream_region_iterator_new(&riter, env.stream), 0);
+	pmemstream_region_iterator_seek_first(riter);
+	struct pmemstream_region compacted = pmemstream_region_iterator_get(riter);
+	pmemstream_region_iterator_delete(&riter);
+	UT_ASSERTeq(compacted.offset, offset);
+	verify_entries(env.stream, compacted, 0, 0, 1);
+
+	pmemstream_test_teardown(env);
+}
+
+struct append_during_compaction_ctx {
+	struct pmemstream_region region;
+	size_t appends_failed;
+};
+
+/* Keeps all entries, trying to append a new one to the compacted region for each of them. */
+static int keep_and_append(struct pmemstream *stream, struct pmemstream_entry entry, void *ctx)
+{
+	(void)entry;
+	struct append_during_compaction_ctx *compaction_ctx = ctx;
+	uint64_t value = UINT64_MAX;
+	if (pmemstream_append(stream, compaction_ctx->region, NULL, &value, sizeof(value), NULL) != 0) {
+		++compaction_ctx->appends_failed;
+	}
+	return 1;
+}
+
+void append_during_compaction_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	pmemstream_test_append_entries(env.stream, region, 0, COMPACT_ENTRIES_COUNT, COMPACT_ENTRY_SIZE);
+
+	/* Appends to the region fail while it is compacted - otherwise, they would be lost. */
+	struct append_during_compaction_ctx ctx = {.region = region, .appends_failed = 0};
+	struct pmemstream_region compacted;
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, region, &compacted, keep_and_append, &ctx), 0);
+	UT_ASSERTeq(ctx.appends_failed, COMPACT_ENTRIES_COUNT);
+	verify_entries(env.stream, compacted, 0, COMPACT_ENTRIES_COUNT, 1);
+
+	pmemstream_test_append_entries(env.stream, compacted, COMPACT_ENTRIES_COUNT, COMPACT_ENTRIES_COUNT + 1,
+				       COMPACT_ENTRY_SIZE);
+	verify_entries(env.stream, compacted, 0, COMPACT_ENTRIES_COUNT + 1, 1);
+
+	pmemstream_test_teardown(env);
+}
+
+void invalid_input_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	pmemstream_test_append_entries(env.stream, region, 0, COMPACT_ENTRIES_COUNT, COMPACT_ENTRY_SIZE);
+
+	uint64_t divisor = 2;
+	struct pmemstream_region compacted;
+	UT_ASSERTeq(pmemstream_region_compact(NULL, region, &compacted, keep_divisible, &divisor), -1);
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, region, NULL, keep_divisible, &divisor), -1);
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, region, &compacted, NULL, &divisor), -1);
+
+	struct pmemstream_region invalid_region = {.offset = PMEMSTREAM_INVALID_OFFSET};
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, invalid_region, &compacted, keep_divisible, &divisor), -1);
+
+	/* Region with a reserved (not yet published) entry cannot be compacted. */
+	struct pmemstream_entry reserved_entry;
+	void *reserved_data;
+	UT_ASSERTeq(pmemstream_reserve(env.stream, region, NULL, COMPACT_ENTRY_SIZE, &reserved_entry, &reserved_data),
+		    0);
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, region, &compacted, keep_divisible, &divisor), -1);
+	UT_ASSERTeq(pmemstream_publish(env.stream, region, NULL, reserved_entry, COMPACT_ENTRY_SIZE), 0);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 1);
+
+	/* Region can be appended to after a failed compaction. */
+	pmemstream_test_append_entries(env.stream, region, 0, 1, COMPACT_ENTRY_SIZE);
+
+	/* Chained and ring regions cannot be compacted. */
+	struct pmemstream_region chained_region;
+	UT_ASSERTeq(pmemstream_region_allocate_chained(env.stream, TEST_DEFAULT_BLOCK_SIZE, &chained_region), 0);
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, chained_region, &compacted, keep_divisible, &divisor), -1);
+	struct pmemstream_region ring_region;
+	UT_ASSERTeq(pmemstream_region_allocate_ring(env.stream, TEST_DEFAULT_BLOCK_SIZE, &ring_region), 0);
+	UT_ASSERTeq(pmemstream_region_compact(env.stream, ring_region, &compacted, keep_divisible, &divisor), -1);
+	UT_ASSERTeq(pmemstream_test_count_allocated(env.stream), 3);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+	char *path = argv[1];
+
+	compact_test(path);
+	markers_test(path);
+	interrupted_compaction_test(path);
+	append_during_compaction_test(path);
+	invalid_input_test(path);
+
+	return 0;
+}
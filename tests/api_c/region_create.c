@@ -8,6 +8,7 @@
 
 /**
  * region_create - unit test for pmemstream_region_allocate, pmemstream_region_free,
+ *					pmemstream_region_allocate_many, pmemstream_region_free_many,
  *					pmemstream_region_size, pmemstream_region_usable_size,
  *					pmemstream_region_runtime_initialize
  */
@@ -35,6 +36,230 @@ void valid_input_test(char *path)
 	pmemstream_test_teardown(env);
 }
 
+void variable_size_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	const size_t sizes[] = {TEST_DEFAULT_BLOCK_SIZE, 3 * TEST_DEFAULT_BLOCK_SIZE, 10 * TEST_DEFAULT_BLOCK_SIZE,
+				TEST_DEFAULT_REGION_MULTI_SIZE, 1};
+	const size_t count = sizeof(sizes) / sizeof(sizes[0]);
+	struct pmemstream_region regions[sizeof(sizes) / sizeof(sizes[0])];
+
+	for (size_t i = 0; i < count; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(env.stream, sizes[i], &regions[i]), 0);
+		UT_ASSERT(pmemstream_region_size(env.stream, regions[i]) >= sizes[i]);
+		UT_ASSERTeq(pmemstream_append(env.stream, regions[i], NULL, &i, sizeof(i), NULL), 0);
+	}
+
+	/* Freed region is reused by an allocation of the same size. */
+	size_t freed_size = pmemstream_region_size(env.stream, regions[2]);
+	UT_ASSERTeq(pmemstream_region_free(env.stream, regions[2]), 0);
+	struct pmemstream_region reused;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, sizes[2], &reused), 0);
+	UT_ASSERTeq(reused.offset, regions[2].offset);
+	UT_ASSERTeq(pmemstream_region_size(env.stream, reused), freed_size);
+
+	/* ... but not by a bigger one. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, regions[1]), 0);
+	struct pmemstream_region bigger;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, 2 * sizes[1], &bigger), 0);
+	UT_ASSERTne(bigger.offset, regions[1].offset);
+	UT_ASSERT(pmemstream_region_size(env.stream, bigger) >= 2 * sizes[1]);
+
+	/* Sizes and data of regions are preserved after reopen. */
+	pmemstream_test_reopen(&env, path);
+	for (size_t i = 0; i < count; i++) {
+		if (i == 1 || i == 2) {
+			continue;
+		}
+		UT_ASSERT(pmemstream_region_size(env.stream, regions[i]) >= sizes[i]);
+
+		struct pmemstream_entry_iterator *eiter;
+		UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, env.stream, regions[i]), 0);
+		pmemstream_entry_iterator_seek_first(eiter);
+		UT_ASSERTeq(pmemstream_entry_iterator_is_valid(eiter), 0);
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(*(const size_t *)pmemstream_entry_data(env.stream, entry), i);
+		pmemstream_entry_iterator_delete(&eiter);
+	}
+
+	/* Free lists are persistent - freed region is reused after reopen. */
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, sizes[1], &reused), 0);
+	UT_ASSERTeq(reused.offset, regions[1].offset);
+
+	pmemstream_test_teardown(env);
+}
+
+void merge_split_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[4];
+	for (size_t i = 0; i < 4; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_BLOCK_SIZE, &regions[i]), 0);
+	}
+	size_t region_size = pmemstream_region_size(env.stream, regions[0]);
+
+	/* Adjacent free regions are merged - allocation of their combined size fits in. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, regions[1]), 0);
+	UT_ASSERTeq(pmemstream_region_free(env.stream, regions[0]), 0);
+	struct pmemstream_region merged;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, 2 * region_size, &merged), 0);
+	UT_ASSERTeq(merged.offset, regions[0].offset);
+
+	/* Free region is split - smaller allocations get exactly the requested size. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, merged), 0);
+	struct pmemstream_region split[2];
+	for (size_t i = 0; i < 2; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_BLOCK_SIZE, &split[i]), 0);
+		UT_ASSERTeq(split[i].offset, regions[i].offset);
+		UT_ASSERTeq(pmemstream_region_size(env.stream, split[i]), region_size);
+	}
+
+	/* Free space at the end of the stream is given back - bigger region can be allocated in its place. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, regions[3]), 0);
+	struct pmemstream_region bigger;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, 4 * region_size, &bigger), 0);
+	UT_ASSERTeq(bigger.offset, regions[3].offset);
+
+	/* Merged regions stay merged after reopen. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, split[0]), 0);
+	UT_ASSERTeq(pmemstream_region_free(env.stream, split[1]), 0);
+	UT_ASSERTeq(pmemstream_region_free(env.stream, regions[2]), 0);
+	pmemstream_test_reopen(&env, path);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, 3 * region_size, &merged), 0);
+	UT_ASSERTeq(merged.offset, regions[0].offset);
+
+	pmemstream_test_teardown(env);
+}
+
+void best_fit_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region big, small, separators[3];
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_BLOCK_SIZE, &separators[0]), 0);
+	size_t region_size = pmemstream_region_size(env.stream, separators[0]);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, 4 * region_size, &big), 0);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, region_size, &separators[1]), 0);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, region_size, &small), 0);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, region_size, &separators[2]), 0);
+
+	/* The smallest fitting free region is used, even if a bigger one was freed before it. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, big), 0);
+	UT_ASSERTeq(pmemstream_region_free(env.stream, small), 0);
+	struct pmemstream_region reused;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, region_size, &reused), 0);
+	UT_ASSERTeq(reused.offset, small.offset);
+
+	/* Size index is rebuilt at open. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, reused), 0);
+	pmemstream_test_reopen(&env, path);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, region_size, &reused), 0);
+	UT_ASSERTeq(reused.offset, small.offset);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, 4 * region_size, &reused), 0);
+	UT_ASSERTeq(reused.offset, big.offset);
+
+	pmemstream_test_teardown(env);
+}
+
+#define FREE_ORDER_REGIONS_COUNT 64
+
+void free_order_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[FREE_ORDER_REGIONS_COUNT];
+	for (size_t i = 0; i < FREE_ORDER_REGIONS_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_BLOCK_SIZE, &regions[i]), 0);
+	}
+
+	/* Free regions from the middle, the head and the tail of the allocated list. */
+	size_t count = FREE_ORDER_REGIONS_COUNT;
+	for (size_t i = 1; i < FREE_ORDER_REGIONS_COUNT; i += 2) {
+		UT_ASSERTeq(pmemstream_region_free(env.stream, regions[i]), 0);
+		UT_ASSERTeq(pmemstream_test_count_regions(env.stream), --count);
+	}
+	UT_ASSERTeq(pmemstream_region_free(env.stream, regions[0]), 0);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), --count);
+
+	/* Freeing works the same after reopen. */
+	pmemstream_test_reopen(&env, path);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), count);
+	for (size_t i = FREE_ORDER_REGIONS_COUNT - 2; i > 0; i -= 2) {
+		UT_ASSERTeq(pmemstream_region_free(env.stream, regions[i]), 0);
+		UT_ASSERTeq(pmemstream_test_count_regions(env.stream), --count);
+	}
+	UT_ASSERTeq(count, 0);
+
+	pmemstream_test_teardown(env);
+}
+
+#define MANY_REGIONS_COUNT 100
+
+void many_regions_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[MANY_REGIONS_COUNT];
+	int ret = pmemstream_region_allocate_many(env.stream, TEST_DEFAULT_BLOCK_SIZE, MANY_REGIONS_COUNT, regions);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), MANY_REGIONS_COUNT);
+	for (size_t i = 0; i < MANY_REGIONS_COUNT; i++) {
+		UT_ASSERT(pmemstream_region_size(env.stream, regions[i]) >= TEST_DEFAULT_BLOCK_SIZE);
+		UT_ASSERTeq(pmemstream_append(env.stream, regions[i], NULL, &i, sizeof(i), NULL), 0);
+	}
+
+	/* Regions allocated at once are independent - each can be freed separately. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, regions[MANY_REGIONS_COUNT / 2]), 0);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), MANY_REGIONS_COUNT - 1);
+
+	/* Every other region is freed at once, the rest of them (and their entries) stay intact after reopen. */
+	struct pmemstream_region to_free[MANY_REGIONS_COUNT / 2 - 1];
+	size_t to_free_count = 0;
+	for (size_t i = 0; i < MANY_REGIONS_COUNT; i += 2) {
+		if (i != MANY_REGIONS_COUNT / 2) {
+			to_free[to_free_count++] = regions[i];
+		}
+	}
+	UT_ASSERTeq(pmemstream_region_free_many(env.stream, to_free, to_free_count), 0);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), MANY_REGIONS_COUNT / 2);
+
+	pmemstream_test_reopen(&env, path);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), MANY_REGIONS_COUNT / 2);
+	for (size_t i = 1; i < MANY_REGIONS_COUNT; i += 2) {
+		struct pmemstream_entry_iterator *eiter;
+		UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, env.stream, regions[i]), 0);
+		pmemstream_entry_iterator_seek_first(eiter);
+		UT_ASSERTeq(pmemstream_entry_iterator_is_valid(eiter), 0);
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(*(const size_t *)pmemstream_entry_data(env.stream, entry), i);
+		pmemstream_entry_iterator_delete(&eiter);
+	}
+
+	/* Freed space is reused by the next batch. */
+	struct pmemstream_region reused[MANY_REGIONS_COUNT / 2];
+	ret = pmemstream_region_allocate_many(env.stream, TEST_DEFAULT_BLOCK_SIZE, MANY_REGIONS_COUNT / 2, reused);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), MANY_REGIONS_COUNT);
+
+	UT_ASSERTeq(pmemstream_region_free_many(env.stream, regions + 1, 1), 0);
+	UT_ASSERTeq(pmemstream_region_free_many(env.stream, NULL, 0), 0);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), MANY_REGIONS_COUNT - 1);
+
+	/* Invalid arguments. */
+	UT_ASSERTeq(pmemstream_region_allocate_many(NULL, TEST_DEFAULT_BLOCK_SIZE, 1, reused), -1);
+	UT_ASSERTeq(pmemstream_region_allocate_many(env.stream, 0, 1, reused), -1);
+	UT_ASSERTeq(pmemstream_region_allocate_many(env.stream, TEST_DEFAULT_BLOCK_SIZE, 0, reused), -1);
+	UT_ASSERTeq(pmemstream_region_allocate_many(env.stream, TEST_DEFAULT_BLOCK_SIZE, 1, NULL), -1);
+	UT_ASSERTeq(pmemstream_region_allocate_many(env.stream, TEST_DEFAULT_STREAM_SIZE, 2, reused), -1);
+	UT_ASSERTeq(pmemstream_region_free_many(NULL, reused, 1), -1);
+	UT_ASSERTeq(pmemstream_region_free_many(env.stream, NULL, 1), -1);
+	UT_ASSERTeq(pmemstream_test_count_regions(env.stream), MANY_REGIONS_COUNT - 1);
+
+	pmemstream_test_teardown(env);
+}
+
 void null_stream_test(char *path)
 {
 	pmemstream_test_env env = pmemstream_test_make_default(path);
@@ -101,6 +326,11 @@ int main(int argc, char *argv[])
 	char *path = argv[1];
 
 	valid_input_test(path);
+	variable_size_test(path);
+	merge_split_test(path);
+	best_fit_test(path);
+	free_order_test(path);
+	many_regions_test(path);
 	null_stream_test(path);
 	zero_size_test(path);
 	invalid_region_test(path);
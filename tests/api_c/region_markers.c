@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+/**
+ * region_markers - unit test for pmemstream_region_allocate_with_markers (including reverse iteration over regions
+ *			with markers)
+ */
+
+/* Enough entries to span many blocks. */
+#define MARKERS_ENTRIES_COUNT 1000
+
+#define MARKERS_MAX_ENTRY_SIZE (sizeof(uint64_t) + 2 * TEST_DEFAULT_BLOCK_SIZE)
+
+/* Sizes vary, so that entries start at different offsets within blocks (and some span multiple blocks). */
+static size_t entry_size(uint64_t idx)
+{
+	if (idx % 100 == 0) {
+		return MARKERS_MAX_ENTRY_SIZE;
+	}
+	return sizeof(uint64_t) + (idx * 37) % 1000;
+}
+
+static void append_entries(struct pmemstream *stream, struct pmemstream_region region, uint64_t begin, uint64_t end)
+{
+	uint8_t *buffer = calloc(1, MARKERS_MAX_ENTRY_SIZE);
+	UT_ASSERTne(buffer, NULL);
+
+	for (uint64_t i = begin; i < end; i++) {
+		*(uint64_t *)buffer = i;
+		UT_ASSERTeq(pmemstream_append(stream, region, NULL, buffer, entry_size(i), NULL), 0);
+	}
+
+	free(buffer);
+}
+
+static uint64_t verify_entries(struct pmemstream *stream, struct pmemstream_region region)
+{
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, stream, region), 0);
+
+	uint64_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, entry), count);
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), entry_size(count));
+		++count;
+	}
+
+	pmemstream_entry_iterator_delete(&eiter);
+	return count;
+}
+
+/* Reads all entries in the reverse order (markers are used for finding the preceding entries). */
+static void verify_entries_reverse(struct pmemstream *stream, struct pmemstream_region region, uint64_t count)
+{
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, stream, region), 0);
+
+	uint64_t idx = count;
+	for (pmemstream_entry_iterator_seek_last(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_prev(eiter)) {
+		UT_ASSERT(idx > 0);
+		--idx;
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, entry), idx);
+		UT_ASSERTeq(pmemstream_entry_size(stream, entry), entry_size(idx));
+	}
+	UT_ASSERTeq(idx, 0);
+
+	pmemstream_entry_iterator_delete(&eiter);
+}
+
+void valid_input_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_markers(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+
+	/* Markers are stored inside the region. */
+	size_t region_size = pmemstream_region_size(env.stream, region);
+	UT_ASSERT(region_size >= TEST_DEFAULT_REGION_SIZE);
+	UT_ASSERT(pmemstream_region_usable_size(env.stream, region) < region_size);
+
+	append_entries(env.stream, region, 0, MARKERS_ENTRIES_COUNT);
+	UT_ASSERTeq(verify_entries(env.stream, region), MARKERS_ENTRIES_COUNT);
+
+	/* Tail is found using markers - appends continue right after the last entry. */
+	pmemstream_test_reopen(&env, path);
+	verify_entries_reverse(env.stream, region, MARKERS_ENTRIES_COUNT);
+	append_entries(env.stream, region, MARKERS_ENTRIES_COUNT, MARKERS_ENTRIES_COUNT + 1);
+	UT_ASSERTeq(verify_entries(env.stream, region), MARKERS_ENTRIES_COUNT + 1);
+	verify_entries_reverse(env.stream, region, MARKERS_ENTRIES_COUNT + 1);
+
+	/* Entries can be appended until the region is full. */
+	uint8_t buffer[1024] = {0};
+	uint64_t count = MARKERS_ENTRIES_COUNT + 1;
+	while (pmemstream_append(env.stream, region, NULL, buffer, sizeof(buffer), NULL) == 0) {
+		++count;
+	}
+	pmemstream_test_reopen(&env, path);
+
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, env.stream, region), 0);
+	uint64_t read_count = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		++read_count;
+	}
+	pmemstream_entry_iterator_delete(&eiter);
+	UT_ASSERTeq(read_count, count);
+
+	pmemstream_test_teardown(env);
+}
+
+void lost_markers_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_markers(env.stream, TEST_DEFAULT_REGION_SIZE, &region), 0);
+	append_entries(env.stream, region, 0, MARKERS_ENTRIES_COUNT);
+
+	/* Simulate markers which were not persisted - recovery should fall back to iterating. */
+	struct span_region_block_marker *markers = (struct span_region_block_marker *)pmemstream_offset_to_ptr(
+		&env.stream->data, region_data_end_offset(&env.stream->data, region));
+	for (size_t i = 0; i < 64; i += 3) {
+		markers[i].timestamp = PMEMSTREAM_INVALID_TIMESTAMP;
+	}
+	markers[1].entry_offset = 0;
+	env.stream->data.persist(markers, 64 * sizeof(*markers));
+
+	pmemstream_test_reopen(&env, path);
+	verify_entries_reverse(env.stream, region, MARKERS_ENTRIES_COUNT);
+	append_entries(env.stream, region, MARKERS_ENTRIES_COUNT, MARKERS_ENTRIES_COUNT + 1);
+	UT_ASSERTeq(verify_entries(env.stream, region), MARKERS_ENTRIES_COUNT + 1);
+
+	pmemstream_test_teardown(env);
+}
+
+void mixed_regions_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region with_markers, without_markers;
+	UT_ASSERTeq(pmemstream_region_allocate_with_markers(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &with_markers),
+		    0);
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &without_markers), 0);
+	UT_ASSERTeq(pmemstream_region_usable_size(env.stream, without_markers),
+		    pmemstream_region_size(env.stream, without_markers));
+
+	append_entries(env.stream, with_markers, 0, MARKERS_ENTRIES_COUNT / 10);
+	append_entries(env.stream, without_markers, 0, MARKERS_ENTRIES_COUNT / 10);
+
+	/* Region reused after free does not inherit markers. */
+	UT_ASSERTeq(pmemstream_region_free(env.stream, with_markers), 0);
+	struct pmemstream_region reused;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, TEST_DEFAULT_REGION_MULTI_SIZE, &reused), 0);
+	UT_ASSERTeq(pmemstream_region_usable_size(env.stream, reused), pmemstream_region_size(env.stream, reused));
+
+	pmemstream_test_reopen(&env, path);
+	UT_ASSERTeq(verify_entries(env.stream, without_markers), MARKERS_ENTRIES_COUNT / 10);
+	UT_ASSERTeq(verify_entries(env.stream, reused), 0);
+
+	pmemstream_test_teardown(env);
+}
+
+void null_stream_test(char *path)
+{
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_with_markers(NULL, TEST_DEFAULT_REGION_SIZE, &region), -1);
+
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+	UT_ASSERTeq(pmemstream_region_allocate_with_markers(env.stream, 0, &region), -1);
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+	char *path = argv[1];
+
+	valid_input_test(path);
+	lost_markers_test(path);
+	mixed_regions_test(path);
+	null_stream_test(path);
+
+	return 0;
+}
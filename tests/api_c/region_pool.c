@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "libpmemstream_internal.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * region_pool - unit test for pmemstream_config_set_region_pool
+ */
+
+#define POOL_REGION_SIZE TEST_DEFAULT_BLOCK_SIZE
+#define POOL_CAPACITY 4
+#define POOL_REGIONS_COUNT 16
+#define POOL_ENTRY_SIZE 200
+#define POOL_ENTRIES_COUNT 50
+
+static struct pmemstream_config *make_pool_config(void)
+{
+	struct pmemstream_config *config;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	UT_ASSERTeq(pmemstream_config_set_block_size(config, TEST_DEFAULT_BLOCK_SIZE), 0);
+	UT_ASSERTeq(pmemstream_config_set_region_pool(config, POOL_REGION_SIZE, POOL_CAPACITY), 0);
+	return config;
+}
+
+static struct pmemstream *open_with_pool(struct pmem2_map *map)
+{
+	struct pmemstream_config *config = make_pool_config();
+	struct pmemstream *stream;
+	UT_ASSERTeq(pmemstream_from_config(&stream, map, config), 0);
+	pmemstream_config_delete(&config);
+	return stream;
+}
+
+/* Counts all allocated regions, including pooled ones. Pool is filled concurrently, so the allocator lock is held. */
+static size_t count_allocated(struct pmemstream *stream)
+{
+	size_t count = 0;
+	uint64_t offset;
+	pthread_mutex_lock(&stream->region_allocator.lock);
+	SLIST_FOREACH(struct span_region, &stream->data, &stream->header->region_allocator_header.allocated_list,
+		      offset, allocator_entry_metadata.next_allocated)
+	{
+		++count;
+	}
+	pthread_mutex_unlock(&stream->region_allocator.lock);
+	return count;
+}
+
+/* Waits until the worker fills the pool. Regions are iterated over meanwhile - pooled regions must never become
+ * visible, even while the worker modifies the list of allocated regions. */
+static void wait_for_allocated(struct pmemstream *stream, size_t count, size_t visible_regions)
+{
+	while (count_allocated(stream) < count) {
+		UT_ASSERTeq(pmemstream_test_count_regions(stream), visible_regions);
+		sched_yield();
+	}
+	UT_ASSERTeq(count_allocated(stream), count);
+}
+
+static void verify_regions(struct pmemstream *stream, struct pmemstream_region *regions)
+{
+	for (size_t i = 0; i < POOL_REGIONS_COUNT - 1; i++) {
+		pmemstream_test_verify_entries(stream, regions[i], 0, 1);
+	}
+	pmemstream_test_verify_entries(stream, regions[POOL_REGIONS_COUNT - 1], 0, POOL_ENTRIES_COUNT);
+}
+
+void pool_test(char *path)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+	struct pmemstream *stream = open_with_pool(map);
+
+	/* Pooled regions are not visible to the application. */
+	wait_for_allocated(stream, POOL_CAPACITY, 0);
+	UT_ASSERTeq(pmemstream_test_count_regions(stream), 0);
+
+	/* Regions of the pool's size (and segments of chained regions) are taken from the pool, other ones are
+	 * allocated directly. */
+	struct pmemstream_region regions[POOL_REGIONS_COUNT];
+	for (size_t i = 0; i < POOL_REGIONS_COUNT - 2; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(stream, POOL_REGION_SIZE, &regions[i]), 0);
+	}
+	struct pmemstream_region *direct = &regions[POOL_REGIONS_COUNT - 2];
+	UT_ASSERTeq(pmemstream_region_allocate(stream, TEST_DEFAULT_REGION_MULTI_SIZE, direct), 0);
+	UT_ASSERTeq(pmemstream_region_allocate_chained(stream, POOL_REGION_SIZE, &regions[POOL_REGIONS_COUNT - 1]), 0);
+
+	for (size_t i = 0; i < POOL_REGIONS_COUNT - 1; i++) {
+		pmemstream_test_append_entries(stream, regions[i], 0, 1, POOL_ENTRY_SIZE);
+	}
+	pmemstream_test_append_entries(stream, regions[POOL_REGIONS_COUNT - 1], 0, POOL_ENTRIES_COUNT, POOL_ENTRY_SIZE);
+
+	size_t segments = 0;
+	for (struct pmemstream_region segment = regions[POOL_REGIONS_COUNT - 1];
+	     segment.offset != PMEMSTREAM_INVALID_OFFSET; segment = region_next_segment(&stream->data, segment)) {
+		++segments;
+	}
+	UT_ASSERT(segments > 1);
+
+	/* Regions can be iterated over while the pool is refilled in the background. */
+	wait_for_allocated(stream, POOL_REGIONS_COUNT - 1 + segments + POOL_CAPACITY, POOL_REGIONS_COUNT);
+	UT_ASSERTeq(pmemstream_test_count_regions(stream), POOL_REGIONS_COUNT);
+	verify_regions(stream, regions);
+
+	/* Regions left in the pool are freed when the stream is deleted. */
+	pmemstream_delete(&stream);
+
+	UT_ASSERTeq(pmemstream_from_map(&stream, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERTeq(count_allocated(stream), POOL_REGIONS_COUNT - 1 + segments);
+	UT_ASSERTeq(pmemstream_test_count_regions(stream), POOL_REGIONS_COUNT);
+	verify_regions(stream, regions);
+	pmemstream_delete(&stream);
+
+	/* Pool is started by the asynchronous open as well. */
+	struct pmemstream_config *config = make_pool_config();
+	struct pmemstream_async_from_map_fut future = pmemstream_async_from_config(&stream, map, config);
+	pmemstream_config_delete(&config);
+	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+		;
+	UT_ASSERTeq(future.output.error_code, 0);
+	wait_for_allocated(stream, POOL_REGIONS_COUNT - 1 + segments + POOL_CAPACITY, POOL_REGIONS_COUNT);
+	verify_regions(stream, regions);
+	pmemstream_delete(&stream);
+
+	pmem2_map_delete(&map);
+}
+
+void full_stream_test(char *path)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+	struct pmemstream *stream = open_with_pool(map);
+
+	/* Whole space can be allocated - the pool takes whatever is left. */
+	struct pmemstream_region region;
+	size_t allocated = 0;
+	while (pmemstream_region_allocate(stream, POOL_REGION_SIZE, &region) == 0) {
+		++allocated;
+	}
+	UT_ASSERT(allocated > POOL_CAPACITY);
+
+	/* Freed region can be allocated again - it might be taken by the worker first, so the allocation is retried
+	 * until the worker puts the region in the pool. */
+	UT_ASSERTeq(pmemstream_region_free(stream, region), 0);
+	while (pmemstream_region_allocate(stream, POOL_REGION_SIZE, &region) != 0) {
+		sched_yield();
+	}
+	pmemstream_test_verify_entries(stream, region, 0, 0);
+
+	pmemstream_delete(&stream);
+	pmem2_map_delete(&map);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+	char *path = argv[1];
+
+	pool_test(path);
+	full_stream_test(path);
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "stream_helpers.h"
+#include "unittest.h"
+
+/**
+ * region_ring - unit test for pmemstream_region_allocate_ring and pmemstream_region_trim
+ */
+
+/* Region fits only a few dozens of entries, so that appends wrap around many times. */
+#define RING_REGION_SIZE TEST_DEFAULT_BLOCK_SIZE
+#define RING_ENTRY_SIZE 200
+#define RING_ENTRIES_COUNT 2000
+#define RING_REOPEN_INTERVAL 300
+
+static int append_entry(struct pmemstream *stream, struct pmemstream_region region, uint64_t value)
+{
+	uint8_t buffer[RING_ENTRY_SIZE] = {0};
+	*(uint64_t *)buffer = value;
+	return pmemstream_append(stream, region, NULL, buffer, sizeof(buffer), NULL);
+}
+
+static struct pmemstream_entry find_entry(struct pmemstream *stream, struct pmemstream_region region, uint64_t value)
+{
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, stream, region), 0);
+
+	pmemstream_entry_iterator_seek_first(eiter);
+	while (pmemstream_entry_iterator_is_valid(eiter) == 0 &&
+	       *(const uint64_t *)pmemstream_entry_data(stream, pmemstream_entry_iterator_get(eiter)) != value) {
+		pmemstream_entry_iterator_next(eiter);
+	}
+	UT_ASSERTeq(pmemstream_entry_iterator_is_valid(eiter), 0);
+
+	struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+	pmemstream_entry_iterator_delete(&eiter);
+	return entry;
+}
+
+/* Appends entries with consecutive values, discarding the oldest half of them whenever the region is full. */
+void retention_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_ring(env.stream, RING_REGION_SIZE, &region), 0);
+	size_t initial_usable_size = pmemstream_region_usable_size(env.stream, region);
+
+	uint64_t first = 0;
+	size_t trims = 0;
+	for (uint64_t i = 0; i < RING_ENTRIES_COUNT; i++) {
+		if (append_entry(env.stream, region, i) != 0) {
+			first += (i - first) / 2;
+			struct pmemstream_entry entry = find_entry(env.stream, region, first);
+			UT_ASSERTeq(pmemstream_region_trim(env.stream, region, entry), 0);
+			UT_ASSERTeq(append_entry(env.stream, region, i), 0);
+			++trims;
+		}
+
+		if (i % RING_REOPEN_INTERVAL == 0) {
+			pmemstream_test_verify_entries(env.stream, region, first, i + 1);
+			pmemstream_test_reopen(&env, path);
+		}
+	}
+
+	/* Space of trimmed entries was reused many times. */
+	UT_ASSERT(trims > 10);
+	pmemstream_test_verify_entries(env.stream, region, first, RING_ENTRIES_COUNT);
+
+	pmemstream_test_reopen(&env, path);
+	pmemstream_test_verify_entries(env.stream, region, first, RING_ENTRIES_COUNT);
+
+	/* Trimming all but the last entry frees (almost) whole region. */
+	UT_ASSERTeq(pmemstream_region_trim(env.stream, region, find_entry(env.stream, region, RING_ENTRIES_COUNT - 1)),
+		    0);
+	pmemstream_test_verify_entries(env.stream, region, RING_ENTRIES_COUNT - 1, RING_ENTRIES_COUNT);
+	UT_ASSERT(pmemstream_region_usable_size(env.stream, region) + RING_ENTRY_SIZE + 64 >= initial_usable_size);
+
+	pmemstream_test_teardown(env);
+}
+
+void trim_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate_ring(env.stream, RING_REGION_SIZE, &region), 0);
+	for (uint64_t i = 0; i < 10; i++) {
+		UT_ASSERTeq(append_entry(env.stream, region, i), 0);
+	}
+
+	struct pmemstream_entry second = find_entry(env.stream, region, 1);
+	struct pmemstream_entry fifth = find_entry(env.stream, region, 5);
+	UT_ASSERTeq(pmemstream_region_trim(env.stream, region, second), 0);
+	UT_ASSERTeq(pmemstream_region_trim(env.stream, region, second), 0);
+	UT_ASSERTeq(pmemstream_region_trim(env.stream, region, fifth), 0);
+	pmemstream_test_verify_entries(env.stream, region, 5, 10);
+
+	/* Entry which was already discarded cannot become the head again. */
+	UT_ASSERTeq(pmemstream_region_trim(env.stream, region, second), -1);
+	pmemstream_test_verify_entries(env.stream, region, 5, 10);
+
+	/* Ring regions cannot be iterated in reverse. */
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, env.stream, region), 0);
+	pmemstream_entry_iterator_seek_last(eiter);
+	UT_ASSERTne(pmemstream_entry_iterator_is_valid(eiter), 0);
+	pmemstream_entry_iterator_delete(&eiter);
+
+	/* Regions which are not rings cannot be trimmed. */
+	struct pmemstream_region regular_region;
+	UT_ASSERTeq(pmemstream_region_allocate(env.stream, RING_REGION_SIZE, &regular_region), 0);
+	UT_ASSERTeq(append_entry(env.stream, regular_region, 0), 0);
+	UT_ASSERTeq(pmemstream_region_trim(env.stream, regular_region, find_entry(env.stream, regular_region, 0)), -1);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+	char *path = argv[1];
+
+	retention_test(path);
+	trim_test(path);
+
+	return 0;
+}
@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "common/util.h"
+#include "span.h"
+#include "stream_helpers.h"
+#include "unittest.h"
+
+/**
+ * scan_parallel - unit test for pmemstream_scan_parallel
+ */
+
+#define REGIONS_COUNT 8
+#define ENTRIES_PER_REGION 100
+#define MAX_THREADS 4
+
+/* Entries hold consecutive values: 0, 1, ..., (EXPECTED_COUNT - 1). */
+#define EXPECTED_COUNT (REGIONS_COUNT * ENTRIES_PER_REGION)
+#define EXPECTED_SUM (EXPECTED_COUNT * (EXPECTED_COUNT - 1) / 2)
+
+struct worker_accumulator {
+	uint64_t sum;
+	size_t count;
+};
+
+struct scan_ctx {
+	struct worker_accumulator workers[MAX_THREADS];
+};
+
+static int sum_entries(struct pmemstream *stream, size_t worker_id, struct pmemstream_region region,
+		       const struct pmemstream_entry *entries, size_t entries_count, void *arg)
+{
+	(void)region;
+	struct scan_ctx *ctx = (struct scan_ctx *)arg;
+	UT_ASSERT(worker_id < MAX_THREADS);
+	UT_ASSERT(entries_count > 0);
+
+	/* Each worker updates only its own accumulator - no synchronization needed. */
+	struct worker_accumulator *acc = &ctx->workers[worker_id];
+	for (size_t i = 0; i < entries_count; i++) {
+		UT_ASSERTeq(pmemstream_entry_size(stream, entries[i]), sizeof(uint64_t));
+		acc->sum += *(const uint64_t *)pmemstream_entry_data(stream, entries[i]);
+		acc->count++;
+	}
+
+	return 0;
+}
+
+static int fail_callback(struct pmemstream *stream, size_t worker_id, struct pmemstream_region region,
+			 const struct pmemstream_entry *entries, size_t entries_count, void *arg)
+{
+	(void)stream;
+	(void)worker_id;
+	(void)region;
+	(void)entries;
+	(void)entries_count;
+	(void)arg;
+	return -1;
+}
+
+static void merge_accumulators(struct scan_ctx *ctx, uint64_t *sum, size_t *count)
+{
+	*sum = 0;
+	*count = 0;
+	for (size_t i = 0; i < MAX_THREADS; i++) {
+		*sum += ctx->workers[i].sum;
+		*count += ctx->workers[i].count;
+	}
+}
+
+static void fill_regions(pmemstream_test_env *env, struct pmemstream_region *regions)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < REGIONS_COUNT; i++) {
+		int ret = pmemstream_region_allocate(env->stream, TEST_DEFAULT_REGION_MULTI_SIZE, &regions[i]);
+		UT_ASSERTeq(ret, 0);
+
+		for (size_t j = 0; j < ENTRIES_PER_REGION; j++) {
+			ret = pmemstream_append(env->stream, regions[i], NULL, &value, sizeof(value), NULL);
+			UT_ASSERTeq(ret, 0);
+			++value;
+		}
+	}
+}
+
+void valid_input_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	fill_regions(&env, regions);
+
+	for (size_t nthreads = 1; nthreads <= MAX_THREADS; nthreads++) {
+		struct scan_ctx ctx = {0};
+		int ret = pmemstream_scan_parallel(env.stream, regions, REGIONS_COUNT, nthreads, sum_entries, &ctx);
+		UT_ASSERTeq(ret, 0);
+
+		uint64_t sum;
+		size_t count;
+		merge_accumulators(&ctx, &sum, &count);
+		UT_ASSERTeq(count, EXPECTED_COUNT);
+		UT_ASSERTeq(sum, EXPECTED_SUM);
+	}
+
+	pmemstream_test_teardown(env);
+}
+
+void all_regions_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct scan_ctx ctx = {0};
+	int ret = pmemstream_scan_parallel(env.stream, NULL, 0, MAX_THREADS, sum_entries, &ctx);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t sum;
+	size_t count;
+	merge_accumulators(&ctx, &sum, &count);
+	UT_ASSERTeq(count, 0);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	fill_regions(&env, regions);
+
+	ret = pmemstream_scan_parallel(env.stream, NULL, 0, MAX_THREADS, sum_entries, &ctx);
+	UT_ASSERTeq(ret, 0);
+
+	merge_accumulators(&ctx, &sum, &count);
+	UT_ASSERTeq(count, EXPECTED_COUNT);
+	UT_ASSERTeq(sum, EXPECTED_SUM);
+
+	pmemstream_test_teardown(env);
+}
+
+void subset_of_regions_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	fill_regions(&env, regions);
+
+	/* Scan only the last region - it contains values in range [(REGIONS_COUNT-1)*ENTRIES_PER_REGION, ...). */
+	struct scan_ctx ctx = {0};
+	int ret =
+		pmemstream_scan_parallel(env.stream, &regions[REGIONS_COUNT - 1], 1, MAX_THREADS, sum_entries, &ctx);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t sum;
+	size_t count;
+	merge_accumulators(&ctx, &sum, &count);
+	UT_ASSERTeq(count, ENTRIES_PER_REGION);
+
+	uint64_t first = (REGIONS_COUNT - 1) * ENTRIES_PER_REGION;
+	UT_ASSERTeq(sum, ENTRIES_PER_REGION * first + ENTRIES_PER_REGION * (ENTRIES_PER_REGION - 1) / 2);
+
+	pmemstream_test_teardown(env);
+}
+
+void callback_failure_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	fill_regions(&env, regions);
+
+	int ret = pmemstream_scan_parallel(env.stream, regions, REGIONS_COUNT, MAX_THREADS, fail_callback, NULL);
+	UT_ASSERTeq(ret, -1);
+
+	pmemstream_test_teardown(env);
+}
+
+void null_input_test(char *path)
+{
+	pmemstream_test_env env = pmemstream_test_make_default(path);
+
+	struct pmemstream_region regions[REGIONS_COUNT];
+	fill_regions(&env, regions);
+
+	struct scan_ctx ctx = {0};
+	int ret = pmemstream_scan_parallel(NULL, regions, REGIONS_COUNT, MAX_THREADS, sum_entries, &ctx);
+	UT_ASSERTeq(ret, -1);
+
+	ret = pmemstream_scan_parallel(env.stream, NULL, REGIONS_COUNT, MAX_THREADS, sum_entries, &ctx);
+	UT_ASSERTeq(ret, -1);
+
+	ret = pmemstream_scan_parallel(env.stream, regions, REGIONS_COUNT, 0, sum_entries, &ctx);
+	UT_ASSERTeq(ret, -1);
+
+	ret = pmemstream_scan_parallel(env.stream, regions, REGIONS_COUNT, MAX_THREADS, NULL, &ctx);
+	UT_ASSERTeq(ret, -1);
+
+	struct pmemstream_region invalid_region = {.offset = ALIGN_DOWN(UINT64_MAX, sizeof(span_bytes))};
+	ret = pmemstream_scan_parallel(env.stream, &invalid_region, 1, MAX_THREADS, sum_entries, &ctx);
+	UT_ASSERTeq(ret, -1);
+
+	pmemstream_test_teardown(env);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+
+	char *path = argv[1];
+
+	valid_input_test(path);
+	all_regions_test(path);
+	subset_of_regions_test(path);
+	callback_failure_test(path);
+	null_input_test(path);
+
+	return 0;
+}
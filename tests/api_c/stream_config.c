@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include "unittest.h"
+
+/**
+ * stream_config - unit test for pmemstream_config, pmemstream_from_config and pmemstream_async_from_config
+ */
+
+#define CONFIG_ENTRIES_COUNT 100
+
+static struct pmemstream_config *make_config(size_t max_concurrency, size_t batch_size,
+					     enum pmemstream_persistence_mode mode)
+{
+	struct pmemstream_config *config;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+	UT_ASSERTeq(pmemstream_config_set_block_size(config, TEST_DEFAULT_BLOCK_SIZE), 0);
+	UT_ASSERTeq(pmemstream_config_set_max_concurrency(config, max_concurrency), 0);
+	UT_ASSERTeq(pmemstream_config_set_commit_batch_size(config, batch_size), 0);
+	UT_ASSERTeq(pmemstream_config_set_persistence_mode(config, mode), 0);
+	return config;
+}
+
+static uint64_t count_entries(struct pmemstream *s, struct pmemstream_region region)
+{
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, s, region), 0);
+
+	uint64_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(s, entry), count);
+		++count;
+	}
+
+	pmemstream_entry_iterator_delete(&eiter);
+	return count;
+}
+
+void test_from_config(char *path, size_t max_concurrency, size_t batch_size, enum pmemstream_persistence_mode mode)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	/* Config can be deleted right after the stream is opened. */
+	struct pmemstream_config *config = make_config(max_concurrency, batch_size, mode);
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_config(&s, map, config), 0);
+	pmemstream_config_delete(&config);
+	UT_ASSERTeq(config, NULL);
+
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(s, TEST_DEFAULT_REGION_SIZE, &region), 0);
+	struct pmemstream_entry entry;
+	for (uint64_t i = 0; i < CONFIG_ENTRIES_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_append(s, region, NULL, &i, sizeof(i), &entry), 0);
+
+		uint64_t timestamp = pmemstream_entry_timestamp(s, entry);
+		UT_ASSERT(pmemstream_committed_timestamp(s) >= timestamp);
+		if (mode == PMEMSTREAM_PERSISTENCE_SYNC) {
+			UT_ASSERT(pmemstream_persisted_timestamp(s) >= timestamp);
+		}
+	}
+	UT_ASSERTeq(count_entries(s, region), CONFIG_ENTRIES_COUNT);
+
+	/* Entries can be explicitly persisted in relaxed mode. */
+	uint64_t timestamp = pmemstream_entry_timestamp(s, entry);
+	struct pmemstream_async_wait_fut future = pmemstream_async_wait_persisted(s, timestamp);
+	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+		;
+	UT_ASSERT(pmemstream_persisted_timestamp(s) >= timestamp);
+
+	uint64_t value = CONFIG_ENTRIES_COUNT;
+	UT_ASSERTeq(pmemstream_append(s, region, NULL, &value, sizeof(value), NULL), 0);
+	pmemstream_delete(&s);
+
+	/* All committed entries are persisted by pmemstream_delete. Stream can be reopened with different config. */
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERTeq(count_entries(s, region), CONFIG_ENTRIES_COUNT + 1);
+	pmemstream_delete(&s);
+
+	pmem2_map_delete(&map);
+}
+
+void test_async_from_config(char *path, size_t max_concurrency, size_t batch_size,
+			    enum pmemstream_persistence_mode mode)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(s, TEST_DEFAULT_REGION_SIZE, &region), 0);
+	for (uint64_t i = 0; i < CONFIG_ENTRIES_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_append(s, region, NULL, &i, sizeof(i), NULL), 0);
+	}
+	pmemstream_delete(&s);
+
+	/* Config is not needed by the future. */
+	struct pmemstream_config *config = make_config(max_concurrency, batch_size, mode);
+	UT_ASSERTeq(pmemstream_config_set_prefault(config, PMEMSTREAM_PREFAULT_REGIONS, 2), 0);
+	UT_ASSERTeq(pmemstream_config_set_recovery_threads(config, 2), 0);
+	struct pmemstream_async_from_map_fut future = pmemstream_async_from_config(&s, map, config);
+	pmemstream_config_delete(&config);
+	while (future_poll(FUTURE_AS_RUNNABLE(&future), NULL) != FUTURE_STATE_COMPLETE)
+		;
+	UT_ASSERTeq(future.output.error_code, 0);
+	UT_ASSERTne(s, NULL);
+
+	UT_ASSERTeq(count_entries(s, region), CONFIG_ENTRIES_COUNT);
+	uint64_t value = CONFIG_ENTRIES_COUNT;
+	struct pmemstream_entry entry;
+	UT_ASSERTeq(pmemstream_append(s, region, NULL, &value, sizeof(value), &entry), 0);
+	if (mode == PMEMSTREAM_PERSISTENCE_SYNC) {
+		UT_ASSERT(pmemstream_persisted_timestamp(s) >= pmemstream_entry_timestamp(s, entry));
+	}
+	UT_ASSERTeq(count_entries(s, region), CONFIG_ENTRIES_COUNT + 1);
+	pmemstream_delete(&s);
+
+	pmem2_map_delete(&map);
+}
+
+void test_config_invalid_values(char *path)
+{
+	struct pmemstream_config *config;
+	UT_ASSERTeq(pmemstream_config_new(&config), 0);
+
+	UT_ASSERTeq(pmemstream_config_set_block_size(config, 0), -1);
+	UT_ASSERTeq(pmemstream_config_set_block_size(config, 8), -1);
+	UT_ASSERTeq(pmemstream_config_set_block_size(config, 3 * TEST_DEFAULT_BLOCK_SIZE), -1);
+	UT_ASSERTeq(pmemstream_config_set_max_concurrency(config, 0), -1);
+	UT_ASSERTeq(pmemstream_config_set_max_concurrency(config, 100), -1);
+	UT_ASSERTeq(pmemstream_config_set_commit_batch_size(config, 0), -1);
+	UT_ASSERTeq(pmemstream_config_set_prefault(config, (enum pmemstream_prefault_mode)100, 1), -1);
+	UT_ASSERTeq(pmemstream_config_set_persistence_mode(config, (enum pmemstream_persistence_mode)100), -1);
+	UT_ASSERTeq(pmemstream_config_set_region_pool(config, 0, 4), -1);
+
+	/* Block size was not set. */
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_config(&s, map, config), -1);
+	UT_ASSERTeq(s, NULL);
+
+	UT_ASSERTeq(pmemstream_config_set_block_size(config, TEST_DEFAULT_BLOCK_SIZE), 0);
+	UT_ASSERTeq(pmemstream_config_set_prefault(config, PMEMSTREAM_PREFAULT_REGIONS, 2), 0);
+	UT_ASSERTeq(pmemstream_config_set_recovery_threads(config, 2), 0);
+	UT_ASSERTeq(pmemstream_from_config(NULL, map, config), -1);
+	UT_ASSERTeq(pmemstream_from_config(&s, NULL, config), -1);
+	UT_ASSERTeq(pmemstream_from_config(&s, map, NULL), -1);
+
+	struct pmemstream_async_from_map_fut future = pmemstream_async_from_config(&s, map, NULL);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTne(future.output.error_code, 0);
+	UT_ASSERTeq(s, NULL);
+	future = pmemstream_async_from_config(NULL, map, config);
+	UT_ASSERTeq(future_poll(FUTURE_AS_RUNNABLE(&future), NULL), FUTURE_STATE_COMPLETE);
+	UT_ASSERTne(future.output.error_code, 0);
+
+	UT_ASSERTeq(pmemstream_from_config(&s, map, config), 0);
+	pmemstream_delete(&s);
+
+	pmem2_map_delete(&map);
+	pmemstream_config_delete(&config);
+
+	UT_ASSERTeq(pmemstream_config_new(NULL), -1);
+	UT_ASSERTeq(pmemstream_config_set_block_size(NULL, TEST_DEFAULT_BLOCK_SIZE), -1);
+	UT_ASSERTeq(pmemstream_config_set_max_concurrency(NULL, 1), -1);
+	UT_ASSERTeq(pmemstream_config_set_commit_batch_size(NULL, 1), -1);
+	UT_ASSERTeq(pmemstream_config_set_prefault(NULL, PMEMSTREAM_PREFAULT_ALL, 1), -1);
+	UT_ASSERTeq(pmemstream_config_set_recovery_threads(NULL, 1), -1);
+	UT_ASSERTeq(pmemstream_config_set_persistence_mode(NULL, PMEMSTREAM_PERSISTENCE_SYNC), -1);
+	UT_ASSERTeq(pmemstream_config_set_region_pool(NULL, TEST_DEFAULT_REGION_SIZE, 4), -1);
+	pmemstream_config_delete(NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		UT_FATAL("usage: %s file-name", argv[0]);
+	}
+
+	START();
+	char *path = argv[1];
+
+	test_from_config(path, 1024, 15, PMEMSTREAM_PERSISTENCE_SYNC);
+	/* single slot for concurrent operations, each timestamp committed separately */
+	test_from_config(path, 1, 1, PMEMSTREAM_PERSISTENCE_SYNC);
+	test_from_config(path, 4, 2, PMEMSTREAM_PERSISTENCE_RELAXED);
+	test_from_config(path, 1024, 64, PMEMSTREAM_PERSISTENCE_RELAXED);
+	test_async_from_config(path, 1, 1, PMEMSTREAM_PERSISTENCE_SYNC);
+	test_async_from_config(path, 4, 2, PMEMSTREAM_PERSISTENCE_RELAXED);
+	test_config_invalid_values(path);
+
+	return 0;
+}
@@ -8,6 +8,9 @@
  * stream_from_map - unit test for pmemstream_from_map and pmemstream_delete
  */
 
+#define RECOVERY_REGIONS_COUNT 8
+#define RECOVERY_ENTRIES_PER_REGION 10
+
 void test_stream_from_map(char *path, size_t file_size, size_t blk_size)
 {
 	struct pmem2_map *map = map_open(path, file_size, true);
@@ -24,6 +27,299 @@ void test_stream_from_map(char *path, size_t file_size, size_t blk_size)
 	pmem2_map_delete(&map);
 }
 
+static size_t count_entries(struct pmemstream *s, struct pmemstream_region region)
+{
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, s, region), 0);
+
+	size_t count = 0;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(s, pmemstream_entry_iterator_get(eiter)), count);
+		++count;
+	}
+
+	pmemstream_entry_iterator_delete(&eiter);
+	return count;
+}
+
+static uint64_t last_entry_value(struct pmemstream *s, struct pmemstream_region region)
+{
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, s, region), 0);
+
+	pmemstream_entry_iterator_seek_last(eiter);
+	UT_ASSERTeq(pmemstream_entry_iterator_is_valid(eiter), 0);
+	uint64_t value = *(const uint64_t *)pmemstream_entry_data(s, pmemstream_entry_iterator_get(eiter));
+
+	pmemstream_entry_iterator_delete(&eiter);
+	return value;
+}
+
+static void append_entries(struct pmemstream *s, struct pmemstream_region region, uint64_t begin, uint64_t end)
+{
+	for (uint64_t i = begin; i < end; i++) {
+		UT_ASSERTeq(pmemstream_append(s, region, NULL, &i, sizeof(i), NULL), 0);
+	}
+}
+
+void test_stream_from_map_parallel_recovery(char *path, size_t recovery_threads)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream_open_options options = {.recovery_threads = recovery_threads};
+
+	/* Empty stream. */
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_map_with_options(&s, TEST_DEFAULT_BLOCK_SIZE, map, &options), 0);
+
+	struct pmemstream_region regions[RECOVERY_REGIONS_COUNT];
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(s, TEST_DEFAULT_REGION_MULTI_SIZE, &regions[i]), 0);
+		append_entries(s, regions[i], 0, RECOVERY_ENTRIES_PER_REGION);
+	}
+	pmemstream_delete(&s);
+
+	/* All regions are recovered at open - appends continue after existing entries. */
+	UT_ASSERTeq(pmemstream_from_map_with_options(&s, TEST_DEFAULT_BLOCK_SIZE, map, &options), 0);
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		append_entries(s, regions[i], RECOVERY_ENTRIES_PER_REGION, 2 * RECOVERY_ENTRIES_PER_REGION);
+		UT_ASSERTeq(count_entries(s, regions[i]), 2 * RECOVERY_ENTRIES_PER_REGION);
+	}
+	pmemstream_delete(&s);
+
+	/* Stream recovered in parallel can be reopened with lazy recovery. */
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		UT_ASSERTeq(count_entries(s, regions[i]), 2 * RECOVERY_ENTRIES_PER_REGION);
+	}
+	pmemstream_delete(&s);
+
+	pmem2_map_delete(&map);
+}
+
+void test_stream_from_map_prefault(char *path, enum pmemstream_prefault_mode mode, size_t prefault_threads)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream_open_options options = {
+		.recovery_threads = 0, .prefault = mode, .prefault_threads = prefault_threads};
+
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_map_with_options(&s, TEST_DEFAULT_BLOCK_SIZE, map, &options), 0);
+
+	struct pmemstream_region regions[RECOVERY_REGIONS_COUNT];
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(s, TEST_DEFAULT_REGION_MULTI_SIZE, &regions[i]), 0);
+		append_entries(s, regions[i], 0, RECOVERY_ENTRIES_PER_REGION);
+	}
+	pmemstream_delete(&s);
+
+	/* Prefaulting does not modify any data. */
+	UT_ASSERTeq(pmemstream_from_map_with_options(&s, TEST_DEFAULT_BLOCK_SIZE, map, &options), 0);
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		UT_ASSERTeq(count_entries(s, regions[i]), RECOVERY_ENTRIES_PER_REGION);
+		append_entries(s, regions[i], RECOVERY_ENTRIES_PER_REGION, 2 * RECOVERY_ENTRIES_PER_REGION);
+	}
+	pmemstream_delete(&s);
+
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		UT_ASSERTeq(count_entries(s, regions[i]), 2 * RECOVERY_ENTRIES_PER_REGION);
+	}
+	pmemstream_delete(&s);
+
+	pmem2_map_delete(&map);
+}
+
+static bool is_active_region(struct pmemstream *s, struct pmemstream_region region)
+{
+	for (size_t i = 0; i < PMEMSTREAM_ACTIVE_REGIONS_MAX; i++) {
+		if (s->header->active_regions.offsets[i] == region.offset) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static size_t active_regions_count(struct pmemstream *s)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < PMEMSTREAM_ACTIVE_REGIONS_MAX; i++) {
+		if (s->header->active_regions.offsets[i] != PMEMSTREAM_INVALID_OFFSET) {
+			++count;
+		}
+	}
+	return count;
+}
+
+void test_stream_from_map_active_regions(char *path)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERTeq(active_regions_count(s), 0);
+
+	struct pmemstream_region regions[RECOVERY_REGIONS_COUNT];
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(s, TEST_DEFAULT_REGION_MULTI_SIZE, &regions[i]), 0);
+		append_entries(s, regions[i], 0, RECOVERY_ENTRIES_PER_REGION);
+		UT_ASSERT(is_active_region(s, regions[i]));
+	}
+	UT_ASSERTeq(active_regions_count(s), RECOVERY_REGIONS_COUNT);
+
+	/* Freed region is removed from the set. */
+	pmemstream_region_free(s, regions[RECOVERY_REGIONS_COUNT - 1]);
+	UT_ASSERTeq(active_regions_count(s), RECOVERY_REGIONS_COUNT - 1);
+	pmemstream_delete(&s);
+
+	/* Set is cleared at open, only regions appended to in this session are added again. */
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERTeq(active_regions_count(s), 0);
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT - 1; i += 2) {
+		append_entries(s, regions[i], RECOVERY_ENTRIES_PER_REGION, 2 * RECOVERY_ENTRIES_PER_REGION);
+	}
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT - 1; i++) {
+		UT_ASSERTeq(is_active_region(s, regions[i]), i % 2 == 0);
+	}
+	pmemstream_delete(&s);
+
+	/* Not marked regions are still readable and writable. */
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT - 1; i++) {
+		size_t expected = (i % 2 == 0) ? 2 * RECOVERY_ENTRIES_PER_REGION : RECOVERY_ENTRIES_PER_REGION;
+		UT_ASSERTeq(count_entries(s, regions[i]), expected);
+		append_entries(s, regions[i], expected, expected + 1);
+		UT_ASSERTeq(count_entries(s, regions[i]), expected + 1);
+	}
+	pmemstream_delete(&s);
+
+	pmem2_map_delete(&map);
+}
+
+void test_stream_from_map_active_regions_overflow(char *path)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+
+	/* One region more than fits in the set. */
+	const size_t regions_count = PMEMSTREAM_ACTIVE_REGIONS_MAX + 1;
+	struct pmemstream_region *regions = malloc(regions_count * sizeof(*regions));
+	UT_ASSERTne(regions, NULL);
+	for (size_t i = 0; i < regions_count; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(s, 1, &regions[i]), 0);
+		append_entries(s, regions[i], 0, 1);
+	}
+	UT_ASSERTeq(active_regions_count(s), PMEMSTREAM_ACTIVE_REGIONS_MAX);
+	UT_ASSERTeq(s->header->active_regions.overflow, 1);
+	pmemstream_delete(&s);
+
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERTeq(active_regions_count(s), 0);
+	UT_ASSERTeq(s->header->active_regions.overflow, 0);
+	for (size_t i = 0; i < regions_count; i++) {
+		UT_ASSERTeq(count_entries(s, regions[i]), 1);
+	}
+	pmemstream_delete(&s);
+
+	free(regions);
+	pmem2_map_delete(&map);
+}
+
+static uint64_t tail_offset_hint(struct pmemstream *s, struct pmemstream_region region)
+{
+	return ((const struct span_region *)span_offset_to_span_ptr(&s->data, region.offset))->tail_offset_hint;
+}
+
+void test_stream_from_map_clean_shutdown(char *path)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERT(!s->use_tail_hints);
+
+	struct pmemstream_region regions[RECOVERY_REGIONS_COUNT];
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		UT_ASSERTeq(pmemstream_region_allocate(s, TEST_DEFAULT_REGION_MULTI_SIZE, &regions[i]), 0);
+		UT_ASSERTeq(tail_offset_hint(s, regions[i]), PMEMSTREAM_INVALID_OFFSET);
+		append_entries(s, regions[i], 0, RECOVERY_ENTRIES_PER_REGION);
+	}
+
+	/* Entry reserved, but never published - tail of the last region is not stable. */
+	struct pmemstream_entry reserved_entry;
+	void *reserved_data;
+	UT_ASSERTeq(pmemstream_reserve(s, regions[RECOVERY_REGIONS_COUNT - 1], NULL, sizeof(uint64_t), &reserved_entry,
+				       &reserved_data),
+		    0);
+	UT_ASSERTeq(s->header->clean_shutdown, 0);
+	pmemstream_delete(&s);
+
+	/* Flag is cleared at open, tails are taken from hints. */
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERT(s->use_tail_hints);
+	UT_ASSERTeq(s->header->clean_shutdown, 0);
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT - 1; i++) {
+		UT_ASSERTne(tail_offset_hint(s, regions[i]), PMEMSTREAM_INVALID_OFFSET);
+	}
+	UT_ASSERTeq(tail_offset_hint(s, regions[RECOVERY_REGIONS_COUNT - 1]), PMEMSTREAM_INVALID_OFFSET);
+
+	/* Hint is invalidated by the first append. */
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		append_entries(s, regions[i], RECOVERY_ENTRIES_PER_REGION, RECOVERY_ENTRIES_PER_REGION + 1);
+		UT_ASSERTeq(tail_offset_hint(s, regions[i]), PMEMSTREAM_INVALID_OFFSET);
+		UT_ASSERTeq(count_entries(s, regions[i]), RECOVERY_ENTRIES_PER_REGION + 1);
+	}
+	pmemstream_delete(&s);
+
+	/* Reverse iteration works with tails taken from hints as well. */
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	for (size_t i = 0; i < RECOVERY_REGIONS_COUNT; i++) {
+		UT_ASSERTeq(last_entry_value(s, regions[i]), RECOVERY_ENTRIES_PER_REGION);
+		UT_ASSERTeq(count_entries(s, regions[i]), RECOVERY_ENTRIES_PER_REGION + 1);
+		append_entries(s, regions[i], RECOVERY_ENTRIES_PER_REGION + 1, RECOVERY_ENTRIES_PER_REGION + 2);
+		UT_ASSERTeq(count_entries(s, regions[i]), RECOVERY_ENTRIES_PER_REGION + 2);
+	}
+	pmemstream_delete(&s);
+
+	pmem2_map_delete(&map);
+}
+
+void test_stream_from_map_incompatible_layout(char *path)
+{
+	struct pmem2_map *map = map_open(path, TEST_DEFAULT_STREAM_SIZE, true);
+	UT_ASSERTne(map, NULL);
+
+	struct pmemstream *s = NULL;
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	struct pmemstream_region region;
+	UT_ASSERTeq(pmemstream_region_allocate(s, TEST_DEFAULT_REGION_MULTI_SIZE, &region), 0);
+	append_entries(s, region, 0, RECOVERY_ENTRIES_PER_REGION);
+	pmemstream_delete(&s);
+
+	/* Stream with a different layout version (e.g. created before the version was stored) is not opened. */
+	struct pmemstream_header *header = pmem2_map_get_address(map);
+	header->layout_version = PMEMSTREAM_LAYOUT_VERSION + 1;
+	UT_ASSERTne(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERTeq(s, NULL);
+
+	/* ...and it is not reinitialized. */
+	header->layout_version = PMEMSTREAM_LAYOUT_VERSION;
+	UT_ASSERTeq(pmemstream_from_map(&s, TEST_DEFAULT_BLOCK_SIZE, map), 0);
+	UT_ASSERTeq(count_entries(s, region), RECOVERY_ENTRIES_PER_REGION);
+	pmemstream_delete(&s);
+
+	pmem2_map_delete(&map);
+}
+
 void test_stream_from_map_invalid_size(char *path, size_t file_size, size_t blk_size)
 {
 	struct pmem2_map *map = map_open(path, file_size, true);
@@ -60,6 +356,18 @@ int main(int argc, char *argv[])
 	char *path = argv[1];
 	test_stream_from_map(path, 4096 * 1024, 4096);
 	test_stream_from_map(path, 10240, 64);
+	test_stream_from_map_parallel_recovery(path, 1);
+	test_stream_from_map_parallel_recovery(path, 4);
+	/* more threads than regions */
+	test_stream_from_map_parallel_recovery(path, 2 * RECOVERY_REGIONS_COUNT);
+	test_stream_from_map_prefault(path, PMEMSTREAM_PREFAULT_ALL, 1);
+	test_stream_from_map_prefault(path, PMEMSTREAM_PREFAULT_ALL, 4);
+	test_stream_from_map_prefault(path, PMEMSTREAM_PREFAULT_REGIONS, 0);
+	test_stream_from_map_prefault(path, PMEMSTREAM_PREFAULT_REGIONS, 4);
+	test_stream_from_map_active_regions(path);
+	test_stream_from_map_active_regions_overflow(path);
+	test_stream_from_map_clean_shutdown(path);
+	test_stream_from_map_incompatible_layout(path);
 	/* wrong block size*/
 	test_stream_from_map_invalid_size(path, 10240, 0);
 	/* wrong block size (not a power of 2) */
@@ -0,0 +1,14 @@
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright 2023, Intel Corporation
+
+include(${TESTS_ROOT_DIR}/cmake/exec_functions.cmake)
+
+setup()
+
+execute(${EXECUTABLE} --path ${DIR}/testfile-pmemstream)
+execute(${EXECUTABLE} --path ${DIR}/testfile-pmemstream --prefetch_distance 1024)
+execute(${EXECUTABLE} --path ${DIR}/testfile-pmemstream --element_count 400 --element_size 4096)
+execute(${EXECUTABLE} --path ${DIR}/testfile-pmemstream --element_count 400 --element_size 4096 --prefetch_distance 8192)
+execute(${EXECUTABLE} --path ${DIR}/testfile-pmemstream --concurrency 3 --prefetch_distance 1024)
+
+finish()
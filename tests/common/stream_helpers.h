@@ -1,9 +1,12 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2021-2022, Intel Corporation */
+/* Copyright 2021-2023, Intel Corporation */
 
 #ifndef LIBPMEMSTREAM_STREAM_HELPERS_H
 #define LIBPMEMSTREAM_STREAM_HELPERS_H
 
+#include <stdint.h>
+#include <stdlib.h>
+
 #include "libpmemstream.h"
 #include "unittest.h"
 
@@ -28,4 +31,82 @@ static inline void pmemstream_test_teardown(struct pmemstream_test_env env)
 	pmem2_map_delete(&env.map);
 }
 
+/* Closes and reopens the stream (with default block size), 'env' is updated in place. */
+static inline void pmemstream_test_reopen(pmemstream_test_env *env, char *path)
+{
+	pmemstream_delete(&env->stream);
+	pmem2_map_delete(&env->map);
+
+	env->map = map_open(path, TEST_DEFAULT_STREAM_SIZE, false);
+	UT_ASSERTne(env->map, NULL);
+	UT_ASSERTeq(pmemstream_from_map(&env->stream, TEST_DEFAULT_BLOCK_SIZE, env->map), 0);
+}
+
+/* Appends entries of 'entry_size' bytes, each starting with a consecutive value from range [begin, end). */
+static inline void pmemstream_test_append_entries(struct pmemstream *stream, struct pmemstream_region region,
+						  uint64_t begin, uint64_t end, size_t entry_size)
+{
+	UT_ASSERT(entry_size >= sizeof(uint64_t));
+	uint8_t *buffer = calloc(1, entry_size);
+	UT_ASSERTne(buffer, NULL);
+
+	for (uint64_t i = begin; i < end; i++) {
+		*(uint64_t *)buffer = i;
+		UT_ASSERTeq(pmemstream_append(stream, region, NULL, buffer, entry_size, NULL), 0);
+	}
+
+	free(buffer);
+}
+
+/* Verifies that region contains entries starting with consecutive values from range [begin, end). */
+static inline void pmemstream_test_verify_entries(struct pmemstream *stream, struct pmemstream_region region,
+						  uint64_t begin, uint64_t end)
+{
+	struct pmemstream_entry_iterator *eiter;
+	UT_ASSERTeq(pmemstream_entry_iterator_new(&eiter, stream, region), 0);
+
+	uint64_t value = begin;
+	for (pmemstream_entry_iterator_seek_first(eiter); pmemstream_entry_iterator_is_valid(eiter) == 0;
+	     pmemstream_entry_iterator_next(eiter)) {
+		struct pmemstream_entry entry = pmemstream_entry_iterator_get(eiter);
+		UT_ASSERTeq(*(const uint64_t *)pmemstream_entry_data(stream, entry), value);
+		++value;
+	}
+	UT_ASSERTeq(value, end);
+
+	pmemstream_entry_iterator_delete(&eiter);
+}
+
+/* Counts regions visible through the region iterator. */
+static inline size_t pmemstream_test_count_regions(struct pmemstream *stream)
+{
+	struct pmemstream_region_iterator *riter;
+	UT_ASSERTeq(pmemstream_region_iterator_new(&riter, stream), 0);
+
+	size_t count = 0;
+	for (pmemstream_region_iterator_seek_first(riter); pmemstream_region_iterator_is_valid(riter) == 0;
+	     pmemstream_region_iterator_next(riter)) {
+		++count;
+	}
+
+	pmemstream_region_iterator_delete(&riter);
+	return count;
+}
+
+#ifdef LIBPMEMSTREAM_INTERNAL_H
+/* Counts all allocated regions, including hidden ones (e.g. segments of chained regions). Available only in tests
+ * which include libpmemstream_internal.h before this header. */
+static inline size_t pmemstream_test_count_allocated(struct pmemstream *stream)
+{
+	size_t count = 0;
+	uint64_t offset;
+	SLIST_FOREACH(struct span_region, &stream->data, &stream->header->region_allocator_header.allocated_list,
+		      offset, allocator_entry_metadata.next_allocated)
+	{
+		++count;
+	}
+	return count;
+}
+#endif
+
 #endif /* LIBPMEMSTREAM_STREAM_HELPERS_H */
@@ -184,6 +184,18 @@ struct stream {
 		return std::unique_ptr<struct pmemstream_entry_iterator, decltype(deleter)>(eiter, deleter);
 	}
 
+	auto global_iterator(const std::vector<pmemstream_region> &regions)
+	{
+		struct pmemstream_global_iterator *giter;
+		int ret = pmemstream_global_iterator_new(&giter, c_stream.get(), regions.data(), regions.size());
+		if (ret != 0) {
+			throw std::runtime_error("pmemstream_global_iterator_new failed");
+		}
+
+		auto deleter = [](pmemstream_global_iterator *iter) { pmemstream_global_iterator_delete(&iter); };
+		return std::unique_ptr<struct pmemstream_global_iterator, decltype(deleter)>(giter, deleter);
+	}
+
 	auto region_iterator()
 	{
 		struct pmemstream_region_iterator *riter;
@@ -231,84 +243,6 @@ struct stream {
 	std::unique_ptr<struct pmemstream, std::function<void(struct pmemstream *)>> c_stream;
 }; /* struct stream */
 
-// XXX: replace with actual global entry iterator once implemented
-/* pmememstream entry iterator wrapper, which helps to manage entries from
- * different regions in global order. */
-class timestamp_iterator {
- public:
-	timestamp_iterator(pmemstream *stream, pmemstream_region &region) : stream(stream)
-	{
-		struct pmemstream_entry_iterator *new_entry_iterator;
-		if (pmemstream_entry_iterator_new(&new_entry_iterator, stream, region) != 0) {
-			throw std::runtime_error("Cannot create entry iterators");
-		}
-		it = std::shared_ptr<pmemstream_entry_iterator>(new_entry_iterator, [](pmemstream_entry_iterator *eit) {
-			pmemstream_entry_iterator_delete(&eit);
-		});
-		pmemstream_entry_iterator_seek_first(it.get());
-	}
-
-	void operator++()
-	{
-		pmemstream_entry_iterator_next(it.get());
-	}
-
-	bool operator<(timestamp_iterator &other)
-	{
-		if (pmemstream_entry_iterator_is_valid(it.get()) != 0)
-			return false;
-
-		if (pmemstream_entry_iterator_is_valid(other.it.get()) != 0)
-			return true;
-
-		return get_timestamp() < other.get_timestamp();
-	}
-
-	bool operator==(timestamp_iterator &other)
-	{
-		if (pmemstream_entry_iterator_is_valid(it.get()) != 0)
-			return false;
-
-		if (pmemstream_entry_iterator_is_valid(other.it.get()) != 0)
-			return false;
-
-		return get_timestamp() == other.get_timestamp();
-	}
-
-	uint64_t get_timestamp()
-	{
-		if (pmemstream_entry_iterator_is_valid(it.get()) != 0) {
-			throw std::runtime_error("Invalid iterator");
-		}
-
-		auto this_entry = pmemstream_entry_iterator_get(it.get());
-		return pmemstream_entry_timestamp(stream, this_entry);
-	}
-
-	bool is_valid()
-	{
-		return pmemstream_entry_iterator_is_valid(it.get()) == 0;
-	}
-
-	pmemstream_entry_iterator *raw_iterator()
-	{
-		return it.get();
-	}
-
-	static std::vector<timestamp_iterator> get_entry_iterators(pmemstream *stream,
-								   const std::vector<pmemstream_region> &regions)
-	{
-		std::vector<timestamp_iterator> entry_iterators;
-		for (auto region : regions) {
-			entry_iterators.emplace_back(timestamp_iterator(stream, region));
-		}
-		return entry_iterators;
-	}
-
- private:
-	pmemstream *stream;
-	std::shared_ptr<pmemstream_entry_iterator> it;
-}; /* class timestamp_iterator */
 } // namespace pmem
 
 template <typename FutureT>
@@ -619,15 +553,11 @@ struct pmemstream_helpers_type {
 	std::vector<pmemstream_entry> get_entries_from_regions(const std::vector<pmemstream_region> &regions)
 	{
 		std::vector<pmemstream_entry> entries;
-		auto entry_iterators = pmem::timestamp_iterator::get_entry_iterators(stream.c_ptr(), regions);
-		while (entry_iterators.size() > 0) {
-			auto oldest_iterator = std::min_element(entry_iterators.begin(), entry_iterators.end());
-			if (oldest_iterator->is_valid()) {
-				entries.push_back(pmemstream_entry_iterator_get(oldest_iterator->raw_iterator()));
-				++(*oldest_iterator);
-			} else {
-				entry_iterators.erase(oldest_iterator);
-			}
+		auto giter = stream.global_iterator(regions);
+		for (pmemstream_global_iterator_seek_first(giter.get());
+		     pmemstream_global_iterator_is_valid(giter.get()) == 0;
+		     pmemstream_global_iterator_next(giter.get())) {
+			entries.push_back(pmemstream_global_iterator_get(giter.get()));
 		}
 		return entries;
 	}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2023, Intel Corporation */
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include <rapidcheck.h>
+
+#include "rapidcheck_helpers.hpp"
+#include "stream_helpers.hpp"
+#include "thread_helpers.hpp"
+#include "unittest.hpp"
+
+static constexpr size_t max_concurrency = 16;
+static constexpr size_t max_regions_per_thread = 32;
+static constexpr size_t region_size = TEST_DEFAULT_BLOCK_SIZE;
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		std::cout << "Usage: " << argv[0] << " file-path" << std::endl;
+		return -1;
+	}
+
+	struct test_config_type test_config;
+	test_config.filename = std::string(argv[1]);
+
+	return run_test(test_config, [&] {
+		return_check ret;
+
+		ret += rc::check(
+			"verify that regions allocated and freed concurrently do not overlap",
+			[&](ranged<size_t, 1, max_concurrency> concurrency,
+			    ranged<size_t, 1, max_regions_per_thread> regions_per_thread, bool reopen) {
+				pmemstream_test_base stream(get_test_config().filename, get_test_config().block_size,
+							    get_test_config().stream_size);
+
+				std::vector<std::vector<pmemstream_region>> threads_regions(concurrency);
+				parallel_exec(concurrency, [&](size_t tid) {
+					for (size_t i = 0; i < regions_per_thread; i++) {
+						auto [ret, region] = stream.sut.region_allocate(region_size);
+						UT_ASSERTeq(ret, 0);
+						threads_regions[tid].push_back(region);
+					}
+
+					/* Free every other region, so that freed ones are reused by other threads. */
+					for (size_t i = 0; i < regions_per_thread; i += 2) {
+						UT_ASSERTeq(stream.sut.region_free(threads_regions[tid][i]), 0);
+					}
+
+					for (size_t i = 0; i < regions_per_thread; i += 2) {
+						auto [ret, region] = stream.sut.region_allocate(region_size);
+						UT_ASSERTeq(ret, 0);
+						threads_regions[tid][i] = region;
+					}
+				});
+
+				if (reopen)
+					stream.reopen();
+
+				std::set<uint64_t> offsets;
+				for (const auto &regions : threads_regions) {
+					for (const auto &region : regions) {
+						UT_ASSERT(offsets.insert(region.offset).second);
+					}
+				}
+
+				auto regions = stream.helpers.get_regions();
+				UT_ASSERTeq(regions.size(), offsets.size());
+				UT_ASSERT(std::all_of(regions.begin(), regions.end(), [&](const pmemstream_region &r) {
+					return offsets.count(r.offset) == 1;
+				}));
+			});
+	});
+}
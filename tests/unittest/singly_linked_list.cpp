@@ -205,6 +205,49 @@ int main(int argc, char *argv[])
 			}
 		});
 
+		ret += rc::check("Random remove with known predecessor", [](const std::vector<struct node> &data) {
+			RC_PRE(data.size() > 0);
+
+			singly_linked_list list;
+
+			struct pmemstream_runtime runtime {
+				.base = (void *)data.data(), .memcpy = &memcpy_mock, .memset = &memset_mock,
+				.flush = &flush_mock, .drain = &drain_mock, .persist = &persist_mock
+			};
+
+			SLIST_INIT(&runtime, &list);
+
+			/* Add elements to list */
+			uint64_t offset = 0;
+			for (size_t i = 0; i < data.size(); ++i) {
+				SLIST_INSERT_TAIL(struct node, &runtime, &list, offset, next);
+				offset += sizeof(struct node);
+			}
+
+			auto mod_data(data);
+			while (!mod_data.empty()) {
+				/* Remove random element, passing its predecessor */
+				auto random_item_pos = *rc::gen::inRange<size_t>(0, mod_data.size());
+
+				auto r_it = mod_data.begin();
+				std::advance(r_it, random_item_pos);
+				uint64_t prev = SLIST_INVALID_OFFSET;
+				auto l_it = list.head;
+
+				for (size_t i = 0; i < random_item_pos; ++i) {
+					prev = l_it;
+					l_it = SLIST_NEXT(struct node, &runtime, l_it, next);
+				}
+
+				RC_ASSERT((SLIST_GET_PTR(node, &runtime, l_it))->data == r_it->data);
+				mod_data.erase(r_it);
+				SLIST_REMOVE_AFTER(struct node, &runtime, &list, prev, l_it, next);
+
+				/* Check correctness */
+				check_list<node>(runtime, list, mod_data.begin(), mod_data.end());
+			}
+		});
+
 		rc::check("Removing nonexistent element doesn't change the list",
 			  [](const std::vector<struct node> &data) {
 				  RC_PRE(data.size() > 0);